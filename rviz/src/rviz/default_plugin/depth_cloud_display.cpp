@@ -108,10 +108,6 @@ DepthCloudDisplay::DepthCloudDisplay()
   // Instantiate PointCloudCommon class for displaying point clouds
   pointcloud_common_ = new PointCloudCommon(this);
 
-  // PointCloudCommon sets up a callback queue with a thread for each
-  // instance.  Use that for processing incoming messages.
-  update_nh_.setCallbackQueue( pointcloud_common_->getCallbackQueue() );
-
   // Scan for available transport plugins
   scanForTransportSubscriberPlugins();
 
@@ -119,6 +115,8 @@ DepthCloudDisplay::DepthCloudDisplay()
 
 void DepthCloudDisplay::onInitialize()
 {
+  // Process incoming messages on the worker pool instead of the GUI thread
+  update_nh_.setCallbackQueue( threaded_nh_.getCallbackQueue() );
   pointcloud_common_->initialize(context_, scene_node_);
 }
 
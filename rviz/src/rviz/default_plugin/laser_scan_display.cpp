@@ -55,20 +55,21 @@ LaserScanDisplay::LaserScanDisplay()
                                           " Increasing this is useful if your incoming TF data is delayed significantly "
                                           "from your LaserScan data, but it can greatly increase memory usage if the messages are big.",
                                           this, SLOT( updateQueueSize() ));
-
-  // PointCloudCommon sets up a callback queue with a thread for each
-  // instance.  Use that for processing incoming messages.
-  update_nh_.setCallbackQueue( point_cloud_common_->getCallbackQueue() );
 }
 
 LaserScanDisplay::~LaserScanDisplay()
 {
+  // The subscriber and tf filter are only torn down by MessageFilterDisplay
+  stopThreadedQueue();
   delete point_cloud_common_;
   delete projector_;
 }
 
 void LaserScanDisplay::onInitialize()
 {
+  // Process incoming messages on the worker pool instead of the GUI
+  // thread.  This has to be set before the tf filter is created.
+  update_nh_.setCallbackQueue( threaded_nh_.getCallbackQueue() );
   MFDClass::onInitialize();
   point_cloud_common_->initialize( context_, scene_node_ );
 }
@@ -84,6 +84,9 @@ protected:
   virtual void onEnable();
   virtual void onDisable();
 
+  /** @brief Build the map from a message.  Called by the subscriber. */
+  void incomingMap(const nav_msgs::OccupancyGrid::ConstPtr& msg);
+
 private Q_SLOTS:
   void updateAlpha();
   void updateTopic();
@@ -93,8 +96,6 @@ private:
   void subscribe();
   void unsubscribe();
 
-  void incomingMap(const nav_msgs::OccupancyGrid::ConstPtr& msg);
-
   void clear();
   void transformMap();
 
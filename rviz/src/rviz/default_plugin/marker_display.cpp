@@ -27,11 +27,13 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include <tf/transform_listener.h>
 
 #include "rviz/default_plugin/markers/arrow_marker.h"
+#include "rviz/default_plugin/markers/batched_shape_marker.h"
 #include "rviz/default_plugin/markers/line_list_marker.h"
 #include "rviz/default_plugin/markers/line_strip_marker.h"
 #include "rviz/default_plugin/markers/mesh_resource_marker.h"
@@ -44,11 +46,13 @@
 #include "rviz/ogre_helpers/arrow.h"
 #include "rviz/ogre_helpers/billboard_line.h"
 #include "rviz/ogre_helpers/shape.h"
+#include "rviz/properties/float_property.h"
 #include "rviz/properties/int_property.h"
 #include "rviz/properties/property.h"
 #include "rviz/properties/ros_topic_property.h"
 #include "rviz/selection/selection_manager.h"
 #include "rviz/validate_floats.h"
+#include "rviz/worker_pool.h"
 
 #include "rviz/default_plugin/marker_display.h"
 
@@ -59,6 +63,7 @@ namespace rviz
 
 MarkerDisplay::MarkerDisplay()
   : Display()
+  , backlog_status_( false )
 {
   marker_topic_property_ = new RosTopicProperty( "Marker Topic", "visualization_marker",
                                                  QString::fromStdString( ros::message_traits::datatype<visualization_msgs::Marker>() ),
@@ -73,6 +78,19 @@ MarkerDisplay::MarkerDisplay()
                                           this, SLOT( updateQueueSize() ));
   queue_size_property_->setMin( 0 );
 
+  batch_shapes_property_ = new BoolProperty( "Batch Shapes", true,
+                                             "Draw unrotated CUBE and round SPHERE markers with the same size, frame and alpha"
+                                             " together, which is much faster for large numbers of them.  Rotated, stretched"
+                                             " and frame-locked markers are always drawn on their own.",
+                                             this, SLOT( updateBatchShapes() ));
+
+  processing_budget_property_ = new FloatProperty( "Processing Budget", 10.0,
+                                                   "Advanced: milliseconds per frame to spend processing marker messages."
+                                                   "  Messages left over wait for the next frame, and only the newest message"
+                                                   " for each marker is kept.  0 means no limit.",
+                                                   this );
+  processing_budget_property_->setMin( 0 );
+
   namespaces_category_ = new Property( "Namespaces", QVariant(), "", this );
 }
 
@@ -86,6 +104,11 @@ void MarkerDisplay::onInitialize()
   tf_filter_->connectInput(sub_);
   tf_filter_->registerCallback(boost::bind(&MarkerDisplay::incomingMarker, this, _1));
   tf_filter_->registerFailureCallback(boost::bind(&MarkerDisplay::failedMarker, this, _1, _2));
+
+  if( WorkerPool* pool = context_->getWorkerPool() )
+  {
+    geometry_queue_ = pool->createQueue();
+  }
 }
 
 MarkerDisplay::~MarkerDisplay()
@@ -94,15 +117,31 @@ MarkerDisplay::~MarkerDisplay()
 
   clearMarkers();
 
+  if( geometry_queue_ )
+  {
+    geometry_queue_->close();
+  }
+
   delete tf_filter_;
 }
 
 void MarkerDisplay::clearMarkers()
 {
   markers_.clear();
-  markers_with_expiration_.clear();
+  expirations_.clear();
   frame_locked_markers_.clear();
+
+  // After the markers, which remove themselves from their batches
+  M_ShapeBatch::iterator batch_it = shape_batches_.begin();
+  for( ; batch_it != shape_batches_.end(); ++batch_it )
+  {
+    delete batch_it->second;
+  }
+  shape_batches_.clear();
+
   tf_filter_->clear();
+  pending_markers_.clear();
+  backlog_.clear();
   namespaces_category_->removeChildren();
   namespaces_.clear();
 }
@@ -170,7 +209,6 @@ void MarkerDisplay::deleteMarker(MarkerID id)
   M_IDToMarker::iterator it = markers_.find( id );
   if( it != markers_.end() )
   {
-    markers_with_expiration_.erase(it->second);
     frame_locked_markers_.erase(it->second);
     markers_.erase(it);
   }
@@ -219,12 +257,95 @@ void MarkerDisplay::deleteMarkerStatus(MarkerID id)
 
 void MarkerDisplay::incomingMarkerArray(const visualization_msgs::MarkerArray::ConstPtr& array)
 {
+  std::string caller_id = array->__connection_header ? (*array->__connection_header)["callerid"] : "unknown";
+
+  // Group the markers by frame and stamp, in order of first appearance.
+  typedef std::map<std::pair<std::string, ros::Time>, PendingMarkers*> M_Group;
+  M_Group groups;
+  L_PendingMarkers new_groups;
+
   std::vector<visualization_msgs::Marker>::const_iterator it = array->markers.begin();
   std::vector<visualization_msgs::Marker>::const_iterator end = array->markers.end();
   for (; it != end; ++it)
   {
     const visualization_msgs::Marker& marker = *it;
-    tf_filter_->add(visualization_msgs::Marker::Ptr(new visualization_msgs::Marker(marker)));
+    PendingMarkers*& group = groups[ std::make_pair( marker.header.frame_id, marker.header.stamp )];
+    if( !group )
+    {
+      new_groups.push_back( PendingMarkers() );
+      group = &new_groups.back();
+      group->frame_id = marker.header.frame_id;
+      group->stamp = marker.header.stamp;
+      group->caller_id = caller_id;
+      group->markers.reserve( array->markers.size() );
+    }
+    // Shares ownership of the array instead of copying the marker.
+    group->markers.push_back( visualization_msgs::Marker::ConstPtr( array, &marker ));
+  }
+
+  pending_markers_.splice( pending_markers_.end(), new_groups );
+  processPendingMarkers();
+}
+
+void MarkerDisplay::processPendingMarkers()
+{
+  if( pending_markers_.empty() )
+  {
+    return;
+  }
+
+  tf::TransformListener* tf = context_->getTFClient();
+  std::string fixed_frame = fixed_frame_.toStdString();
+  ros::Time now = ros::Time::now();
+
+  V_MarkerMessage ready;
+  L_PendingMarkers::iterator it = pending_markers_.begin();
+  while( it != pending_markers_.end() )
+  {
+    bool failed = false;
+    tf::FilterFailureReason reason = tf::filter_failure_reasons::Unknown;
+
+    if( it->frame_id.empty() )
+    {
+      failed = true;
+      reason = tf::filter_failure_reasons::EmptyFrameID;
+    }
+    else if( tf->canTransform( fixed_frame, it->frame_id, it->stamp ))
+    {
+      ready.insert( ready.end(), it->markers.begin(), it->markers.end() );
+      pending_markers_.erase( it++ );
+      continue;
+    }
+    else if( !it->stamp.isZero() && it->stamp + tf->getCacheLength() < now )
+    {
+      failed = true;
+      reason = tf::filter_failure_reasons::OutTheBack;
+    }
+
+    if( failed )
+    {
+      failedMarkers( *it, reason );
+      pending_markers_.erase( it++ );
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  // Like tf::MessageFilter, drop the oldest when the queue is full.  A
+  // size of 0 means no limit.
+  size_t queue_size = (size_t) queue_size_property_->getInt();
+  while( queue_size > 0 && pending_markers_.size() > queue_size )
+  {
+    failedMarkers( pending_markers_.front(), tf::filter_failure_reasons::Unknown );
+    pending_markers_.pop_front();
+  }
+
+  if( !ready.empty() )
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    message_queue_.insert( message_queue_.end(), ready.begin(), ready.end() );
   }
 }
 
@@ -241,6 +362,17 @@ void MarkerDisplay::failedMarker(const visualization_msgs::Marker::ConstPtr& mar
   setMarkerStatus(MarkerID(marker->ns, marker->id), StatusProperty::Error, error);
 }
 
+void MarkerDisplay::failedMarkers(const PendingMarkers& group, tf::FilterFailureReason reason)
+{
+  std::string error = context_->getFrameManager()->discoverFailureReason(group.frame_id, group.stamp, group.caller_id, reason);
+  V_MarkerMessage::const_iterator it = group.markers.begin();
+  V_MarkerMessage::const_iterator end = group.markers.end();
+  for (; it != end; ++it)
+  {
+    setMarkerStatus(MarkerID((*it)->ns, (*it)->id), StatusProperty::Error, error);
+  }
+}
+
 bool validateFloats(const visualization_msgs::Marker& msg)
 {
   bool valid = true;
@@ -251,7 +383,8 @@ bool validateFloats(const visualization_msgs::Marker& msg)
   return valid;
 }
 
-void MarkerDisplay::processMessage( const visualization_msgs::Marker::ConstPtr& message )
+void MarkerDisplay::processMessage( const visualization_msgs::Marker::ConstPtr& message,
+                                    const MarkerGeometryConstPtr& geometry )
 {
   if (!validateFloats(*message))
   {
@@ -262,7 +395,7 @@ void MarkerDisplay::processMessage( const visualization_msgs::Marker::ConstPtr&
   switch ( message->action )
   {
   case visualization_msgs::Marker::ADD:
-    processAdd( message );
+    processAdd( message, geometry );
     break;
 
   case visualization_msgs::Marker::DELETE:
@@ -274,7 +407,8 @@ void MarkerDisplay::processMessage( const visualization_msgs::Marker::ConstPtr&
   }
 }
 
-void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& message )
+void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& message,
+                                const MarkerGeometryConstPtr& geometry )
 {
   QString namespace_name = QString::fromStdString( message->ns );
   M_Namespace::iterator ns_it = namespaces_.find( namespace_name );
@@ -297,8 +431,9 @@ void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& mess
   if ( it != markers_.end() )
   {
     marker = it->second;
-    markers_with_expiration_.erase(marker);
-    if ( message->type == marker->getMessage()->type )
+    frame_locked_markers_.erase(marker);
+    bool batched = dynamic_cast<BatchedShapeMarker*>(marker.get()) != 0;
+    if ( message->type == marker->getMessage()->type && batched == isBatched( *message ))
     {
       create = false;
     }
@@ -308,7 +443,12 @@ void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& mess
     }
   }
 
-  if ( create )
+  if ( create && isBatched( *message ))
+  {
+    marker.reset(new BatchedShapeMarker(this, context_));
+    markers_.insert(std::make_pair(MarkerID(message->ns, message->id), marker));
+  }
+  else if ( create )
   {
     switch ( message->type )
     {
@@ -368,11 +508,11 @@ void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& mess
 
   if (marker)
   {
-    marker->setMessage(message);
+    marker->setMessage(message, geometry);
 
     if (message->lifetime.toSec() > 0.0001f)
     {
-      markers_with_expiration_.insert(marker);
+      scheduleExpiration(marker);
     }
 
     if (message->frame_locked)
@@ -384,13 +524,116 @@ void MarkerDisplay::processAdd( const visualization_msgs::Marker::ConstPtr& mess
   }
 }
 
+bool MarkerDisplay::isBatched( const visualization_msgs::Marker& message ) const
+{
+  if( !batch_shapes_property_->getBool() || message.frame_locked )
+  {
+    return false;
+  }
+
+  // Only unrotated shapes, so markers in one frame share the batch of
+  // that frame's orientation instead of each getting their own.
+  const geometry_msgs::Quaternion& q = message.pose.orientation;
+  if( q.x != 0.0 || q.y != 0.0 || q.z != 0.0 || q.w == 0.0 )
+  {
+    return false;
+  }
+
+  switch( message.type )
+  {
+  case visualization_msgs::Marker::CUBE:
+    return true;
+  case visualization_msgs::Marker::SPHERE:
+    // Batched spheres are screen-facing sprites, which can't be stretched.
+    return message.scale.x == message.scale.y && message.scale.y == message.scale.z;
+  default:
+    return false;
+  }
+}
+
+ShapeBatch* MarkerDisplay::getShapeBatch( const ShapeBatch::Key& key )
+{
+  ShapeBatch*& batch = shape_batches_[ key ];
+  if( !batch )
+  {
+    batch = new ShapeBatch( context_, scene_node_, key );
+  }
+  return batch;
+}
+
+void MarkerDisplay::updateBatchShapes()
+{
+  // Re-add the shapes from their last message, which moves them in or
+  // out of batches.
+  std::vector<visualization_msgs::Marker::ConstPtr> shapes;
+  M_IDToMarker::iterator it = markers_.begin();
+  for( ; it != markers_.end(); ++it )
+  {
+    const visualization_msgs::Marker::ConstPtr& message = it->second->getMessage();
+    if( message->type == visualization_msgs::Marker::CUBE || message->type == visualization_msgs::Marker::SPHERE )
+    {
+      shapes.push_back( message );
+    }
+  }
+
+  for( size_t i = 0; i < shapes.size(); i++ )
+  {
+    processAdd( shapes[ i ] );
+  }
+  context_->queueRender();
+}
+
 void MarkerDisplay::processDelete( const visualization_msgs::Marker::ConstPtr& message )
 {
   deleteMarker(MarkerID(message->ns, message->id));
   context_->queueRender();
 }
 
-void MarkerDisplay::update(float wall_dt, float ros_dt)
+void MarkerDisplay::scheduleExpiration( const MarkerBasePtr& marker )
+{
+  // Entries of deleted or updated markers stay in the heap until they
+  // come up, so rebuild it once they outnumber the markers.
+  if( expirations_.size() > 2 * markers_.size() + 100 )
+  {
+    std::vector<Expiration> live;
+    live.reserve( markers_.size() );
+    for( size_t i = 0; i < expirations_.size(); i++ )
+    {
+      MarkerBasePtr scheduled = expirations_[ i ].marker.lock();
+      if( scheduled && scheduled->getExpiration() == expirations_[ i ].time )
+      {
+        live.push_back( expirations_[ i ] );
+      }
+    }
+    expirations_.swap( live );
+    std::make_heap( expirations_.begin(), expirations_.end() );
+  }
+
+  Expiration expiration;
+  expiration.time = marker->getExpiration();
+  expiration.marker = marker;
+  expirations_.push_back( expiration );
+  std::push_heap( expirations_.begin(), expirations_.end() );
+}
+
+void MarkerDisplay::deleteExpiredMarkers()
+{
+  ros::Time now = ros::Time::now();
+  while( !expirations_.empty() && expirations_.front().time <= now )
+  {
+    std::pop_heap( expirations_.begin(), expirations_.end() );
+    Expiration expiration = expirations_.back();
+    expirations_.pop_back();
+
+    MarkerBasePtr marker = expiration.marker.lock();
+    if( marker && marker->getExpiration() == expiration.time )
+    {
+      deleteMarker( marker->getID() );
+    }
+  }
+}
+
+void MarkerDisplay::queueMessages()
 {
   V_MarkerMessage local_queue;
 
@@ -400,37 +643,95 @@ void MarkerDisplay::update(float wall_dt, float ros_dt)
     local_queue.swap( message_queue_ );
   }
 
-  if ( !local_queue.empty() )
+  if( local_queue.empty() )
+  {
+    return;
+  }
+
+  for( size_t i = 0; i < local_queue.size(); i++ )
   {
-    V_MarkerMessage::iterator message_it = local_queue.begin();
-    V_MarkerMessage::iterator message_end = local_queue.end();
-    for ( ; message_it != message_end; ++message_it )
+    QueuedMarker queued;
+    queued.message = local_queue[ i ];
+    backlog_.push_back( queued );
+  }
+
+  // An ADD replaces the whole marker and a DELETE removes it, so only
+  // the last message for each marker matters.
+  std::set<MarkerID> seen;
+  D_QueuedMarker kept;
+  for( D_QueuedMarker::reverse_iterator it = backlog_.rbegin(); it != backlog_.rend(); ++it )
+  {
+    if( seen.insert( MarkerID( it->message->ns, it->message->id )).second )
     {
-      visualization_msgs::Marker::ConstPtr& marker = *message_it;
+      kept.push_front( *it );
+    }
+  }
+  backlog_.swap( kept );
 
-      processMessage( marker );
+  if( !geometry_queue_ )
+  {
+    return;
+  }
+
+  // Small markers aren't worth the trip to another thread.
+  const size_t min_points = 1000;
+  D_QueuedMarker::iterator it = backlog_.begin();
+  for( ; it != backlog_.end(); ++it )
+  {
+    const visualization_msgs::Marker& message = *it->message;
+    if( !it->job && message.action == visualization_msgs::Marker::ADD &&
+        hasMarkerGeometry( message.type ) && message.points.size() >= min_points )
+    {
+      it->job.reset( new MarkerGeometryJob( it->message ));
+      geometry_queue_->addCallback( it->job );
     }
   }
+}
+
+void MarkerDisplay::processBacklog()
+{
+  ros::WallTime start = ros::WallTime::now();
+  ros::WallDuration budget( processing_budget_property_->getFloat() / 1000.0 );
 
+  while( !backlog_.empty() )
   {
-    S_MarkerBase::iterator it = markers_with_expiration_.begin();
-    S_MarkerBase::iterator end = markers_with_expiration_.end();
-    for (; it != end;)
+    QueuedMarker& queued = backlog_.front();
+    if( queued.job && !queued.job->isReady() )
     {
-      MarkerBasePtr marker = *it;
-      if (marker->expired())
-      {
-        S_MarkerBase::iterator copy = it;
-        ++it;
-        deleteMarker(marker->getID());
-      }
-      else
-      {
-        ++it;
-      }
+      // Later messages may be for the same marker, so keep the order.
+      break;
+    }
+
+    processMessage( queued.message, queued.job ? queued.job->getGeometry() : MarkerGeometryConstPtr() );
+    backlog_.pop_front();
+
+    if( !budget.isZero() && ros::WallTime::now() - start >= budget )
+    {
+      break;
     }
   }
 
+  if( !backlog_.empty() )
+  {
+    setStatus( StatusProperty::Ok, "Backlog", QString( "%1 messages waiting" ).arg( backlog_.size() ));
+    backlog_status_ = true;
+  }
+  else if( backlog_status_ )
+  {
+    deleteStatus( "Backlog" );
+    backlog_status_ = false;
+  }
+}
+
+void MarkerDisplay::update(float wall_dt, float ros_dt)
+{
+  processPendingMarkers();
+
+  queueMessages();
+  processBacklog();
+
+  deleteExpiredMarkers();
+
   {
     S_MarkerBase::iterator it = frame_locked_markers_.begin();
     S_MarkerBase::iterator end = frame_locked_markers_.end();
@@ -440,6 +741,23 @@ void MarkerDisplay::update(float wall_dt, float ros_dt)
       marker->updateFrameLocked();
     }
   }
+
+  {
+    M_ShapeBatch::iterator it = shape_batches_.begin();
+    while( it != shape_batches_.end() )
+    {
+      if( it->second->size() == 0 )
+      {
+        delete it->second;
+        shape_batches_.erase( it++ );
+      }
+      else
+      {
+        it->second->update();
+        ++it;
+      }
+    }
+  }
 }
 
 void MarkerDisplay::fixedFrameChanged()
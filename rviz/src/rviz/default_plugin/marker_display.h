@@ -30,11 +30,14 @@
 #ifndef RVIZ_MARKER_DISPLAY_H
 #define RVIZ_MARKER_DISPLAY_H
 
+#include <deque>
+#include <list>
 #include <map>
 #include <set>
 
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include <tf/message_filter.h>
 
@@ -43,18 +46,22 @@
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
+#include "rviz/default_plugin/markers/marker_geometry.h"
+#include "rviz/default_plugin/markers/shape_batch.h"
 #include "rviz/display.h"
 #include "rviz/properties/bool_property.h"
 #include "rviz/selection/forwards.h"
 
 namespace rviz
 {
+class FloatProperty;
 class IntProperty;
 class MarkerBase;
 class MarkerNamespace;
 class MarkerSelectionHandler;
 class Object;
 class RosTopicProperty;
+class WorkerQueue;
 
 typedef boost::shared_ptr<MarkerSelectionHandler> MarkerSelectionHandlerPtr;
 typedef boost::shared_ptr<MarkerBase> MarkerBasePtr;
@@ -85,6 +92,11 @@ public:
   void setMarkerStatus(MarkerID id, StatusLevel level, const std::string& text);
   void deleteMarkerStatus(MarkerID id);
 
+  /** @brief Return the batch for shape markers with the given key, creating it if needed.
+   *
+   * Empty batches are destroyed in update(). */
+  ShapeBatch* getShapeBatch( const ShapeBatch::Key& key );
+
 protected:
   virtual void onEnable();
   virtual void onDisable();
@@ -97,19 +109,48 @@ protected:
    * "visualization_marker_array" topics. */
   virtual void unsubscribe();
 
-  /** @brief Process a MarkerArray message. */
+  /** @brief Process a MarkerArray message.
+   *
+   * The markers are not copied: the pointers queued for each of them
+   * share ownership of @a array.  Markers are grouped by frame and
+   * stamp, and each group waits for its transform as a whole. */
   void incomingMarkerArray( const visualization_msgs::MarkerArray::ConstPtr& array );
 
   ros::Subscriber array_sub_;
 
   RosTopicProperty* marker_topic_property_;
   IntProperty* queue_size_property_;
+  BoolProperty* batch_shapes_property_;
+  FloatProperty* processing_budget_property_;
 
 private Q_SLOTS:
   void updateQueueSize();
   void updateTopic();
+  void updateBatchShapes();
 
 private:
+  typedef std::vector<visualization_msgs::Marker::ConstPtr> V_MarkerMessage;
+
+  /** @brief Markers of one MarkerArray sharing a frame and stamp, which
+   * wait for their transform together. */
+  struct PendingMarkers
+  {
+    std::string frame_id;
+    ros::Time stamp;
+    std::string caller_id;
+    V_MarkerMessage markers;
+  };
+  typedef std::list<PendingMarkers> L_PendingMarkers;
+
+  /** @brief A marker message waiting to be processed, and the job
+   * building its geometry on a worker thread, if it has one. */
+  struct QueuedMarker
+  {
+    visualization_msgs::Marker::ConstPtr message;
+    MarkerGeometryJobPtr job;
+  };
+  typedef std::deque<QueuedMarker> D_QueuedMarker;
+
   /** @brief Delete all the markers within the given namespace. */
   void deleteMarkersInNamespace( const std::string& ns );
 
@@ -122,18 +163,26 @@ private:
    * \brief Processes a marker message
    * @param message The message to process
    */
-  void processMessage( const visualization_msgs::Marker::ConstPtr& message );
+  void processMessage( const visualization_msgs::Marker::ConstPtr& message,
+                       const MarkerGeometryConstPtr& geometry = MarkerGeometryConstPtr() );
   /**
    * \brief Processes an "Add" marker message
    * @param message The message to process
    */
-  void processAdd( const visualization_msgs::Marker::ConstPtr& message );
+  void processAdd( const visualization_msgs::Marker::ConstPtr& message,
+                   const MarkerGeometryConstPtr& geometry = MarkerGeometryConstPtr() );
   /**
    * \brief Processes a "Delete" marker message
    * @param message The message to process
    */
   void processDelete( const visualization_msgs::Marker::ConstPtr& message );
 
+  /** @brief Return true if the marker should be drawn as part of a ShapeBatch.
+   *
+   * That is a CUBE or a SPHERE of equal scale on all axes, with an
+   * identity orientation and not frame-locked. */
+  bool isBatched( const visualization_msgs::Marker& message ) const;
+
   /**
    * \brief ROS callback notifying us of a new marker
    */
@@ -141,16 +190,57 @@ private:
 
   void failedMarker(const visualization_msgs::Marker::ConstPtr& marker, tf::FilterFailureReason reason);
 
+  /** @brief Queue the MarkerArray groups whose transform became
+   * available, and drop those which are too old or over the queue size. */
+  void processPendingMarkers();
+
+  /** @brief Set the transform error on each marker of @a group. */
+  void failedMarkers(const PendingMarkers& group, tf::FilterFailureReason reason);
+
+  /** @brief Move the received messages to backlog_, keeping only the
+   * last message for each marker, and start building their geometry. */
+  void queueMessages();
+
+  /** @brief Process messages from the front of backlog_ until it is
+   * empty, the processing budget is used up, or a message's geometry
+   * isn't built yet. */
+  void processBacklog();
+
+  /** @brief Schedule @a marker to be deleted at its expiration time. */
+  void scheduleExpiration( const MarkerBasePtr& marker );
+
+  /** @brief Delete the markers whose lifetime ran out. */
+  void deleteExpiredMarkers();
+
   typedef std::map<MarkerID, MarkerBasePtr> M_IDToMarker;
   typedef std::set<MarkerBasePtr> S_MarkerBase;
   M_IDToMarker markers_;                                ///< Map of marker id to the marker info structure
-  S_MarkerBase markers_with_expiration_;
+
+  /** @brief Entry of the expiration heap.  It only counts while the
+   * marker is alive and still has the same expiration time; updating a
+   * marker just adds a new entry. */
+  struct Expiration
+  {
+    ros::Time time;
+    boost::weak_ptr<MarkerBase> marker;
+
+    // Reversed, so the std heap functions put the earliest on top.
+    bool operator<( const Expiration& other ) const { return other.time < time; }
+  };
+  std::vector<Expiration> expirations_;                 ///< Min-heap on time
   S_MarkerBase frame_locked_markers_;
-  typedef std::vector<visualization_msgs::Marker::ConstPtr> V_MarkerMessage;
+  typedef std::map<ShapeBatch::Key, ShapeBatch*> M_ShapeBatch;
+  M_ShapeBatch shape_batches_;
   V_MarkerMessage message_queue_;                       ///< Marker message queue.  Messages are added to this as they are received, and then processed
                                                         ///< in our update() function
   boost::mutex queue_mutex_;
 
+  L_PendingMarkers pending_markers_;                    ///< Oldest first.  Only used from the update queue.
+
+  D_QueuedMarker backlog_;                              ///< Messages taken from message_queue_ but not processed yet
+  bool backlog_status_;                                 ///< True while the "Backlog" status is shown
+  boost::shared_ptr<WorkerQueue> geometry_queue_;       ///< Builds marker geometry, NULL without a WorkerPool
+
   message_filters::Subscriber<visualization_msgs::Marker> sub_;
   tf::MessageFilter<visualization_msgs::Marker>* tf_filter_;
 
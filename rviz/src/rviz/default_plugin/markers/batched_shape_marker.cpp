@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "batched_shape_marker.h"
+#include "shape_batch.h"
+
+#include "rviz/default_plugin/marker_display.h"
+
+namespace rviz
+{
+
+BatchedShapeMarker::BatchedShapeMarker( MarkerDisplay* owner, DisplayContext* context )
+  : MarkerBase( owner, context, 0 )
+  , batch_( 0 )
+  , batch_index_( 0 )
+{
+}
+
+BatchedShapeMarker::~BatchedShapeMarker()
+{
+  if( batch_ )
+  {
+    batch_->remove( batch_index_ );
+  }
+}
+
+void BatchedShapeMarker::onNewMessage( const MarkerConstPtr& old_message,
+                                       const MarkerConstPtr& new_message )
+{
+  Ogre::Vector3 pos, scale;
+  Ogre::Quaternion orient;
+  if( !transform( new_message, pos, orient, scale ))
+  {
+    return;
+  }
+
+  if( owner_ && (new_message->scale.x * new_message->scale.y * new_message->scale.z == 0.0f) )
+  {
+    owner_->setMarkerStatus( getID(), StatusProperty::Warn, "Scale of 0 in one of x/y/z" );
+  }
+
+  setPosition( pos );
+  setOrientation( orient );
+
+  ShapeBatch::Key key;
+  key.type = new_message->type;
+  key.scale = scale;
+  key.orientation = orient;
+  key.alpha = new_message->color.a;
+  Ogre::ColourValue color( new_message->color.r, new_message->color.g, new_message->color.b, new_message->color.a );
+
+  if( batch_ && batch_->getKey() == key )
+  {
+    batch_->set( batch_index_, pos, color );
+    return;
+  }
+
+  if( batch_ )
+  {
+    batch_->remove( batch_index_ );
+  }
+  batch_ = owner_->getShapeBatch( key );
+  batch_index_ = batch_->add( this, pos, color );
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_BATCHED_SHAPE_MARKER_H
+#define RVIZ_BATCHED_SHAPE_MARKER_H
+
+#include "marker_base.h"
+
+namespace rviz
+{
+class ShapeBatch;
+
+/** @brief A CUBE or SPHERE marker drawn as part of a ShapeBatch.
+ *
+ * It has no geometry of its own.  Each new message moves it to the
+ * batch of the MarkerDisplay matching its scale, orientation and
+ * alpha.  Its own scene node is kept out of the scene graph and only
+ * holds the pose for selection. */
+class BatchedShapeMarker: public MarkerBase
+{
+public:
+  BatchedShapeMarker( MarkerDisplay* owner, DisplayContext* context );
+  ~BatchedShapeMarker();
+
+  /** @brief Called by ShapeBatch when the marker moves within it. */
+  void setBatchIndex( uint32_t index ) { batch_index_ = index; }
+
+protected:
+  virtual void onNewMessage( const MarkerConstPtr& old_message, const MarkerConstPtr& new_message );
+
+  ShapeBatch* batch_;
+  uint32_t batch_index_;
+};
+
+}
+
+#endif
@@ -76,48 +76,22 @@ void LineListMarker::onNewMessage(const MarkerConstPtr& old_message, const Marke
     return;
   }
 
-  bool has_per_point_color = new_message->colors.size() == new_message->points.size();
-
   if (new_message->points.size() % 2 == 0)
   {
     lines_->setLineWidth( new_message->scale.x );
     lines_->setMaxPointsPerLine(2);
     lines_->setNumLines(new_message->points.size() / 2);
 
-    size_t i = 0;
-    std::vector<geometry_msgs::Point>::const_iterator it = new_message->points.begin();
-    std::vector<geometry_msgs::Point>::const_iterator end = new_message->points.end();
-    for ( ; it != end; )
+    MarkerGeometryConstPtr geometry = getGeometry();
+    for (size_t i = 0; i < geometry->positions.size(); i += 2)
     {
-      if (it != new_message->points.begin())
+      if (i > 0)
       {
         lines_->newLine();
       }
 
-      for (uint32_t j = 0; j < 2; ++j, ++it, ++i)
-      {
-        const geometry_msgs::Point& p = *it;
-
-        Ogre::ColourValue c;
-        if (has_per_point_color)
-        {
-          const std_msgs::ColorRGBA& color = new_message->colors[i];
-          c.r = color.r;
-          c.g = color.g;
-          c.b = color.b;
-          c.a = color.a * new_message->color.a;
-        }
-        else
-        {
-          c.r = new_message->color.r;
-          c.g = new_message->color.g;
-          c.b = new_message->color.b;
-          c.a = new_message->color.a;
-        }
-
-        Ogre::Vector3 v( p.x, p.y, p.z );
-        lines_->addPoint( v, c );
-      }
+      lines_->addPoint( geometry->positions[i], geometry->colors[i] );
+      lines_->addPoint( geometry->positions[i + 1], geometry->colors[i + 1] );
     }
   }
   else
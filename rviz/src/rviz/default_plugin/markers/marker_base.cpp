@@ -48,7 +48,8 @@ namespace rviz
 MarkerBase::MarkerBase( MarkerDisplay* owner, DisplayContext* context, Ogre::SceneNode* parent_node )
   : owner_( owner )
   , context_( context )
-  , scene_node_( parent_node->createChildSceneNode() )
+  // Without a parent, the node stays out of the scene graph.
+  , scene_node_( parent_node ? parent_node->createChildSceneNode() : context->getSceneManager()->createSceneNode() )
   , coll_( 0 )
 {}
 
@@ -66,19 +67,46 @@ void MarkerBase::setMessage(const Marker& message)
 }
 
 void MarkerBase::setMessage(const MarkerConstPtr& message)
+{
+  setMessage( message, MarkerGeometryConstPtr() );
+}
+
+void MarkerBase::setMessage(const MarkerConstPtr& message, const MarkerGeometryConstPtr& geometry)
 {
   MarkerConstPtr old = message_;
   message_ = message;
+  geometry_ = geometry;
 
   expiration_ = ros::Time::now() + message->lifetime;
 
   onNewMessage(old, message);
+
+  // Only needed until it's uploaded
+  geometry_.reset();
+}
+
+MarkerGeometryConstPtr MarkerBase::getGeometry()
+{
+  if (!geometry_)
+  {
+    geometry_ = buildMarkerGeometry(*message_);
+  }
+  return geometry_;
 }
 
 void MarkerBase::updateFrameLocked()
 {
   ROS_ASSERT(message_ && message_->frame_locked);
-  onNewMessage(message_, message_);
+
+  Ogre::Vector3 pos, scale;
+  Ogre::Quaternion orient;
+  if (!transform(message_, pos, orient, scale))
+  {
+    // transform() has set the error status; stay where we were.
+    return;
+  }
+
+  setPose(pos, orient);
 }
 
 bool MarkerBase::expired()
@@ -110,6 +138,12 @@ bool MarkerBase::transform(const MarkerConstPtr& message, Ogre::Vector3& pos, Og
   return true;
 }
 
+void MarkerBase::setPose( const Ogre::Vector3& position, const Ogre::Quaternion& orientation )
+{
+  setPosition( position );
+  setOrientation( orientation );
+}
+
 void MarkerBase::setInteractiveObject( InteractiveObjectWPtr control )
 {
   SelectionHandlerPtr handler = context_->getSelectionManager()->getHandler( coll_ );
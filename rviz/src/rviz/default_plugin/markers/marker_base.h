@@ -32,6 +32,7 @@
 
 #include "rviz/selection/forwards.h"
 #include "rviz/interactive_object.h"
+#include "rviz/default_plugin/markers/marker_geometry.h"
 
 #include <visualization_msgs/Marker.h>
 
@@ -61,14 +62,24 @@ public:
   typedef visualization_msgs::Marker Marker;
   typedef visualization_msgs::Marker::ConstPtr MarkerConstPtr;
 
+  /** @param parent_node May be NULL for markers which draw nothing through their own scene node. */
   MarkerBase( MarkerDisplay* owner, DisplayContext* context, Ogre::SceneNode* parent_node );
 
   virtual ~MarkerBase();
 
   void setMessage(const Marker& message);
   void setMessage(const MarkerConstPtr& message);
+
+  /** @brief Like setMessage(), with the geometry already built from
+   * @a message by buildMarkerGeometry(), if the marker type uses one. */
+  void setMessage(const MarkerConstPtr& message, const MarkerGeometryConstPtr& geometry);
   bool expired();
+  const ros::Time& getExpiration() const { return expiration_; }
 
+  /** @brief Move a frame-locked marker to where its frame is now.
+   *
+   * Only the pose of the scene node changes; the geometry built from
+   * the message is left alone. */
   void updateFrameLocked();
 
   const MarkerConstPtr& getMessage() const { return message_; }
@@ -95,6 +106,17 @@ protected:
   bool transform(const MarkerConstPtr& message, Ogre::Vector3& pos, Ogre::Quaternion& orient, Ogre::Vector3& scale);
   virtual void onNewMessage(const MarkerConstPtr& old_message, const MarkerConstPtr& new_message) = 0;
 
+  /** @brief Return the geometry of the message given to onNewMessage(),
+   * building it now if it wasn't passed in. */
+  MarkerGeometryConstPtr getGeometry();
+
+  /** @brief Place the marker at a pose given in the fixed frame.
+   *
+   * Used by onNewMessage() implementations and updateFrameLocked().
+   * Override this if the scene node needs a correction on top of the
+   * message pose. */
+  virtual void setPose( const Ogre::Vector3& position, const Ogre::Quaternion& orientation );
+
   void extractMaterials( Ogre::Entity *entity, S_MaterialPtr &materials );
 
   MarkerDisplay* owner_;
@@ -104,6 +126,7 @@ protected:
 
   CollObjectHandle coll_;
   MarkerConstPtr message_;
+  MarkerGeometryConstPtr geometry_;   ///< Only set during onNewMessage()
 
   ros::Time expiration_;
 };
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "marker_geometry.h"
+
+namespace rviz
+{
+
+bool hasMarkerGeometry( int32_t type )
+{
+  switch( type )
+  {
+  case visualization_msgs::Marker::POINTS:
+  case visualization_msgs::Marker::CUBE_LIST:
+  case visualization_msgs::Marker::SPHERE_LIST:
+  case visualization_msgs::Marker::LINE_LIST:
+  case visualization_msgs::Marker::TRIANGLE_LIST:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void buildPoints( const visualization_msgs::Marker& message, MarkerGeometry& geometry )
+{
+  bool has_per_point_color = message.colors.size() == message.points.size();
+  float r = message.color.r;
+  float g = message.color.g;
+  float b = message.color.b;
+
+  geometry.points.resize( message.points.size() );
+  for( size_t i = 0; i < message.points.size(); ++i )
+  {
+    const geometry_msgs::Point& p = message.points[ i ];
+    PointCloud::Point& point = geometry.points[ i ];
+    point.x = p.x;
+    point.y = p.y;
+    point.z = p.z;
+
+    if( has_per_point_color )
+    {
+      const std_msgs::ColorRGBA& color = message.colors[ i ];
+      r = color.r;
+      g = color.g;
+      b = color.b;
+    }
+    point.setColor( r, g, b );
+  }
+}
+
+static void buildLineList( const visualization_msgs::Marker& message, MarkerGeometry& geometry )
+{
+  bool has_per_point_color = message.colors.size() == message.points.size();
+  Ogre::ColourValue c( message.color.r, message.color.g, message.color.b, message.color.a );
+
+  geometry.positions.resize( message.points.size() );
+  geometry.colors.resize( message.points.size() );
+  for( size_t i = 0; i < message.points.size(); ++i )
+  {
+    const geometry_msgs::Point& p = message.points[ i ];
+    geometry.positions[ i ] = Ogre::Vector3( p.x, p.y, p.z );
+
+    if( has_per_point_color )
+    {
+      const std_msgs::ColorRGBA& color = message.colors[ i ];
+      c.r = color.r;
+      c.g = color.g;
+      c.b = color.b;
+      c.a = color.a * message.color.a;
+    }
+    geometry.colors[ i ] = c;
+  }
+}
+
+static void buildTriangleList( const visualization_msgs::Marker& message, MarkerGeometry& geometry )
+{
+  size_t num_points = message.points.size();
+  bool has_vertex_colors = message.colors.size() == num_points;
+
+  geometry.positions.resize( num_points );
+  for( size_t i = 0; i < num_points; ++i )
+  {
+    const geometry_msgs::Point& p = message.points[ i ];
+    geometry.positions[ i ] = Ogre::Vector3( p.x, p.y, p.z );
+  }
+
+  if( has_vertex_colors )
+  {
+    geometry.colors.resize( num_points );
+    for( size_t i = 0; i < num_points; ++i )
+    {
+      const std_msgs::ColorRGBA& color = message.colors[ i ];
+      geometry.any_vertex_has_alpha = geometry.any_vertex_has_alpha || (color.a < 0.9998);
+      geometry.colors[ i ] = Ogre::ColourValue( color.r, color.g, color.b, message.color.a * color.a );
+    }
+  }
+}
+
+MarkerGeometryConstPtr buildMarkerGeometry( const visualization_msgs::Marker& message )
+{
+  boost::shared_ptr<MarkerGeometry> geometry( new MarkerGeometry );
+  switch( message.type )
+  {
+  case visualization_msgs::Marker::POINTS:
+  case visualization_msgs::Marker::CUBE_LIST:
+  case visualization_msgs::Marker::SPHERE_LIST:
+    buildPoints( message, *geometry );
+    break;
+  case visualization_msgs::Marker::LINE_LIST:
+    buildLineList( message, *geometry );
+    break;
+  case visualization_msgs::Marker::TRIANGLE_LIST:
+    buildTriangleList( message, *geometry );
+    break;
+  default:
+    return MarkerGeometryConstPtr();
+  }
+  return geometry;
+}
+
+MarkerGeometryJob::MarkerGeometryJob( const visualization_msgs::Marker::ConstPtr& message )
+: message_( message )
+, ready_( 0 )
+{
+}
+
+ros::CallbackInterface::CallResult MarkerGeometryJob::call()
+{
+  geometry_ = buildMarkerGeometry( *message_ );
+  // Publishes geometry_ to isReady() callers.
+  ++ready_;
+  return Success;
+}
+
+} // namespace rviz
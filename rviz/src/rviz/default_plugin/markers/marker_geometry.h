@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_MARKER_GEOMETRY_H
+#define RVIZ_MARKER_GEOMETRY_H
+
+#include <vector>
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <OGRE/OgreColourValue.h>
+#include <OGRE/OgreVector3.h>
+
+#include <ros/callback_queue_interface.h>
+
+#include <visualization_msgs/Marker.h>
+
+#include "rviz/ogre_helpers/point_cloud.h"
+
+namespace rviz
+{
+
+/** @brief Vertex data of a marker, built from its message.
+ *
+ * Building it touches nothing but the message, so it can happen on
+ * any thread.  The marker then only has to hand it to Ogre. */
+struct MarkerGeometry
+{
+  MarkerGeometry()
+  : any_vertex_has_alpha( false )
+  {}
+
+  std::vector<PointCloud::Point> points;    ///< POINTS, CUBE_LIST and SPHERE_LIST
+  std::vector<Ogre::Vector3> positions;     ///< Vertices of LINE_LIST and TRIANGLE_LIST
+  std::vector<Ogre::ColourValue> colors;    ///< Same size as positions, or empty for a TRIANGLE_LIST without vertex colors
+  bool any_vertex_has_alpha;                ///< TRIANGLE_LIST only
+};
+typedef boost::shared_ptr<const MarkerGeometry> MarkerGeometryConstPtr;
+
+/** @brief Return true if markers of type @a type use a MarkerGeometry. */
+bool hasMarkerGeometry( int32_t type );
+
+/** @brief Build the geometry of a marker of a type for which hasMarkerGeometry() is true.
+ *
+ * Returns NULL for other types. */
+MarkerGeometryConstPtr buildMarkerGeometry( const visualization_msgs::Marker& message );
+
+/** @brief Builds the MarkerGeometry of one message when run by a CallbackQueue.
+ *
+ * Keeps everything it uses alive itself, so it can be dropped by its
+ * owner at any time. */
+class MarkerGeometryJob: public ros::CallbackInterface
+{
+public:
+  MarkerGeometryJob( const visualization_msgs::Marker::ConstPtr& message );
+
+  virtual CallResult call();
+
+  /** @brief Return true once call() has finished. */
+  bool isReady() const { return ready_ != 0; }
+
+  /** @brief Return the geometry.  Only valid once isReady() returned true. */
+  const MarkerGeometryConstPtr& getGeometry() const { return geometry_; }
+
+private:
+  visualization_msgs::Marker::ConstPtr message_;
+  MarkerGeometryConstPtr geometry_;
+  boost::detail::atomic_count ready_;
+};
+typedef boost::shared_ptr<MarkerGeometryJob> MarkerGeometryJobPtr;
+
+} // namespace rviz
+
+#endif // RVIZ_MARKER_GEOMETRY_H
@@ -96,42 +96,10 @@ void PointsMarker::onNewMessage(const MarkerConstPtr& old_message, const MarkerC
     return;
   }
 
-  float r = new_message->color.r;
-  float g = new_message->color.g;
-  float b = new_message->color.b;
-  float a = new_message->color.a;
-  points_->setAlpha(a);
-
-  bool has_per_point_color = new_message->colors.size() == new_message->points.size();
-
-  typedef std::vector< PointCloud::Point > V_Point;
-  V_Point points;
-  points.resize(new_message->points.size());
-  std::vector<geometry_msgs::Point>::const_iterator it = new_message->points.begin();
-  std::vector<geometry_msgs::Point>::const_iterator end = new_message->points.end();
-  for (int i = 0; it != end; ++it, ++i)
-  {
-    const geometry_msgs::Point& p = *it;
-    PointCloud::Point& point = points[i];
-
-    Ogre::Vector3 v(p.x, p.y, p.z);
-
-    point.x = v.x;
-    point.y = v.y;
-    point.z = v.z;
-
-    if (has_per_point_color)
-    {
-      const std_msgs::ColorRGBA& color = new_message->colors[i];
-      r = color.r;
-      g = color.g;
-      b = color.b;
-    }
-
-    point.setColor(r, g, b);
-  }
+  points_->setAlpha(new_message->color.a);
 
-  points_->addPoints(&points.front(), points.size());
+  MarkerGeometryConstPtr geometry = getGeometry();
+  points_->addPoints(&geometry->points.front(), geometry->points.size());
 
   context_->getSelectionManager()->removeObject(coll_);
   coll_ = context_->getSelectionManager()->createHandle();
@@ -143,6 +111,7 @@ void PointsMarker::onNewMessage(const MarkerConstPtr& old_message, const MarkerC
   points_->setPickColor(col);
 
   SelectionHandlerPtr handler( new MarkerSelectionHandler(this, MarkerID(new_message->ns, new_message->id)) );
+  handler->addTrackedObject( points_ );
   context_->getSelectionManager()->addObject( coll_, handler );
 }
 
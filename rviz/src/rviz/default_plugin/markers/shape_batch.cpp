@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "shape_batch.h"
+#include "batched_shape_marker.h"
+
+#include "rviz/default_plugin/point_cloud_common.h"
+#include "rviz/display_context.h"
+#include "rviz/properties/property.h"
+#include "rviz/properties/vector_property.h"
+#include "rviz/selection/selection_manager.h"
+
+#include <visualization_msgs/Marker.h>
+
+#include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreSceneNode.h>
+
+namespace rviz
+{
+
+/** @brief Selects single markers of a ShapeBatch, by their point index. */
+class ShapeBatchSelectionHandler: public SelectionHandler
+{
+public:
+  ShapeBatchSelectionHandler( ShapeBatch* batch )
+  : batch_( batch )
+  {}
+
+  virtual bool needsAdditionalRenderPass( uint32_t pass )
+  {
+    // Pass 1 renders the index of each marker.  Batches never get
+    // near the 2^24 markers a second pass would be needed for.
+    return pass == 1;
+  }
+
+  virtual void preRenderPass( uint32_t pass )
+  {
+    SelectionHandler::preRenderPass( pass );
+    if( pass == 1 )
+    {
+      batch_->cloud_->setColorByIndex( true );
+    }
+  }
+
+  virtual void postRenderPass( uint32_t pass )
+  {
+    SelectionHandler::postRenderPass( pass );
+    if( pass == 1 )
+    {
+      batch_->cloud_->setColorByIndex( false );
+    }
+  }
+
+  virtual bool intersectRay( const Ogre::Ray& ray, float pixel_angle, float& distance, uint64_t& extra_handle )
+  {
+    uint32_t index;
+    if( batch_->cloud_->intersectRay( ray, pixel_angle, index, distance ))
+    {
+      extra_handle = PointCloudSelectionHandler::indexToExtraHandle( index );
+      return true;
+    }
+    return false;
+  }
+
+  virtual void getAABBs( const Picked& obj, V_AABB& aabbs )
+  {
+    S_uint64::const_iterator it = obj.extra_handles.begin();
+    for( ; it != obj.extra_handles.end(); ++it )
+    {
+      uint32_t index = PointCloudSelectionHandler::extraHandleToIndex( *it );
+      if( index < batch_->size() )
+      {
+        aabbs.push_back( batch_->getBounds( index ));
+      }
+    }
+  }
+
+  virtual void createProperties( const Picked& obj, Property* parent_property )
+  {
+    S_uint64::const_iterator it = obj.extra_handles.begin();
+    for( ; it != obj.extra_handles.end(); ++it )
+    {
+      BatchedShapeMarker* marker = batch_->getMarker( PointCloudSelectionHandler::extraHandleToIndex( *it ));
+      if( !marker )
+      {
+        continue;
+      }
+
+      MarkerID id = marker->getID();
+      Property* group = new Property( "Marker " + QString::fromStdString( id.first ) + "/" + QString::number( id.second ),
+                                      QVariant(), "", parent_property );
+      properties_.push_back( group );
+
+      const geometry_msgs::Point& position = marker->getMessage()->pose.position;
+      VectorProperty* position_property = new VectorProperty( "Position", Ogre::Vector3( position.x, position.y, position.z ),
+                                                               "", group );
+      position_property->setReadOnly( true );
+    }
+  }
+
+private:
+  ShapeBatch* batch_;
+};
+
+bool ShapeBatch::Key::operator<( const Key& other ) const
+{
+  if( type != other.type ) return type < other.type;
+  if( alpha != other.alpha ) return alpha < other.alpha;
+  if( scale.x != other.scale.x ) return scale.x < other.scale.x;
+  if( scale.y != other.scale.y ) return scale.y < other.scale.y;
+  if( scale.z != other.scale.z ) return scale.z < other.scale.z;
+  if( orientation.w != other.orientation.w ) return orientation.w < other.orientation.w;
+  if( orientation.x != other.orientation.x ) return orientation.x < other.orientation.x;
+  if( orientation.y != other.orientation.y ) return orientation.y < other.orientation.y;
+  return orientation.z < other.orientation.z;
+}
+
+ShapeBatch::ShapeBatch( DisplayContext* context, Ogre::SceneNode* parent_node, const Key& key )
+: context_( context )
+, key_( key )
+, scene_node_( parent_node->createChildSceneNode() )
+, cloud_( new PointCloud() )
+, dirty_( false )
+{
+  scene_node_->setOrientation( key.orientation );
+  scene_node_->attachObject( cloud_ );
+
+  cloud_->setRenderMode( key.type == visualization_msgs::Marker::SPHERE ? PointCloud::RM_SPHERES : PointCloud::RM_BOXES );
+  cloud_->setDimensions( key.scale.x, key.scale.y, key.scale.z );
+  cloud_->setAlpha( key.alpha );
+
+  SelectionManager* sel_manager = context_->getSelectionManager();
+  coll_ = sel_manager->createHandle();
+  float r = ((coll_ >> 16) & 0xff) / 255.0f;
+  float g = ((coll_ >> 8) & 0xff) / 255.0f;
+  float b = (coll_ & 0xff) / 255.0f;
+  cloud_->setPickColor( Ogre::ColourValue( r, g, b, 1.0f ));
+
+  handler_.reset( new ShapeBatchSelectionHandler( this ));
+  handler_->addTrackedObject( cloud_ );
+  sel_manager->addObject( coll_, handler_ );
+}
+
+ShapeBatch::~ShapeBatch()
+{
+  context_->getSelectionManager()->removeObject( coll_ );
+  delete cloud_;
+  context_->getSceneManager()->destroySceneNode( scene_node_ );
+}
+
+uint32_t ShapeBatch::add( BatchedShapeMarker* marker, const Ogre::Vector3& position, const Ogre::ColourValue& color )
+{
+  markers_.push_back( marker );
+  points_.push_back( PointCloud::Point() );
+  set( markers_.size() - 1, position, color );
+  return markers_.size() - 1;
+}
+
+void ShapeBatch::set( uint32_t index, const Ogre::Vector3& position, const Ogre::ColourValue& color )
+{
+  Ogre::Vector3 local = key_.orientation.Inverse() * position;
+  PointCloud::Point& point = points_[ index ];
+  point.x = local.x;
+  point.y = local.y;
+  point.z = local.z;
+  point.setColor( color.r, color.g, color.b );
+  dirty_ = true;
+}
+
+void ShapeBatch::remove( uint32_t index )
+{
+  if( index + 1 < markers_.size() )
+  {
+    markers_[ index ] = markers_.back();
+    points_[ index ] = points_.back();
+    markers_[ index ]->setBatchIndex( index );
+  }
+  markers_.pop_back();
+  points_.pop_back();
+  dirty_ = true;
+}
+
+Ogre::AxisAlignedBox ShapeBatch::getBounds( uint32_t index ) const
+{
+  const PointCloud::Point& point = points_[ index ];
+  Ogre::Vector3 center = key_.orientation * Ogre::Vector3( point.x, point.y, point.z );
+  // Big enough for any orientation of the box
+  Ogre::Vector3 half( key_.scale.length() * 0.5f );
+  return Ogre::AxisAlignedBox( center - half, center + half );
+}
+
+void ShapeBatch::update()
+{
+  if( !dirty_ )
+  {
+    return;
+  }
+
+  cloud_->clear();
+  if( !points_.empty() )
+  {
+    cloud_->addPoints( &points_.front(), points_.size() );
+  }
+  dirty_ = false;
+}
+
+} // namespace rviz
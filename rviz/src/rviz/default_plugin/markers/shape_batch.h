@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_SHAPE_BATCH_H
+#define RVIZ_SHAPE_BATCH_H
+
+#include <vector>
+
+#include <OGRE/OgreColourValue.h>
+#include <OGRE/OgreQuaternion.h>
+#include <OGRE/OgreVector3.h>
+
+#include "rviz/ogre_helpers/point_cloud.h"
+#include "rviz/selection/forwards.h"
+
+namespace Ogre
+{
+class SceneNode;
+}
+
+namespace rviz
+{
+class BatchedShapeMarker;
+class DisplayContext;
+
+/** @brief Draws many CUBE or SPHERE markers as one PointCloud.
+ *
+ * All markers of a batch share the shape, scale, orientation and
+ * alpha given by its Key; each has its own position and color.  Only
+ * unrotated markers are batched, so the orientation is that of their
+ * frame, and all the markers of a frame land in one batch.  That
+ * turns thousands of entities, materials and draw calls into a few
+ * vertex buffers.  Each marker stays selectable on its own. */
+class ShapeBatch
+{
+public:
+  /** @brief What the markers of one batch have in common. */
+  struct Key
+  {
+    int32_t type;                  ///< visualization_msgs::Marker::CUBE or SPHERE
+    Ogre::Vector3 scale;
+    Ogre::Quaternion orientation;  ///< Of the markers' frame, in the fixed frame
+    float alpha;
+
+    bool operator<( const Key& other ) const;
+    bool operator==( const Key& other ) const { return !(*this < other) && !(other < *this); }
+  };
+
+  ShapeBatch( DisplayContext* context, Ogre::SceneNode* parent_node, const Key& key );
+  ~ShapeBatch();
+
+  const Key& getKey() const { return key_; }
+
+  /** @brief Add a marker at a position in the fixed frame.  Returns its index in the batch. */
+  uint32_t add( BatchedShapeMarker* marker, const Ogre::Vector3& position, const Ogre::ColourValue& color );
+
+  /** @brief Move or recolor the marker at @a index. */
+  void set( uint32_t index, const Ogre::Vector3& position, const Ogre::ColourValue& color );
+
+  /** @brief Remove the marker at @a index.  The last marker takes its index. */
+  void remove( uint32_t index );
+
+  size_t size() const { return markers_.size(); }
+
+  BatchedShapeMarker* getMarker( uint32_t index ) const { return index < markers_.size() ? markers_[ index ] : 0; }
+
+  /** @brief Return the world-space box around the marker at @a index. */
+  Ogre::AxisAlignedBox getBounds( uint32_t index ) const;
+
+  /** @brief Rebuild the point cloud if markers changed.  Called once per frame. */
+  void update();
+
+private:
+  friend class ShapeBatchSelectionHandler;
+
+  DisplayContext* context_;
+  Key key_;
+
+  Ogre::SceneNode* scene_node_;     ///< Carries the orientation of the batch
+  PointCloud* cloud_;
+  std::vector<BatchedShapeMarker*> markers_;
+  std::vector<PointCloud::Point> points_;   ///< Same order as markers_, in scene_node_'s frame
+  bool dirty_;                              ///< points_ changed since the last update()
+
+  CollObjectHandle coll_;
+  SelectionHandlerPtr handler_;
+};
+
+} // namespace rviz
+
+#endif // RVIZ_SHAPE_BATCH_H
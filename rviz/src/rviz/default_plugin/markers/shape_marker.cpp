@@ -108,8 +108,7 @@ void ShapeMarker::onNewMessage( const MarkerConstPtr& old_message,
         "Scale of 0 in one of x/y/z");
   }
 
-  setPosition(pos);
-  setOrientation( orient * Ogre::Quaternion( Ogre::Degree(90), Ogre::Vector3(1,0,0) ) );
+  setPose(pos, orient);
 
   scale_correct = Ogre::Quaternion( Ogre::Degree(90), Ogre::Vector3(1,0,0) ) * scale;
 
@@ -119,6 +118,13 @@ void ShapeMarker::onNewMessage( const MarkerConstPtr& old_message,
       new_message->color.b, new_message->color.a);
 }
 
+void ShapeMarker::setPose( const Ogre::Vector3& position, const Ogre::Quaternion& orientation )
+{
+  // Ogre's shapes are built along a different axis than the markers are.
+  setPosition( position );
+  setOrientation( orientation * Ogre::Quaternion( Ogre::Degree(90), Ogre::Vector3(1,0,0) ) );
+}
+
 S_MaterialPtr ShapeMarker::getMaterials()
 {
   S_MaterialPtr materials;
@@ -49,6 +49,7 @@ public:
 
 protected:
   virtual void onNewMessage( const MarkerConstPtr& old_message, const MarkerConstPtr& new_message );
+  virtual void setPose( const Ogre::Vector3& position, const Ogre::Quaternion& orientation );
 
   Shape* shape_;
 };
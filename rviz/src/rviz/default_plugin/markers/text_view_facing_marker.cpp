@@ -67,6 +67,7 @@ void TextViewFacingMarker::onNewMessage(const MarkerConstPtr& old_message, const
     coll_ = context_->getSelectionManager()->createHandle();
     context_->getSelectionManager()->addPickTechnique( coll_, text_->getMaterial() );
     SelectionHandlerPtr handler( new MarkerSelectionHandler(this, MarkerID(new_message->ns, new_message->id)) );
+    handler->addTrackedObject( text_ );
     context_->getSelectionManager()->addObject( coll_, handler );
   }
 
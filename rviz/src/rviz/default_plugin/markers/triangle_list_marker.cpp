@@ -151,23 +151,16 @@ void TriangleListMarker::onNewMessage(const MarkerConstPtr& old_message, const M
     manual_object_->begin(material_name_, Ogre::RenderOperation::OT_TRIANGLE_LIST);
   }
 
-  bool has_vertex_colors = new_message->colors.size() == num_points;
-  bool any_vertex_has_alpha = false;
+  MarkerGeometryConstPtr geometry = getGeometry();
+  bool has_vertex_colors = !geometry->colors.empty();
+  bool any_vertex_has_alpha = geometry->any_vertex_has_alpha;
 
-  if (has_vertex_colors)
-  {
-    for (size_t i = 0; i < num_points; ++i)
-    {
-      manual_object_->position(new_message->points[i].x, new_message->points[i].y, new_message->points[i].z);
-      any_vertex_has_alpha = any_vertex_has_alpha || (new_message->colors[i].a < 0.9998);
-      manual_object_->colour(new_message->colors[i].r, new_message->colors[i].g, new_message->colors[i].b, new_message->color.a * new_message->colors[i].a);
-    }
-  }
-  else
+  for (size_t i = 0; i < num_points; ++i)
   {
-    for (size_t i = 0; i < num_points; ++i)
+    manual_object_->position(geometry->positions[i]);
+    if (has_vertex_colors)
     {
-      manual_object_->position(new_message->points[i].x, new_message->points[i].y, new_message->points[i].z);
+      manual_object_->colour(geometry->colors[i]);
     }
   }
 
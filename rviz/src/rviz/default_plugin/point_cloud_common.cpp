@@ -27,10 +27,20 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+
 #include <QColor>
 
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <yaml-cpp/node.h>
+
+#include <OGRE/OgreCamera.h>
 #include <OGRE/OgreSceneManager.h>
 #include <OGRE/OgreSceneNode.h>
+#include <OGRE/OgreViewport.h>
 #include <OGRE/OgreWireBoundingBox.h>
 
 #include <ros/time.h>
@@ -48,15 +58,71 @@
 #include "rviz/properties/bool_property.h"
 #include "rviz/properties/enum_property.h"
 #include "rviz/properties/float_property.h"
+#include "rviz/properties/int_property.h"
 #include "rviz/properties/vector_property.h"
 #include "rviz/uniform_string_stream.h"
 #include "rviz/validate_floats.h"
+#include "rviz/view_controller.h"
+#include "rviz/view_manager.h"
+#include "rviz/worker_pool.h"
 
 #include "rviz/default_plugin/point_cloud_common.h"
 
 namespace rviz
 {
 
+/** Clouds are only split over the worker pool in blocks of at least this many points. */
+static const size_t MIN_POINTS_PER_BLOCK = 64 * 1024;
+
+/// Wall time spent recoloring clouds per update() before the rest is left for the next frame.
+static const double RECOLOR_TIME_BUDGET = 0.01;
+
+/// Colors are written to the vertex buffers in slices of this many points, so big clouds are spread over frames.
+static const uint32_t RECOLOR_SLICE_POINTS = 256 * 1024;
+
+/// At most this many emptied PointClouds are kept for reuse.  Expiry may leave more, which are freed one per update().
+static const size_t MAX_SPARE_CLOUDS = 8;
+
+/// Wall time spent decimating existing clouds again per update() after the camera moved.
+static const double REDECIMATE_TIME_BUDGET = 0.01;
+
+/**
+ * \brief Validate and pack the transformer output for points [begin, end) into render points.
+ */
+static void packPoints( const V_PointCloudPoint* cloud_points, PointCloud::Point* points, size_t begin, size_t end )
+{
+  for( size_t i = begin; i < end; ++i )
+  {
+    const Ogre::Vector3& pos = (*cloud_points)[i].position;
+    const Ogre::ColourValue& color = (*cloud_points)[i].color;
+    PointCloud::Point& point = points[i];
+    if( validateFloats( pos ))
+    {
+      point.x = pos.x;
+      point.y = pos.y;
+      point.z = pos.z;
+    }
+    else
+    {
+      point.x = 999999.0f;
+      point.y = 999999.0f;
+      point.z = 999999.0f;
+    }
+    point.setColor( color.r, color.g, color.b );
+  }
+}
+
+/**
+ * \brief Pack the voxel coordinates of a point into one key, 21 bits per axis
+ */
+static inline uint64_t voxelKey( const PointCloud::Point& p, float inv_voxel_size )
+{
+  uint64_t x = (uint64_t) (int64_t) floorf( p.x * inv_voxel_size ) & 0x1fffff;
+  uint64_t y = (uint64_t) (int64_t) floorf( p.y * inv_voxel_size ) & 0x1fffff;
+  uint64_t z = (uint64_t) (int64_t) floorf( p.z * inv_voxel_size ) & 0x1fffff;
+  return x | (y << 21) | (z << 42);
+}
+
 struct IndexAndMessage
 {
   IndexAndMessage( int _index, const void* _message )
@@ -90,13 +156,38 @@ PointCloudSelectionHandler::~PointCloudSelectionHandler()
 {
 }
 
+bool PointCloudSelectionHandler::needsAdditionalRenderPass(uint32_t pass)
+{
+  // Pass 1 renders the low 24 bits of each point's pick index, pass 2 the rest if there are that many points
+  if (pass == 1)
+  {
+    return true;
+  }
+  if (pass == 2)
+  {
+    return display_->total_point_count_ >= 0xffffff;
+  }
+
+  return false;
+}
+
 void PointCloudSelectionHandler::preRenderPass(uint32_t pass)
 {
   SelectionHandler::preRenderPass(pass);
 
-  if (pass == 1)
+  if (pass == 1 || pass == 2)
   {
-    display_->cloud_->setColorByIndex(true);
+    // Number the points of all clouds consecutively, as getCloudAndLocalIndexByGlobalIndex() expects
+    boost::mutex::scoped_lock lock(display_->clouds_mutex_);
+    const std::vector<uint32_t>& offsets = display_->getCloudOffsets();
+    for (size_t i = 0; i < display_->clouds_.size(); ++i)
+    {
+      const PointCloudCommon::CloudInfoPtr& info = display_->clouds_[i];
+      if (info->cloud_)
+      {
+        info->cloud_->setColorByIndex(true, offsets[i], (pass - 1) * 24);
+      }
+    }
   }
 }
 
@@ -104,34 +195,90 @@ void PointCloudSelectionHandler::postRenderPass(uint32_t pass)
 {
   SelectionHandler::postRenderPass(pass);
 
-  if (pass == 1)
+  if (pass == 1 || pass == 2)
   {
-    display_->cloud_->setColorByIndex(false);
+    boost::mutex::scoped_lock lock(display_->clouds_mutex_);
+    PointCloudCommon::D_CloudInfo::iterator cloud_it = display_->clouds_.begin();
+    PointCloudCommon::D_CloudInfo::iterator cloud_end = display_->clouds_.end();
+    for (;cloud_it != cloud_end; ++cloud_it)
+    {
+      const PointCloudCommon::CloudInfoPtr& info = *cloud_it;
+      if (info->cloud_)
+      {
+        info->cloud_->setColorByIndex(false);
+      }
+    }
   }
 }
 
-void PointCloudSelectionHandler::getCloudAndLocalIndexByGlobalIndex(int global_index, PointCloudCommon::CloudInfoPtr& cloud_out, int& index_out)
+void PointCloudSelectionHandler::getCloudAndLocalIndexByGlobalIndex(uint32_t global_index, PointCloudCommon::CloudInfoPtr& cloud_out, int& index_out)
 {
   boost::mutex::scoped_lock lock(display_->clouds_mutex_);
 
-  int count = 0;
+  // Find the last cloud starting at or before global_index
+  const std::vector<uint32_t>& offsets = display_->getCloudOffsets();
+  std::vector<uint32_t>::const_iterator offset_it = std::upper_bound(offsets.begin(), offsets.end(), global_index);
+  if (offset_it == offsets.begin())
+  {
+    return;
+  }
+  --offset_it;
 
+  const PointCloudCommon::CloudInfoPtr& info = display_->clouds_[offset_it - offsets.begin()];
+  uint32_t local_index = global_index - *offset_it;
+  if (local_index >= info->num_points_)
+  {
+    return;
+  }
+
+  index_out = local_index;
+  if (!info->indices_.empty())
+  {
+    index_out = info->indices_[index_out];
+  }
+  cloud_out = info;
+}
+
+Ogre::AxisAlignedBox PointCloudSelectionHandler::getPickBounds()
+{
+  boost::mutex::scoped_lock lock(display_->clouds_mutex_);
+
+  Ogre::AxisAlignedBox bounds;
   PointCloudCommon::D_CloudInfo::iterator cloud_it = display_->clouds_.begin();
   PointCloudCommon::D_CloudInfo::iterator cloud_end = display_->clouds_.end();
   for (;cloud_it != cloud_end; ++cloud_it)
   {
     const PointCloudCommon::CloudInfoPtr& info = *cloud_it;
-
-    if (global_index < count + (int)info->num_points_)
+    if (info->cloud_)
     {
-      index_out = global_index - count;
-      cloud_out = info;
-
-      return;
+      bounds.merge(info->cloud_->getWorldBoundingBox(true));
     }
+  }
+  return bounds;
+}
 
-    count += info->message_->width * info->message_->height;
+bool PointCloudSelectionHandler::intersectRay( const Ogre::Ray& ray, float pixel_angle, float& distance, uint64_t& extra_handle )
+{
+  boost::mutex::scoped_lock lock(display_->clouds_mutex_);
+
+  // Same global numbering as the color-by-index render pass in preRenderPass()
+  bool hit = false;
+  const std::vector<uint32_t>& offsets = display_->getCloudOffsets();
+  for (size_t i = 0; i < display_->clouds_.size(); ++i)
+  {
+    const PointCloudCommon::CloudInfoPtr& info = display_->clouds_[i];
+    uint32_t index;
+    float cloud_distance;
+    if (info->cloud_ && info->cloud_->intersectRay(ray, pixel_angle, index, cloud_distance) &&
+        (!hit || cloud_distance < distance))
+    {
+      hit = true;
+      distance = cloud_distance;
+      extra_handle = indexToExtraHandle(offsets[i] + index);
+    }
   }
+
+  return hit;
 }
 
 Ogre::Vector3 pointFromCloud(const sensor_msgs::PointCloud2ConstPtr& cloud, uint32_t index)
@@ -153,24 +300,23 @@ Ogre::Vector3 pointFromCloud(const sensor_msgs::PointCloud2ConstPtr& cloud, uint
 
 void PointCloudSelectionHandler::createProperties( const Picked& obj, Property* parent_property )
 {
-  typedef std::set<int> S_int;
-  S_int indices;
+  typedef std::set<uint32_t> S_uint;
+  S_uint indices;
   {
     S_uint64::const_iterator it = obj.extra_handles.begin();
     S_uint64::const_iterator end = obj.extra_handles.end();
     for (; it != end; ++it)
     {
-      uint64_t handle = *it;
-      indices.insert((handle & 0xffffffff) - 1);
+      indices.insert(extraHandleToIndex(*it));
     }
   }
 
   {
-    S_int::iterator it = indices.begin();
-    S_int::iterator end = indices.end();
+    S_uint::iterator it = indices.begin();
+    S_uint::iterator end = indices.end();
     for (; it != end; ++it)
     {
-      int global_index = *it;
+      uint32_t global_index = *it;
       int index = 0;
       PointCloudCommon::CloudInfoPtr cloud;
 
@@ -191,7 +337,7 @@ void PointCloudSelectionHandler::createProperties( const Picked& obj, Property*
         property_hash_.insert( hash_key, cat );
 
         // First add the position.
-        VectorProperty* pos_prop = new VectorProperty( "Position", cloud->transformed_points_[index].position, "", cat );
+        VectorProperty* pos_prop = new VectorProperty( "Position", cloud->getPosition( index ), "", cat );
         pos_prop->setReadOnly( true );
 
         // Then add all other fields as well.
@@ -227,24 +373,23 @@ void PointCloudSelectionHandler::createProperties( const Picked& obj, Property*
 
 void PointCloudSelectionHandler::destroyProperties( const Picked& obj, Property* parent_property )
 {
-  typedef std::set<int> S_int;
-  S_int indices;
+  typedef std::set<uint32_t> S_uint;
+  S_uint indices;
   {
     S_uint64::const_iterator it = obj.extra_handles.begin();
     S_uint64::const_iterator end = obj.extra_handles.end();
     for (; it != end; ++it)
     {
-      uint64_t handle = *it;
-      indices.insert((handle & 0xffffffff) - 1);
+      indices.insert(extraHandleToIndex(*it));
     }
   }
 
   {
-    S_int::iterator it = indices.begin();
-    S_int::iterator end = indices.end();
+    S_uint::iterator it = indices.begin();
+    S_uint::iterator end = indices.end();
     for (; it != end; ++it)
     {
-      int global_index = *it;
+      uint32_t global_index = *it;
       int index = 0;
       PointCloudCommon::CloudInfoPtr cloud;
 
@@ -271,7 +416,7 @@ void PointCloudSelectionHandler::getAABBs(const Picked& obj, V_AABB& aabbs)
   S_uint64::iterator end = obj.extra_handles.end();
   for (; it != end; ++it)
   {
-    M_HandleToBox::iterator find_it = boxes_.find(std::make_pair(obj.handle, *it - 1));
+    M_HandleToBox::iterator find_it = boxes_.find(std::make_pair(obj.handle, (uint64_t)extraHandleToIndex(*it)));
     if (find_it != boxes_.end())
     {
       Ogre::WireBoundingBox* box = find_it->second.second;
@@ -287,7 +432,7 @@ void PointCloudSelectionHandler::onSelect(const Picked& obj)
   S_uint64::iterator end = obj.extra_handles.end();
   for (; it != end; ++it)
   {
-    int global_index = (*it & 0xffffffff) - 1;
+    uint32_t global_index = extraHandleToIndex(*it);
 
     int index = 0;
     PointCloudCommon::CloudInfoPtr cloud;
@@ -299,9 +444,7 @@ void PointCloudSelectionHandler::onSelect(const Picked& obj)
       continue;
     }
 
-    sensor_msgs::PointCloud2ConstPtr message = cloud->message_;
-
-    Ogre::Vector3 pos = cloud->transform_ * pointFromCloud(message, index);
+    Ogre::Vector3 pos = cloud->getPosition(index);
 
     float size = display_->getSelectionBoxSize() * 0.5f;
 
@@ -317,7 +460,7 @@ void PointCloudSelectionHandler::onDeselect(const Picked& obj)
   S_uint64::iterator end = obj.extra_handles.end();
   for (; it != end; ++it)
   {
-    int global_index = (*it & 0xffffffff) - 1;
+    uint32_t global_index = extraHandleToIndex(*it);
 
     destroyBox(std::make_pair(obj.handle, global_index));
   }
@@ -326,26 +469,63 @@ void PointCloudSelectionHandler::onDeselect(const Picked& obj)
 PointCloudCommon::CloudInfo::CloudInfo()
 : time_(0.0f)
 , transform_(Ogre::Matrix4::ZERO)
+, position_(Ogre::Vector3::ZERO)
+, orientation_(Ogre::Quaternion::IDENTITY)
+, manager_(0)
+, scene_node_(0)
 , num_points_(0)
+, direct_(false)
+, xyz_offset_(0)
+, rgb_offset_(0)
+, lod_voxel_size_(0.0f)
+, color_version_(0)
 {}
 
 PointCloudCommon::CloudInfo::~CloudInfo()
 {
+  clear();
+}
+
+void PointCloudCommon::CloudInfo::clear()
+{
+  if( scene_node_ )
+  {
+    manager_->destroySceneNode( scene_node_ );
+    scene_node_ = 0;
+  }
+  cloud_.reset();
+}
+
+Ogre::Vector3 PointCloudCommon::CloudInfo::getPosition( uint32_t index ) const
+{
+  if( !positions_.empty() )
+  {
+    return transform_ * positions_[ index ];
+  }
+
+  return transform_ * pointFromCloud( message_, index );
 }
 
 PointCloudCommon::PointCloudCommon( Display* display )
-: spinner_(1, &cbqueue_)
+: cloud_offsets_dirty_(true)
 , new_cloud_(false)
 , new_xyz_transformer_(false)
 , new_color_transformer_(false)
 , needs_retransform_(false)
+, needs_recolor_(false)
+, color_version_(0)
+, recoloring_(false)
+, recolor_cloud_index_(0)
+, recolor_point_offset_(0)
 , coll_handle_(0)
 , total_point_count_(0)
+, lod_camera_position_(Ogre::Vector3::ZERO)
+, lod_meters_per_meter_(0.0f)
+, lod_cloud_count_(0)
+, lod_arrival_interval_(0.0)
 , transformer_class_loader_( new pluginlib::ClassLoader<PointCloudTransformer>( "rviz", "rviz::PointCloudTransformer" ))
 , display_( display )
 {
-  cloud_ = new PointCloud();
-
   selectable_property_ = new BoolProperty( "Selectable", true,
                                            "Whether or not the points in this point cloud are selectable.",
                                            display_, SLOT( updateSelectable() ), this );
@@ -358,6 +538,26 @@ PointCloudCommon::PointCloudCommon( Display* display )
   style_property_->addOption( "Spheres", PointCloud::RM_SPHERES );
   style_property_->addOption( "Boxes", PointCloud::RM_BOXES );
 
+  decimation_property_ = new EnumProperty( "Decimation", "None",
+                                           "Thin out large clouds before rendering them.  "
+                                           "Voxel Grid keeps one point per voxel, with voxels that grow with distance from the camera.",
+                                           display_, SLOT( updateDecimation() ), this );
+  decimation_property_->addOption( "None", DecimationNone );
+  decimation_property_->addOption( "Voxel Grid", DecimationVoxelGrid );
+
+  voxel_size_property_ = new FloatProperty( "Voxel Size (m)", 0.05,
+                                            "Smallest voxel size.  Voxels get larger for clouds far from the camera, "
+                                            "so that no more than about one point is kept per pixel.  Clouds already shown "
+                                            "are decimated again once their distance to the camera changed by more than a factor of two.",
+                                            decimation_property_, SLOT( causeRetransform() ), this );
+  voxel_size_property_->setMin( 0.001 );
+
+  point_budget_property_ = new IntProperty( "Point Budget", 5000000,
+                                            "Maximum number of points to render, shared between all the clouds in the decay window.  "
+                                            "Voxels are made coarser until each cloud fits its share.",
+                                            decimation_property_, SLOT( causeRetransform() ), this );
+  point_budget_property_->setMin( 1 );
+
   point_world_size_property_ = new FloatProperty( "Size (m)", 0.01,
                                                 "Point size in meters.",
                                                 display_, SLOT( updateBillboardSize() ), this );
@@ -379,6 +579,12 @@ PointCloudCommon::PointCloudCommon( Display* display )
                                             display_, SLOT( queueRender() ));
   decay_time_property_->setMin( 0 );
 
+  cache_positions_property_ = new BoolProperty( "Cache Positions", false,
+                                                "Keep the position of every point from the position transformer for selection, at 12 bytes per point.  "
+                                                "Only needed if the position transformer does more than read the x/y/z fields, "
+                                                "otherwise positions are recomputed from the message.",
+                                                display_ );
+
   xyz_transformer_property_ = new EnumProperty( "Position Transformer", "",
                                                 "Set the transformer to use to set the position of the points.",
                                                 display_, SLOT( updateXyzTransformer() ), this );
@@ -398,20 +604,27 @@ void PointCloudCommon::initialize( DisplayContext* context, Ogre::SceneNode* sce
 {
   context_ = context;
   scene_node_ = scene_node;
-  scene_node_->attachObject(cloud_);
   coll_handler_ = PointCloudSelectionHandlerPtr(new PointCloudSelectionHandler(this));
 
+  if (WorkerPool* pool = context_->getWorkerPool())
+  {
+    recolor_queue_ = pool->createQueue();
+  }
+
   updateStyle();
+  updateDecimation();
   updateBillboardSize();
   updateAlpha();
   updateSelectable();
-
-  spinner_.start();
 }
 
 PointCloudCommon::~PointCloudCommon()
 {
-  spinner_.stop();
+  // Recolor jobs use the transformers
+  if (recolor_queue_)
+  {
+    recolor_queue_->close();
+  }
 
   if (coll_handle_)
   {
@@ -419,7 +632,11 @@ PointCloudCommon::~PointCloudCommon()
     sel_manager->removeObject(coll_handle_);
   }
 
-  delete cloud_;
+  // Destroy the clouds' scene nodes while the scene manager is still around
+  clouds_.clear();
+  new_clouds_.clear();
+  spare_clouds_.clear();
+
   delete transformer_class_loader_;
 }
 
@@ -441,7 +658,7 @@ void PointCloudCommon::loadTransformers()
 
     PointCloudTransformerPtr trans( transformer_class_loader_->createUnmanagedInstance( lookup_name ));
     trans->init();
-    connect( trans.get(), SIGNAL( needRetransform() ), this, SLOT( causeRetransform() ));
+    connect( trans.get(), SIGNAL( needRetransform() ), this, SLOT( onTransformerChanged() ));
 
     TransformerInfo info;
     info.transformer = trans;
@@ -460,7 +677,14 @@ void PointCloudCommon::loadTransformers()
 
 void PointCloudCommon::updateAlpha()
 {
-  cloud_->setAlpha( alpha_property_->getFloat() );
+  boost::mutex::scoped_lock lock(clouds_mutex_);
+  for (D_CloudInfo::iterator it = clouds_.begin(); it != clouds_.end(); ++it)
+  {
+    if ((*it)->cloud_)
+    {
+      (*it)->cloud_->setAlpha( alpha_property_->getFloat() );
+    }
+  }
 }
 
 void PointCloudCommon::updateSelectable()
@@ -479,14 +703,22 @@ void PointCloudCommon::updateSelectable()
     float r = ((coll_handle_ >> 16) & 0xff) / 255.0f;
     float g = ((coll_handle_ >> 8) & 0xff) / 255.0f;
     float b = (coll_handle_ & 0xff) / 255.0f;
-    Ogre::ColourValue col( r, g, b, 1.0f );
-    cloud_->setPickColor( col );
+    pick_color_ = Ogre::ColourValue( r, g, b, 1.0f );
   }
   else
   {
     sel_manager->removeObject( coll_handle_ );
     coll_handle_ = 0;
-    cloud_->setPickColor( Ogre::ColourValue( 0.0f, 0.0f, 0.0f, 0.0f ));
+    pick_color_ = Ogre::ColourValue( 0.0f, 0.0f, 0.0f, 0.0f );
+  }
+
+  boost::mutex::scoped_lock lock(clouds_mutex_);
+  for (D_CloudInfo::iterator it = clouds_.begin(); it != clouds_.end(); ++it)
+  {
+    if ((*it)->cloud_)
+    {
+      (*it)->cloud_->setPickColor( pick_color_ );
+    }
   }
 }
 
@@ -503,10 +735,31 @@ void PointCloudCommon::updateStyle()
     point_world_size_property_->show();
     point_pixel_size_property_->hide();
   }
-  cloud_->setRenderMode( mode );
+  {
+    boost::mutex::scoped_lock lock(clouds_mutex_);
+    for (D_CloudInfo::iterator it = clouds_.begin(); it != clouds_.end(); ++it)
+    {
+      if ((*it)->cloud_)
+      {
+        (*it)->cloud_->setRenderMode( mode );
+      }
+    }
+  }
   updateBillboardSize();
 }
 
+void PointCloudCommon::updateDecimation()
+{
+  bool decimate = decimation_property_->getOptionInt() != DecimationNone;
+  voxel_size_property_->setHidden( !decimate );
+  point_budget_property_->setHidden( !decimate );
+  if( decimate )
+  {
+    decimation_property_->expand();
+  }
+  causeRetransform();
+}
+
 void PointCloudCommon::updateBillboardSize()
 {
   PointCloud::RenderMode mode = (PointCloud::RenderMode) style_property_->getOptionInt();
@@ -516,15 +769,63 @@ void PointCloudCommon::updateBillboardSize()
   } else {
     size = point_world_size_property_->getFloat();
   }
-  cloud_->setDimensions( size, size, size );
+  {
+    boost::mutex::scoped_lock lock(clouds_mutex_);
+    for (D_CloudInfo::iterator it = clouds_.begin(); it != clouds_.end(); ++it)
+    {
+      if ((*it)->cloud_)
+      {
+        (*it)->cloud_->setDimensions( size, size, size );
+      }
+    }
+  }
   context_->queueRender();
 }
 
 void PointCloudCommon::reset()
 {
   clouds_.clear();
-  cloud_->clear();
+  cloud_offsets_dirty_ = true;
   total_point_count_ = 0;
+  recoloring_ = false;
+  recolor_job_.reset();
+}
+
+void PointCloudCommon::loadOldSettings( const YAML::Node& yaml_node )
+{
+  // The intensity transformer used to have a "Use rainbow" switch with Min Color and Max Color below it
+  const YAML::Node* rainbow_node = yaml_node.FindValue( "Use rainbow" );
+  if( !rainbow_node || yaml_node.FindValue( "Colormap" ))
+  {
+    return;
+  }
+
+  Property* colormap = display_->subProp( "Colormap" );
+  bool use_rainbow = true;
+  if( rainbow_node->Type() == YAML::NodeType::Map )
+  {
+    if( const YAML::Node* value_node = rainbow_node->FindValue( "Value" ))
+    {
+      *value_node >> use_rainbow;
+    }
+    if( const YAML::Node* min_node = rainbow_node->FindValue( "Min Color" ))
+    {
+      colormap->subProp( "Min Color" )->load( *min_node );
+    }
+    if( const YAML::Node* max_node = rainbow_node->FindValue( "Max Color" ))
+    {
+      colormap->subProp( "Max Color" )->load( *max_node );
+    }
+  }
+  else if( rainbow_node->Type() == YAML::NodeType::Scalar )
+  {
+    *rainbow_node >> use_rainbow;
+  }
+
+  if( !use_rainbow )
+  {
+    colormap->setValue( "Min/Max Color" );
+  }
 }
 
 void PointCloudCommon::causeRetransform()
@@ -533,9 +834,52 @@ void PointCloudCommon::causeRetransform()
   needs_retransform_ = true;
 }
 
+void PointCloudCommon::onTransformerChanged()
+{
+  bool is_xyz = true;
+  bool is_color = true;
+  {
+    boost::recursive_mutex::scoped_lock lock( transformers_mutex_ );
+    PointCloudTransformer* trans = qobject_cast<PointCloudTransformer*>( sender() );
+    M_TransformerInfo::iterator it = transformers_.begin();
+    M_TransformerInfo::iterator end = transformers_.end();
+    for (; it != end; ++it)
+    {
+      if( it->second.transformer.get() == trans )
+      {
+        is_xyz = it->first == xyz_transformer_property_->getStdString();
+        is_color = it->first == color_transformer_property_->getStdString();
+        break;
+      }
+    }
+  }
+
+  if( is_xyz )
+  {
+    causeRetransform();
+  }
+  else if( is_color )
+  {
+    // Only the colors changed, so the positions already in the vertex buffers can stay
+    boost::mutex::scoped_lock lock(clouds_mutex_);
+    ++color_version_;
+    needs_recolor_ = true;
+  }
+}
+
 void PointCloudCommon::update(float wall_dt, float ros_dt)
 {
   float point_decay_time = decay_time_property_->getFloat();
+
+  ViewController* view = context_->getViewManager()->getCurrent();
+  if( view && view->getCamera() && view->getCamera()->getViewport() )
+  {
+    Ogre::Camera* camera = view->getCamera();
+    boost::mutex::scoped_lock lock( lod_mutex_ );
+    lod_camera_position_ = camera->getDerivedPosition();
+    lod_meters_per_meter_ = camera->getFOVy().valueRadians() / std::max( 1, camera->getViewport()->getActualHeight() );
+    lod_cloud_count_ = clouds_.size();
+  }
   {
     boost::mutex::scoped_lock lock(clouds_mutex_);
 
@@ -543,6 +887,15 @@ void PointCloudCommon::update(float wall_dt, float ros_dt)
     {
       retransform();
       needs_retransform_ = false;
+      needs_recolor_ = false;
+      recoloring_ = false;
+      recolor_job_.reset();
+    }
+    else if (needs_recolor_)
+    {
+      // Carry on from where the last recolor got to, clouds done since then are caught on the next round
+      needs_recolor_ = false;
+      recoloring_ = true;
     }
 
     D_CloudInfo::iterator cloud_it = clouds_.begin();
@@ -556,67 +909,92 @@ void PointCloudCommon::update(float wall_dt, float ros_dt)
 
     if( point_decay_time > 0.0f )
     {
-      bool removed = false;
-      uint32_t points_to_pop = 0;
+      uint32_t clouds_to_pop = 0;
       while( !clouds_.empty() && clouds_.front()->time_ > point_decay_time )
       {
         total_point_count_ -= clouds_.front()->num_points_;
-        points_to_pop += clouds_.front()->num_points_;
+        recycleCloud(clouds_.front());
         clouds_.pop_front();
-        removed = true;
+        ++clouds_to_pop;
       }
 
-      if (removed)
+      if (clouds_to_pop > 0)
       {
-        cloud_->popPoints(points_to_pop);
+        cloud_offsets_dirty_ = true;
+        coll_handler_->markPickBoundsDirty();
         context_->queueRender();
+        if (recolor_cloud_index_ < clouds_to_pop)
+        {
+          recolor_cloud_index_ = 0;
+          recolor_point_offset_ = 0;
+        }
+        else
+        {
+          recolor_cloud_index_ -= clouds_to_pop;
+        }
       }
     }
+
+    if (spare_clouds_.size() > MAX_SPARE_CLOUDS)
+    {
+      spare_clouds_.erase(spare_clouds_.begin());
+    }
+
+    redecimateSome();
+
+    if (recoloring_)
+    {
+      recolorSome();
+    }
   }
 
   if( new_cloud_ )
   {
     boost::mutex::scoped_lock lock(new_clouds_mutex_);
+    boost::mutex::scoped_lock clouds_lock(clouds_mutex_);
 
     if( point_decay_time == 0.0f )
     {
-      clouds_.clear();
-      cloud_->clear();
-
       ROS_ASSERT(!new_points_.empty());
       ROS_ASSERT(!new_clouds_.empty());
-      V_Point& points = new_points_.back();
-      cloud_->addPoints(&points.front(), points.size());
+
+      // Hand the scene node and PointCloud of the cloud being replaced over to the new one
+      const CloudInfoPtr& info = new_clouds_.back();
+      if (!clouds_.empty() && clouds_.back()->cloud_)
+      {
+        const CloudInfoPtr& old_info = clouds_.back();
+        info->manager_ = old_info->manager_;
+        info->scene_node_ = old_info->scene_node_;
+        info->cloud_ = old_info->cloud_;
+        old_info->scene_node_ = 0;
+        old_info->cloud_.reset();
+      }
+      clouds_.clear();
+      recolor_cloud_index_ = 0;
+      recolor_point_offset_ = 0;
+
+      addCloudPoints(info, new_points_.back());
       clouds_.push_back(new_clouds_.back());
 
-      total_point_count_ = points.size();
+      total_point_count_ = new_clouds_.back()->num_points_;
     }
     else
     {
+      ROS_ASSERT(new_points_.size() == new_clouds_.size());
+      for (size_t i = 0; i < new_clouds_.size(); ++i)
       {
-        VV_Point::iterator it = new_points_.begin();
-        VV_Point::iterator end = new_points_.end();
-        for (; it != end; ++it)
-        {
-          V_Point& points = *it;
-          total_point_count_ += points.size();
-          cloud_->addPoints( &points.front(), points.size() );
-        }
-      }
-
-      {
-        V_CloudInfo::iterator it = new_clouds_.begin();
-        V_CloudInfo::iterator end = new_clouds_.end();
-        for (; it != end; ++it)
-        {
-          clouds_.push_back(*it);
-        }
+        const CloudInfoPtr& info = new_clouds_[i];
+        total_point_count_ += info->num_points_;
+        addCloudPoints( info, new_points_[i] );
+        clouds_.push_back( info );
       }
     }
 
     new_clouds_.clear();
     new_points_.clear();
     new_cloud_ = false;
+    cloud_offsets_dirty_ = true;
+    coll_handler_->markPickBoundsDirty();
   }
 
   {
@@ -721,6 +1099,17 @@ void PointCloudCommon::updateStatus()
 
 void PointCloudCommon::processMessage(const sensor_msgs::PointCloud2ConstPtr& cloud)
 {
+  {
+    boost::mutex::scoped_lock lock(lod_mutex_);
+    ros::WallTime now = ros::WallTime::now();
+    if (!lod_last_arrival_.isZero())
+    {
+      double interval = (now - lod_last_arrival_).toSec();
+      lod_arrival_interval_ = lod_arrival_interval_ > 0.0 ? 0.9 * lod_arrival_interval_ + 0.1 * interval : interval;
+    }
+    lod_last_arrival_ = now;
+  }
+
   CloudInfoPtr info(new CloudInfo);
   info->message_ = cloud;
   info->time_ = 0;
@@ -796,7 +1185,8 @@ void PointCloudCommon::retransform()
 {
   boost::recursive_mutex::scoped_lock lock(transformers_mutex_);
 
-  cloud_->clear();
+  total_point_count_ = 0;
+  cloud_offsets_dirty_ = true;
 
   D_CloudInfo::iterator it = clouds_.begin();
   D_CloudInfo::iterator end = clouds_.end();
@@ -804,44 +1194,375 @@ void PointCloudCommon::retransform()
   {
     const CloudInfoPtr& cloud = *it;
     V_Point points;
-    transformCloud(cloud, points, false);
-    if (!points.empty())
+    if (transformCloud(cloud, points, false))
+    {
+      addCloudPoints(cloud, points);
+    }
+    else if (cloud->cloud_)
     {
-      cloud_->addPoints(&points.front(), points.size());
+      cloud->cloud_->clear();
     }
+    total_point_count_ += cloud->num_points_;
   }
 }
 
-bool PointCloudCommon::transformCloud(const CloudInfoPtr& info, V_Point& points, bool update_transformers)
+void PointCloudCommon::redecimateSome()
 {
-  Ogre::Matrix4 transform = info->transform_;
+  if (decimation_property_->getOptionInt() != DecimationVoxelGrid)
+  {
+    return;
+  }
+
+  Ogre::Vector3 camera_position;
+  float meters_per_meter;
+  {
+    boost::mutex::scoped_lock lock(lod_mutex_);
+    camera_position = lod_camera_position_;
+    meters_per_meter = lod_meters_per_meter_;
+  }
+  float min_voxel_size = voxel_size_property_->getFloat();
 
-  if (transform == Ogre::Matrix4::ZERO)
+  ros::WallTime start = ros::WallTime::now();
+  bool changed = false;
+  for (size_t i = 0; i < clouds_.size(); ++i)
   {
-    Ogre::Vector3 pos;
-    Ogre::Quaternion orient;
-    if (!context_->getFrameManager()->getTransform(info->message_->header, pos, orient))
+    const CloudInfoPtr& cloud = clouds_[i];
+    if (!cloud->cloud_ || cloud->lod_voxel_size_ <= 0.0f)
     {
-      std::stringstream ss;
-      ss << "Failed to transform from frame [" << info->message_->header.frame_id << "] to frame [" << context_->getFrameManager()->getFixedFrame() << "]";
-      display_->setStatusStd(StatusProperty::Error, "Message", ss.str());
-      return false;
+      continue;
+    }
+
+    // Only big changes count, so a moving camera doesn't decimate clouds again every frame
+    float voxel_size = std::max(min_voxel_size, camera_position.distance(cloud->transform_.getTrans()) * meters_per_meter);
+    if (voxel_size < 2.0f * cloud->lod_voxel_size_ && voxel_size > 0.5f * cloud->lod_voxel_size_)
+    {
+      continue;
+    }
+
+    total_point_count_ -= cloud->num_points_;
+    if (recolor_job_ && recolor_job_->cloud_.lock() == cloud)
+    {
+      // Its colors would no longer match the points
+      recolor_job_.reset();
+    }
+    V_Point points;
+    if (transformCloud(cloud, points, false))
+    {
+      addCloudPoints(cloud, points);
+    }
+    else
+    {
+      cloud->cloud_->clear();
+      // Don't try again every frame
+      cloud->lod_voxel_size_ = 0.0f;
+    }
+    total_point_count_ += cloud->num_points_;
+    changed = true;
+
+    if ((ros::WallTime::now() - start).toSec() > REDECIMATE_TIME_BUDGET)
+    {
+      break;
+    }
+  }
+
+  if (changed)
+  {
+    cloud_offsets_dirty_ = true;
+    coll_handler_->markPickBoundsDirty();
+    context_->queueRender();
+  }
+}
+
+void PointCloudCommon::recolorSome()
+{
+  ros::WallTime start = ros::WallTime::now();
+  long version = color_version_;
+
+  // Go round the clouds until all have current colors or the time is up
+  size_t current_count = 0;
+  while (current_count < clouds_.size())
+  {
+    if (recolor_cloud_index_ >= clouds_.size())
+    {
+      recolor_cloud_index_ = 0;
+      recolor_point_offset_ = 0;
+    }
+
+    const CloudInfoPtr& cloud = clouds_[recolor_cloud_index_];
+    // Direct clouds take their colors straight from the message
+    if (cloud->color_version_ == version || cloud->direct_ || cloud->num_points_ == 0 || !cloud->cloud_)
+    {
+      ++current_count;
+      ++recolor_cloud_index_;
+      recolor_point_offset_ = 0;
+      continue;
+    }
+    current_count = 0;
+
+    if (!recolor_job_ || recolor_job_->cloud_.lock() != cloud || recolor_job_->version_ != version)
+    {
+      recolor_job_.reset(new RecolorJob(this, cloud, version));
+      recolor_point_offset_ = 0;
+      if (recolor_queue_)
+      {
+        recolor_queue_->addCallback(recolor_job_);
+      }
+      else
+      {
+        recolor_job_->call();
+      }
+    }
+
+    if (!recolor_job_->isReady())
+    {
+      // Come back next frame
+      break;
+    }
+
+    const std::vector<uint32_t>& colors = recolor_job_->colors_;
+    if (colors.size() == cloud->num_points_ && recolor_point_offset_ < cloud->num_points_)
+    {
+      uint32_t count = std::min(RECOLOR_SLICE_POINTS, cloud->num_points_ - recolor_point_offset_);
+      cloud->cloud_->setColors(recolor_point_offset_, &colors[recolor_point_offset_], count);
+      recolor_point_offset_ += count;
+      context_->queueRender();
+    }
+    else
+    {
+      // The transformer failed, leave the old colors rather than trying again every frame
+      recolor_point_offset_ = cloud->num_points_;
+    }
+
+    if (recolor_point_offset_ >= cloud->num_points_)
+    {
+      cloud->color_version_ = version;
+      recolor_job_.reset();
+      ++recolor_cloud_index_;
+      recolor_point_offset_ = 0;
+    }
+
+    if ((ros::WallTime::now() - start).toSec() > RECOLOR_TIME_BUDGET)
+    {
+      break;
+    }
+  }
+
+  if (current_count >= clouds_.size())
+  {
+    recoloring_ = false;
+  }
+}
+
+PointCloudCommon::RecolorJob::RecolorJob(PointCloudCommon* parent, const CloudInfoPtr& cloud, long version)
+: cloud_(cloud)
+, version_(version)
+, parent_(parent)
+, message_(cloud->message_)
+, transform_(cloud->transform_)
+, indices_(cloud->indices_)
+, ready_(0)
+{}
+
+ros::CallbackInterface::CallResult PointCloudCommon::RecolorJob::call()
+{
+  // Don't bother if the settings changed again while this was waiting
+  if (version_ == parent_->color_version_)
+  {
+    size_t size = message_->width * message_->height;
+    V_PointCloudPoint cloud_points;
+    bool ok = false;
+    {
+      boost::recursive_mutex::scoped_lock lock(parent_->transformers_mutex_);
+      PointCloudTransformerPtr color_trans = parent_->getColorTransformer(message_);
+      if (color_trans)
+      {
+        PointCloudPoint default_pt;
+        default_pt.color = Ogre::ColourValue(1, 1, 1);
+        default_pt.position = Ogre::Vector3::ZERO;
+        cloud_points.resize(size, default_pt);
+        ok = color_trans->transform(message_, PointCloudTransformer::Support_Color, transform_, cloud_points);
+      }
+    }
+
+    if (ok)
+    {
+      size_t count = indices_.empty() ? size : indices_.size();
+      colors_.resize(count);
+      for (size_t i = 0; i < count; ++i)
+      {
+        const Ogre::ColourValue& color = cloud_points[indices_.empty() ? i : indices_[i]].color;
+        colors_[i] = PointCloud::packColor(color.r, color.g, color.b);
+      }
+    }
+  }
+
+  ++ready_;
+  return Success;
+}
+
+void PointCloudCommon::decimateCloud(const CloudInfoPtr& info, V_Point& points)
+{
+  Ogre::Vector3 camera_position;
+  float meters_per_meter;
+  uint32_t num_clouds = 1;
+  {
+    boost::mutex::scoped_lock lock(lod_mutex_);
+    camera_position = lod_camera_position_;
+    meters_per_meter = lod_meters_per_meter_;
+    float decay_time = decay_time_property_->getFloat();
+    if (decay_time > 0.0f)
+    {
+      // Share the budget with as many clouds as the decay window will hold, not only those in it so far,
+      // so the total stays within the budget while the window fills up.
+      num_clouds = lod_cloud_count_ + 1;
+      if (lod_arrival_interval_ > 0.0)
+      {
+        num_clouds = std::max(num_clouds, (uint32_t) ceil(decay_time / lod_arrival_interval_) + 1);
+      }
+    }
+  }
+
+  // Use voxels no smaller than a pixel at the distance of the cloud's origin
+  float distance = camera_position.distance(info->transform_.getTrans());
+  float voxel_size = std::max(voxel_size_property_->getFloat(), distance * meters_per_meter);
+  info->lod_voxel_size_ = voxel_size;
+  size_t budget = std::max(1, point_budget_property_->getInt() / (int)num_clouds);
+
+  V_Point decimated;
+  std::vector<uint32_t>& indices = info->indices_;
+  boost::unordered_set<uint64_t> voxels;
+  for (int attempt = 0; ; ++attempt)
+  {
+    decimated.clear();
+    indices.clear();
+    voxels.clear();
+
+    float inv_voxel_size = 1.0f / voxel_size;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+      const PointCloud::Point& p = points[i];
+      if (p.x == 999999.0f)
+      {
+        // Invalid point, see packPoints()
+        continue;
+      }
+
+      if (voxels.insert(voxelKey(p, inv_voxel_size)).second)
+      {
+        decimated.push_back(p);
+        indices.push_back(i);
+      }
     }
 
-    transform = Ogre::Matrix4(orient);
-    transform.setTrans(pos);
-    info->transform_ = transform;
+    if (decimated.size() <= budget || attempt >= 8)
+    {
+      break;
+    }
+    voxel_size *= 2.0f;
   }
 
-  V_PointCloudPoint& cloud_points = info->transformed_points_;
-  cloud_points.clear();
+  points.swap(decimated);
+  info->num_points_ = points.size();
+}
+
+void PointCloudCommon::addCloudPoints(const CloudInfoPtr& info, V_Point& points)
+{
+  if (!info->cloud_)
+  {
+    PointCloud::RenderMode mode = (PointCloud::RenderMode) style_property_->getOptionInt();
+    float size = (mode == PointCloud::RM_POINTS) ? point_pixel_size_property_->getFloat() : point_world_size_property_->getFloat();
+
+    if (!spare_clouds_.empty())
+    {
+      // Settings may have changed since it was put aside, so they are all set again below
+      info->cloud_ = spare_clouds_.back();
+      spare_clouds_.pop_back();
+    }
+    else
+    {
+      info->cloud_.reset(new PointCloud());
+    }
+    info->cloud_->setRenderMode(mode);
+    info->cloud_->setDimensions(size, size, size);
+    info->cloud_->setAlpha(alpha_property_->getFloat());
+    info->cloud_->setPickColor(pick_color_);
+
+    info->manager_ = context_->getSceneManager();
+    info->scene_node_ = scene_node_->createChildSceneNode();
+    info->scene_node_->attachObject(info->cloud_.get());
+  }
+  else
+  {
+    info->cloud_->clear();
+  }
+  info->scene_node_->setPosition(info->position_);
+  info->scene_node_->setOrientation(info->orientation_);
+
+  // Points stay in the sensor frame, the scene node applies transform_ on the GPU
+  if (info->direct_)
+  {
+    const sensor_msgs::PointCloud2ConstPtr& msg = info->message_;
+    info->cloud_->addPoints(&msg->data.front(), msg->point_step, info->xyz_offset_, info->rgb_offset_, info->num_points_, Ogre::Matrix4::IDENTITY);
+  }
+  else if (!points.empty())
+  {
+    info->cloud_->addPoints(&points.front(), points.size());
+  }
+}
+
+void PointCloudCommon::recycleCloud(const CloudInfoPtr& info)
+{
+  // Always kept, even past MAX_SPARE_CLOUDS: destroying a PointCloud frees its vertex buffers and
+  // materials, and a burst of expiries (e.g. after shortening the decay time) shouldn't do that all at once.
+  if (info->cloud_)
+  {
+    info->cloud_->clear();
+    spare_clouds_.push_back(info->cloud_);
+  }
+  info->clear();
+}
+
+bool PointCloudCommon::updateCloudPose(const CloudInfoPtr& info)
+{
+  Ogre::Vector3 pos;
+  Ogre::Quaternion orient;
+  if (!context_->getFrameManager()->getTransform(info->message_->header, pos, orient))
+  {
+    return false;
+  }
+
+  info->position_ = pos;
+  info->orientation_ = orient;
+  info->transform_ = Ogre::Matrix4(orient);
+  info->transform_.setTrans(pos);
+
+  if (info->scene_node_)
+  {
+    info->scene_node_->setPosition(pos);
+    info->scene_node_->setOrientation(orient);
+  }
+  return true;
+}
+
+bool PointCloudCommon::transformCloud(const CloudInfoPtr& info, V_Point& points, bool update_transformers)
+{
+  if (info->transform_ == Ogre::Matrix4::ZERO && !updateCloudPose(info))
+  {
+    std::stringstream ss;
+    ss << "Failed to transform from frame [" << info->message_->header.frame_id << "] to frame [" << context_->getFrameManager()->getFixedFrame() << "]";
+    display_->setStatusStd(StatusProperty::Error, "Message", ss.str());
+    return false;
+  }
+  const Ogre::Matrix4& transform = info->transform_;
+
+  // Only lives for the duration of this call: selection recomputes positions from the message
+  V_PointCloudPoint cloud_points;
+  info->positions_.clear();
+  info->indices_.clear();
 
   size_t size = info->message_->width * info->message_->height;
   info->num_points_ = size;
-  PointCloudPoint default_pt;
-  default_pt.color = Ogre::ColourValue(1, 1, 1);
-  default_pt.position = Ogre::Vector3::ZERO;
-  cloud_points.resize(size, default_pt);
+  info->color_version_ = color_version_;
 
   {
     boost::recursive_mutex::scoped_lock lock(transformers_mutex_);
@@ -868,28 +1589,58 @@ bool PointCloudCommon::transformCloud(const CloudInfoPtr& info, V_Point& points,
       return false;
     }
 
-    xyz_trans->transform(info->message_, PointCloudTransformer::Support_XYZ, transform, cloud_points);
+    // Plain float32 x/y/z plus rgb, colored as-is, can skip the intermediate point arrays and
+    // be streamed from the message straight into the vertex buffers.
+    XYZLayout layout;
+    int32_t rgb_index = findChannelIndex(info->message_, "rgb");
+    info->direct_ = dynamic_cast<XYZPCTransformer*>(xyz_trans.get())
+                    && dynamic_cast<RGB8PCTransformer*>(color_trans.get())
+                    && rgb_index != -1
+                    && layout.init(info->message_)
+                    && layout.packed
+                    && decimation_property_->getOptionInt() == DecimationNone;
+    if (info->direct_)
+    {
+      info->xyz_offset_ = layout.xoff;
+      info->rgb_offset_ = info->message_->fields[rgb_index].offset;
+      points.clear();
+      return true;
+    }
+
+    PointCloudPoint default_pt;
+    default_pt.color = Ogre::ColourValue(1, 1, 1);
+    default_pt.position = Ogre::Vector3::ZERO;
+    cloud_points.resize(size, default_pt);
+
+    // Positions stay in the sensor frame, colors may depend on the fixed-frame position
+    xyz_trans->transform(info->message_, PointCloudTransformer::Support_XYZ, Ogre::Matrix4::IDENTITY, cloud_points);
     color_trans->transform(info->message_, PointCloudTransformer::Support_Color, transform, cloud_points);
   }
 
   points.resize(size);
-  for (size_t i = 0; i < size; ++i)
+  boost::function<void (size_t, size_t)> pack = boost::bind(&packPoints, &cloud_points, &points.front(), _1, _2);
+  if (WorkerPool* pool = context_->getWorkerPool())
   {
-    Ogre::Vector3 pos = cloud_points[i].position;
-    Ogre::ColourValue color = cloud_points[i].color;
-    if (validateFloats(pos))
-    {
-      points[i].x = pos.x;
-      points[i].y = pos.y;
-      points[i].z = pos.z;
-    }
-    else
+    pool->parallelFor(size, MIN_POINTS_PER_BLOCK, pack);
+  }
+  else
+  {
+    pack(0, size);
+  }
+
+  if (cache_positions_property_->getBool())
+  {
+    std::vector<Ogre::Vector3>& positions = info->positions_;
+    positions.resize(size);
+    for (size_t i = 0; i < size; ++i)
     {
-      points[i].x = 999999.0f;
-      points[i].y = 999999.0f;
-      points[i].z = 999999.0f;
+      positions[i] = cloud_points[i].position;
     }
-    points[i].setColor(color.r, color.g, color.b);
+  }
+
+  if (decimation_property_->getOptionInt() == DecimationVoxelGrid)
+  {
+    decimateCloud(info, points);
   }
 
   return true;
@@ -953,9 +1704,54 @@ void PointCloudCommon::addMessage(const sensor_msgs::PointCloud2ConstPtr& cloud)
   processMessage(cloud);
 }
 
+const std::vector<uint32_t>& PointCloudCommon::getCloudOffsets()
+{
+  if (cloud_offsets_dirty_)
+  {
+    cloud_offsets_.resize(clouds_.size());
+    uint32_t offset = 0;
+    for (size_t i = 0; i < clouds_.size(); ++i)
+    {
+      cloud_offsets_[i] = offset;
+      offset += clouds_[i]->num_points_;
+    }
+    cloud_offsets_dirty_ = false;
+  }
+  return cloud_offsets_;
+}
+
 void PointCloudCommon::fixedFrameChanged()
 {
-  reset();
+  {
+    boost::mutex::scoped_lock lock(new_clouds_mutex_);
+    for (size_t i = 0; i < new_clouds_.size(); ++i)
+    {
+      updateCloudPose(new_clouds_[i]);
+    }
+  }
+
+  boost::mutex::scoped_lock lock(clouds_mutex_);
+  D_CloudInfo::iterator it = clouds_.begin();
+  while (it != clouds_.end())
+  {
+    if (updateCloudPose(*it))
+    {
+      ++it;
+    }
+    else
+    {
+      total_point_count_ -= (*it)->num_points_;
+      it = clouds_.erase(it);
+      cloud_offsets_dirty_ = true;
+    }
+  }
+
+  coll_handler_->markPickBoundsDirty();
+
+  // Color transformers can color by fixed-frame position
+  ++color_version_;
+  needs_recolor_ = true;
+  context_->queueRender();
 }
 
 void PointCloudCommon::setXyzTransformerOptions( EnumProperty* prop )
@@ -37,14 +37,17 @@
 #include <QObject>
 #include <QList>
 
+#include <boost/detail/atomic_count.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
-#include <ros/spinner.h>
-#include <ros/callback_queue.h>
+#include <OGRE/OgreQuaternion.h>
+
 
 #include <message_filters/time_sequencer.h>
+#include <ros/callback_queue_interface.h>
 
 #include <pluginlib/class_loader.h>
 
@@ -64,11 +67,13 @@ class Display;
 class DisplayContext;
 class EnumProperty;
 class FloatProperty;
+class IntProperty;
 struct IndexAndMessage;
 class PointCloudSelectionHandler;
 typedef boost::shared_ptr<PointCloudSelectionHandler> PointCloudSelectionHandlerPtr;
 class PointCloudTransformer;
 typedef boost::shared_ptr<PointCloudTransformer> PointCloudTransformerPtr;
+class WorkerQueue;
 
 typedef std::vector<std::string> V_string;
 
@@ -89,13 +94,45 @@ public:
     CloudInfo();
     ~CloudInfo();
 
+    /** @brief Destroy this cloud's scene node and PointCloud. */
+    void clear();
+
     float time_;
 
+    /// Sensor frame to fixed frame.  Points are stored in the sensor frame and scene_node_ carries this pose,
+    /// so changing it doesn't touch the vertex buffers.
     Ogre::Matrix4 transform_;
+    Ogre::Vector3 position_;
+    Ogre::Quaternion orientation_;
+
+    Ogre::SceneManager* manager_;
+    Ogre::SceneNode* scene_node_;
+    boost::shared_ptr<PointCloud> cloud_;
+
     sensor_msgs::PointCloud2ConstPtr message_;
     uint32_t num_points_;
 
-    V_PointCloudPoint transformed_points_;
+    /// True if the points are streamed straight from message_ into the PointCloud (see PointCloud::addPoints()).
+    bool direct_;
+    uint32_t xyz_offset_;
+    uint32_t rgb_offset_;
+
+    /// Index in message_ of each rendered point.  Only filled if the cloud was decimated.
+    std::vector<uint32_t> indices_;
+
+    /// Voxel size for the camera distance when the cloud was decimated, before it was coarsened
+    /// to fit the point budget.  0 if the cloud wasn't decimated.
+    float lod_voxel_size_;
+
+    /// Value of PointCloudCommon::color_version_ the colors were computed for
+    long color_version_;
+
+    /// Sensor-frame positions from the position transformer, only kept if "Cache Positions" is on.
+    /// Otherwise positions are recomputed from message_ when needed.
+    std::vector<Ogre::Vector3> positions_;
+
+    /** @brief Returns the fixed-frame position of a point of this cloud. */
+    Ogre::Vector3 getPosition( uint32_t index ) const;
   };
   typedef boost::shared_ptr<CloudInfo> CloudInfoPtr;
   typedef std::deque<CloudInfoPtr> D_CloudInfo;
@@ -116,20 +153,33 @@ public:
     StyleCount,
   };
 
+  /**
+   * \enum Decimation
+   * \brief How incoming clouds are thinned out before they are rendered
+   */
+  enum Decimation
+  {
+    DecimationNone,     ///< Render every point
+    DecimationVoxelGrid ///< Render one point per voxel.  Voxels grow with camera distance and to keep within the point budget.
+  };
+
   PointCloudCommon( Display* display );
   ~PointCloudCommon();
 
   void initialize( DisplayContext* context, Ogre::SceneNode* scene_node );
 
+  /** @brief Look up the pose of every cloud in the new fixed frame.  Clouds whose pose can't be found are dropped. */
   void fixedFrameChanged();
   void reset();
   void update(float wall_dt, float ros_dt);
 
+  /** @brief Read the settings of older config files which were renamed or moved since.  Call after the display loaded
+   * its properties. */
+  void loadOldSettings( const YAML::Node& yaml_node );
+
   void addMessage(const sensor_msgs::PointCloudConstPtr& cloud);
   void addMessage(const sensor_msgs::PointCloud2ConstPtr& cloud);
 
-  ros::CallbackQueueInterface* getCallbackQueue() { return &cbqueue_; }
-
   Display* getDisplay() { return display_; }
 
   BoolProperty* selectable_property_;
@@ -139,7 +189,11 @@ public:
   EnumProperty* xyz_transformer_property_;
   EnumProperty* color_transformer_property_;
   EnumProperty* style_property_;
+  EnumProperty* decimation_property_;
+  FloatProperty* voxel_size_property_;
+  IntProperty* point_budget_property_;
   FloatProperty* decay_time_property_;
+  BoolProperty* cache_positions_property_;
 
 public Q_SLOTS:
   void causeRetransform();
@@ -147,6 +201,7 @@ public Q_SLOTS:
 private Q_SLOTS:
   void updateSelectable();
   void updateStyle();
+  void updateDecimation();
   void updateBillboardSize();
   void updateAlpha();
   void updateXyzTransformer();
@@ -154,6 +209,10 @@ private Q_SLOTS:
   void setXyzTransformerOptions( EnumProperty* prop );
   void setColorTransformerOptions( EnumProperty* prop );
 
+  /** @brief Called when a transformer's properties change.  Changes to only the color transformer recolor the
+   * clouds in place instead of retransforming them. */
+  void onTransformerChanged();
+
 private:
   typedef std::vector<PointCloud::Point> V_Point;
   typedef std::vector<V_Point> VV_Point;
@@ -163,6 +222,67 @@ private:
    */
   bool transformCloud(const CloudInfoPtr& cloud, V_Point& points, bool fully_update_transformers);
 
+  /**
+   * \brief Fill the cloud's PointCloud with the points from transformCloud(), creating it and its scene node if needed
+   */
+  void addCloudPoints(const CloudInfoPtr& cloud, V_Point& points);
+
+  /**
+   * \brief Destroy the scene node of a cloud which goes away, keeping its PointCloud for reuse by addCloudPoints()
+   *
+   * This is what makes expiring a cloud cost O(renderables) rather than O(points), without freeing anything.
+   */
+  void recycleCloud(const CloudInfoPtr& cloud);
+
+  /**
+   * \brief Look up the fixed-frame pose of a cloud and move its scene node there
+   */
+  bool updateCloudPose(const CloudInfoPtr& cloud);
+
+  /**
+   * \brief Replace points with one representative point per voxel, filling in the cloud's indices_
+   */
+  void decimateCloud(const CloudInfoPtr& cloud, V_Point& points);
+
+  /**
+   * \brief Decimate clouds again whose voxel size for the current camera distance changed by more than a
+   * factor of two, as many as fit in this frame's time budget.  Call with clouds_mutex_ locked.
+   */
+  void redecimateSome();
+
+  /**
+   * \brief Write new colors over the points of clouds with outdated colors, as many as fit in this
+   * frame's time budget.  Picks up where the last call stopped, even within a cloud.
+   */
+  void recolorSome();
+
+  /**
+   * \brief Runs the color transformer over one cloud for recolorSome(), on the worker pool if there is one
+   */
+  class RecolorJob: public ros::CallbackInterface
+  {
+  public:
+    RecolorJob(PointCloudCommon* parent, const CloudInfoPtr& cloud, long version);
+
+    virtual CallResult call();
+
+    /** @brief Return true once call() has finished. */
+    bool isReady() const { return ready_ != 0; }
+
+    /// Weak, so the last reference to a cloud is never dropped on a worker thread
+    boost::weak_ptr<CloudInfo> cloud_;
+    long version_;
+    std::vector<uint32_t> colors_;    ///< Packed color of each rendered point, empty if the transformer failed
+
+  private:
+    PointCloudCommon* parent_;
+    sensor_msgs::PointCloud2ConstPtr message_;
+    Ogre::Matrix4 transform_;
+    std::vector<uint32_t> indices_;
+    boost::detail::atomic_count ready_;
+  };
+  typedef boost::shared_ptr<RecolorJob> RecolorJobPtr;
+
   void processMessage(const sensor_msgs::PointCloud2ConstPtr& cloud);
   void updateStatus();
 
@@ -178,15 +298,23 @@ private:
   void setPropertiesHidden( const QList<Property*>& props, bool hide );
   void fillTransformerOptions( EnumProperty* prop, uint32_t mask );
 
-  ros::AsyncSpinner spinner_;
-  ros::CallbackQueue cbqueue_;
-
   D_CloudInfo clouds_;
   boost::mutex clouds_mutex_;
+
+  /** @brief Return the global pick index of the first point of each entry of clouds_.
+   *
+   * Rebuilt on demand after clouds_ changes.  Call with clouds_mutex_ locked. */
+  const std::vector<uint32_t>& getCloudOffsets();
+  std::vector<uint32_t> cloud_offsets_;
+  bool cloud_offsets_dirty_;
   bool new_cloud_;
 
-  PointCloud* cloud_;
   Ogre::SceneNode* scene_node_;
+  Ogre::ColourValue pick_color_;
+
+  /// Emptied PointClouds of expired clouds.  Each PointCloud clones its own materials, so with a decay time
+  /// reusing them saves loading a new set for every message.
+  std::vector<boost::shared_ptr<PointCloud> > spare_clouds_;
 
   VV_Point new_points_;
   V_CloudInfo new_clouds_;
@@ -208,12 +336,31 @@ private:
   bool new_xyz_transformer_;
   bool new_color_transformer_;
   bool needs_retransform_;
+  bool needs_recolor_;
+
+  /// Bumped whenever the colors of all clouds go out of date.  Read by the worker threads.
+  boost::detail::atomic_count color_version_;
+
+  // Progress of an incremental recolor, see recolorSome()
+  bool recoloring_;
+  uint32_t recolor_cloud_index_;
+  uint32_t recolor_point_offset_;           ///< Points of clouds_[recolor_cloud_index_] already recolored
+  RecolorJobPtr recolor_job_;
+  boost::shared_ptr<WorkerQueue> recolor_queue_;   ///< Runs the RecolorJobs, NULL without a WorkerPool
 
   CollObjectHandle coll_handle_;
   PointCloudSelectionHandlerPtr coll_handler_;
 
   uint32_t total_point_count_;
 
+  // Snapshot of the view taken in update(), for decimating clouds on the worker threads
+  boost::mutex lod_mutex_;
+  Ogre::Vector3 lod_camera_position_;
+  float lod_meters_per_meter_;              ///< Size of one pixel at one meter from the camera
+  uint32_t lod_cloud_count_;
+  ros::WallTime lod_last_arrival_;          ///< When the last message arrived
+  double lod_arrival_interval_;             ///< Smoothed time between messages, 0 until two arrived
+
   pluginlib::ClassLoader<PointCloudTransformer>* transformer_class_loader_;
 
   Display* display_;
@@ -231,15 +378,7 @@ public:
   virtual void createProperties( const Picked& obj, Property* parent_property );
   virtual void destroyProperties( const Picked& obj, Property* parent_property );
 
-  virtual bool needsAdditionalRenderPass(uint32_t pass)
-  {
-    if (pass < 2)
-    {
-      return true;
-    }
-
-    return false;
-  }
+  virtual bool needsAdditionalRenderPass(uint32_t pass);
 
   virtual void preRenderPass(uint32_t pass);
   virtual void postRenderPass(uint32_t pass);
@@ -249,7 +388,28 @@ public:
 
   virtual void getAABBs(const Picked& obj, V_AABB& aabbs);
 
-  void getCloudAndLocalIndexByGlobalIndex(int global_index, PointCloudCommon::CloudInfoPtr& cloud_out, int& index_out);
+  virtual Ogre::AxisAlignedBox getPickBounds();
+  virtual bool supportsRayPick() { return true; }
+  virtual bool intersectRay( const Ogre::Ray& ray, float pixel_angle, float& distance, uint64_t& extra_handle );
+
+  void getCloudAndLocalIndexByGlobalIndex(uint32_t global_index, PointCloudCommon::CloudInfoPtr& cloud_out, int& index_out);
+
+  /** @brief Return the extra pick handle of a point.
+   *
+   * Each pick pass renders 24 bits, so the low 24 bits of global_index + 1
+   * come from the second pass and the rest from the third, which
+   * SelectionManager puts in the next 32-bit slot of the handle. */
+  static uint64_t indexToExtraHandle(uint32_t global_index)
+  {
+    uint64_t id = (uint64_t)global_index + 1;
+    return (id & 0xffffff) | ((id >> 24) << 32);
+  }
+
+  /** @brief Inverse of indexToExtraHandle(). */
+  static uint32_t extraHandleToIndex(uint64_t extra_handle)
+  {
+    return (uint32_t)(((extra_handle & 0xffffff) | ((extra_handle >> 32) << 24)) - 1);
+  }
 
   PointCloudCommon* getPointCloudCommon() { return display_; }
 private:
@@ -53,19 +53,20 @@ PointCloudDisplay::PointCloudDisplay()
                                           " Increasing this is useful if your incoming TF data is delayed significantly "
                                           "from your PointCloud data, but it can greatly increase memory usage if the messages are big.",
                                           this, SLOT( updateQueueSize() ));
-
-  // PointCloudCommon sets up a callback queue with a thread for each
-  // instance.  Use that for processing incoming messages.
-  update_nh_.setCallbackQueue( point_cloud_common_->getCallbackQueue() );
 }
 
 PointCloudDisplay::~PointCloudDisplay()
 {
+  // The subscriber and tf filter are only torn down by MessageFilterDisplay
+  stopThreadedQueue();
   delete point_cloud_common_;
 }
 
 void PointCloudDisplay::onInitialize()
 {
+  // Process incoming messages on the worker pool instead of the GUI
+  // thread.  This has to be set before the tf filter is created.
+  update_nh_.setCallbackQueue( threaded_nh_.getCallbackQueue() );
   MFDClass::onInitialize();
   point_cloud_common_->initialize( context_, scene_node_ );
 }
@@ -91,6 +92,12 @@ void PointCloudDisplay::reset()
   point_cloud_common_->reset();
 }
 
+void PointCloudDisplay::load( const YAML::Node& yaml_node )
+{
+  MFDClass::load( yaml_node );
+  point_cloud_common_->loadOldSettings( yaml_node );
+}
+
 } // namespace rviz
 
 #include <pluginlib/class_list_macros.h>
@@ -61,6 +61,9 @@ public:
 
   virtual void reset();
 
+  /** @brief Load the settings, including those of older config files.  Overridden from Display. */
+  virtual void load( const YAML::Node& yaml_node );
+
   virtual void update( float wall_dt, float ros_dt );
 
 private Q_SLOTS:
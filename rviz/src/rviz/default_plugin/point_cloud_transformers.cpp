@@ -61,6 +61,30 @@ static void getRainbowColor(float value, Ogre::ColourValue& color)
   else if (i >= 5) color[0] = 1, color[1] = n, color[2] = 0;
 }
 
+/// Number of entries in the intensity colormap lookup table
+static const uint32_t COLORMAP_SIZE = 1024;
+
+static void getViridisColor(float value, Ogre::ColourValue& color)
+{
+  // Evenly spaced samples of matplotlib's viridis, interpolated linearly
+  static const float samples[][3] = {
+    {  68,   1,  84 }, {  71,  45, 123 }, {  59,  82, 139 },
+    {  44, 114, 142 }, {  33, 145, 140 }, {  40, 174, 128 },
+    {  94, 201,  98 }, { 173, 220,  48 }, { 253, 231,  37 } };
+  static const int num_samples = sizeof(samples) / sizeof(samples[0]);
+
+  value = std::min(value, 1.0f);
+  value = std::max(value, 0.0f);
+
+  float h = value * (num_samples - 1);
+  int i = std::min((int)h, num_samples - 2);
+  float f = h - i;
+  for (int c = 0; c < 3; ++c)
+  {
+    color[c] = (samples[i][c] * (1.0f - f) + samples[i + 1][c] * f) / 255.0f;
+  }
+}
+
 uint8_t IntensityPCTransformer::supports(const sensor_msgs::PointCloud2ConstPtr& cloud)
 {
   updateChannels(cloud);
@@ -102,18 +126,43 @@ bool IntensityPCTransformer::transform( const sensor_msgs::PointCloud2ConstPtr&
 
   const uint32_t offset = cloud->fields[index].offset;
   const uint8_t type = cloud->fields[index].datatype;
-  const uint32_t point_step = cloud->point_step;
   const uint32_t num_points = cloud->width * cloud->height;
 
+  // Pull the channel out once, so the loops below don't switch on the datatype for every point
+  std::vector<float> values( num_points );
+  if( !copyFieldFromCloud( cloud, offset, type, &values.front() ))
+  {
+    return false;
+  }
+
   float min_intensity = 999999.0f;
   float max_intensity = -999999.0f;
   if( auto_compute_intensity_bounds_property_->getBool() )
   {
-    for( uint32_t i = 0; i < num_points; ++i )
+    // Independent accumulators so the compiler can keep several lanes going at once.  NaNs never compare
+    // less or greater, so they are skipped.
+    float mins[4] = { min_intensity, min_intensity, min_intensity, min_intensity };
+    float maxs[4] = { max_intensity, max_intensity, max_intensity, max_intensity };
+    uint32_t i = 0;
+    for( ; i + 4 <= num_points; i += 4 )
+    {
+      for( uint32_t j = 0; j < 4; ++j )
+      {
+        float val = values[i + j];
+        mins[j] = val < mins[j] ? val : mins[j];
+        maxs[j] = val > maxs[j] ? val : maxs[j];
+      }
+    }
+    for( ; i < num_points; ++i )
+    {
+      float val = values[i];
+      mins[0] = val < mins[0] ? val : mins[0];
+      maxs[0] = val > maxs[0] ? val : maxs[0];
+    }
+    for( uint32_t j = 0; j < 4; ++j )
     {
-      float val = valueFromCloud<float>(cloud, offset, type, point_step, i);
-      min_intensity = std::min(val, min_intensity);
-      max_intensity = std::max(val, max_intensity);
+      min_intensity = std::min(mins[j], min_intensity);
+      max_intensity = std::max(maxs[j], max_intensity);
     }
 
     min_intensity = std::max(-999999.0f, min_intensity);
@@ -135,32 +184,52 @@ bool IntensityPCTransformer::transform( const sensor_msgs::PointCloud2ConstPtr&
     // max are equal.
     diff_intensity = 1e20;
   }
-  Ogre::ColourValue max_color = max_color_property_->getOgreColor();
-  Ogre::ColourValue min_color = min_color_property_->getOgreColor();
 
-  if( use_rainbow_property_->getBool() )
+  // Map each value straight to a table entry: one multiply-add and a copy per point
+  updateLookupTable();
+  const Ogre::ColourValue* lut = &lut_.front();
+  const float max_index = COLORMAP_SIZE - 1;
+  const float scale = max_index / diff_intensity;
+  const float bias = -min_intensity * scale;
+  for (uint32_t i = 0; i < num_points; ++i)
   {
-    for (uint32_t i = 0; i < num_points; ++i)
-    {
-      float val = valueFromCloud<float>(cloud, offset, type, point_step, i);
-      float value = 1.0 - (val - min_intensity)/diff_intensity;
-      getRainbowColor(value, points_out[i].color);
-    }
+    float index = values[i] * scale + bias;
+    index = index > 0.0f ? index : 0.0f; // also catches NaN
+    index = index < max_index ? index : max_index;
+    points_out[i].color = lut[(uint32_t)(index + 0.5f)];
   }
-  else
+
+  return true;
+}
+
+void IntensityPCTransformer::updateLookupTable()
+{
+  lut_.resize( COLORMAP_SIZE );
+
+  Colormap colormap = (Colormap) colormap_property_->getOptionInt();
+  Ogre::ColourValue max_color = max_color_property_->getOgreColor();
+  Ogre::ColourValue min_color = min_color_property_->getOgreColor();
+  for( uint32_t i = 0; i < COLORMAP_SIZE; ++i )
   {
-    for (uint32_t i = 0; i < num_points; ++i)
+    float value = i / (float)(COLORMAP_SIZE - 1);
+    Ogre::ColourValue& color = lut_[i];
+    switch( colormap )
     {
-      float val = valueFromCloud<float>(cloud, offset, type, point_step, i);
-      float normalized_intensity = ( val - min_intensity ) / diff_intensity;
-      normalized_intensity = std::min(1.0f, std::max(0.0f, normalized_intensity));
-      points_out[i].color.r = max_color.r * normalized_intensity + min_color.r * (1.0f - normalized_intensity);
-      points_out[i].color.g = max_color.g * normalized_intensity + min_color.g * (1.0f - normalized_intensity);
-      points_out[i].color.b = max_color.b * normalized_intensity + min_color.b * (1.0f - normalized_intensity);
+    case Rainbow:
+      getRainbowColor( 1.0f - value, color );
+      break;
+    case Viridis:
+      getViridisColor( value, color );
+      break;
+    case Grayscale:
+      color = Ogre::ColourValue( value, value, value );
+      break;
+    case MinMaxColor:
+      color = max_color * value + min_color * (1.0f - value);
+      break;
     }
+    color.a = 1.0f;
   }
-
-  return true;
 }
 
 void IntensityPCTransformer::createProperties( Property* parent_property, uint32_t mask, QList<Property*>& out_props )
@@ -171,19 +240,23 @@ void IntensityPCTransformer::createProperties( Property* parent_property, uint32
                                                        "Select the channel to use to compute the intensity",
                                                        parent_property, SIGNAL( needRetransform() ), this );
 
-    use_rainbow_property_ = new BoolProperty( "Use rainbow", true,
-                                              "Whether to use a rainbow of colors or interpolate between two",
-                                              parent_property, SLOT( updateUseRainbow() ), this );
+    colormap_property_ = new EnumProperty( "Colormap", "Rainbow",
+                                           "How intensities are mapped to colors.  Min/Max Color interpolates between two colors.",
+                                           parent_property, SLOT( updateColormap() ), this );
+    colormap_property_->addOption( "Rainbow", Rainbow );
+    colormap_property_->addOption( "Viridis", Viridis );
+    colormap_property_->addOption( "Grayscale", Grayscale );
+    colormap_property_->addOption( "Min/Max Color", MinMaxColor );
 
     min_color_property_ = new ColorProperty( "Min Color", Qt::black,
                                              "Color to assign the points with the minimum intensity.  "
                                              "Actual color is interpolated between this and Max Color.",
-                                             use_rainbow_property_, SIGNAL( needRetransform() ), this );
+                                             colormap_property_, SIGNAL( needRetransform() ), this );
 
     max_color_property_ = new ColorProperty( "Max Color", Qt::white,
                                              "Color to assign the points with the maximum intensity.  "
                                              "Actual color is interpolated between this and Min Color.",
-                                             use_rainbow_property_, SIGNAL( needRetransform() ), this );
+                                             colormap_property_, SIGNAL( needRetransform() ), this );
 
     auto_compute_intensity_bounds_property_ = new BoolProperty( "Autocompute Intensity Bounds", true,
                                                                 "Whether to automatically compute the intensity min/max values.",
@@ -198,10 +271,10 @@ void IntensityPCTransformer::createProperties( Property* parent_property, uint32
                                                  auto_compute_intensity_bounds_property_ );
 
     out_props.push_back( channel_name_property_ );
-    out_props.push_back( use_rainbow_property_ );
+    out_props.push_back( colormap_property_ );
     out_props.push_back( auto_compute_intensity_bounds_property_ );
 
-    updateUseRainbow();
+    updateColormap();
     updateAutoComputeIntensityBounds();
   }
 }
@@ -250,14 +323,14 @@ void IntensityPCTransformer::updateAutoComputeIntensityBounds()
   Q_EMIT needRetransform();
 }
 
-void IntensityPCTransformer::updateUseRainbow()
+void IntensityPCTransformer::updateColormap()
 {
-  bool use_rainbow = use_rainbow_property_->getBool();
-  min_color_property_->setHidden( use_rainbow );
-  max_color_property_->setHidden( use_rainbow );
-  if( !use_rainbow )
+  bool custom = colormap_property_->getOptionInt() == MinMaxColor;
+  min_color_property_->setHidden( !custom );
+  max_color_property_->setHidden( !custom );
+  if( custom )
   {
-    use_rainbow_property_->expand();
+    colormap_property_->expand();
   }
   Q_EMIT needRetransform();
 }
@@ -281,6 +354,39 @@ uint8_t XYZPCTransformer::supports(const sensor_msgs::PointCloud2ConstPtr& cloud
   return Support_None;
 }
 
+/**
+ * \brief Transform the positions of every point in the cloud.  When Packed is true, y and z are
+ * assumed to directly follow x, which lets the compiler fold the field offsets into one load address.
+ */
+template<bool Packed>
+static void transformXYZ( const sensor_msgs::PointCloud2& cloud, const XYZLayout& layout, const Ogre::Matrix4& transform, V_PointCloudPoint& points_out )
+{
+  const uint32_t xoff = layout.xoff;
+  const uint32_t yoff = Packed ? xoff + sizeof(float) : layout.yoff;
+  const uint32_t zoff = Packed ? xoff + 2 * sizeof(float) : layout.zoff;
+  const uint32_t point_step = cloud.point_step;
+  const uint32_t num_points = cloud.width * cloud.height;
+
+  // The fixed-frame transform is always affine, so apply it directly instead of through
+  // Matrix4 * Vector3, which does a projective divide for every point.
+  const float m00 = transform[0][0], m01 = transform[0][1], m02 = transform[0][2], m03 = transform[0][3];
+  const float m10 = transform[1][0], m11 = transform[1][1], m12 = transform[1][2], m13 = transform[1][3];
+  const float m20 = transform[2][0], m21 = transform[2][1], m22 = transform[2][2], m23 = transform[2][3];
+
+  uint8_t const* point = &cloud.data.front();
+  for (uint32_t i = 0; i < num_points; ++i, point += point_step)
+  {
+    float x = *reinterpret_cast<const float*>(point + xoff);
+    float y = *reinterpret_cast<const float*>(point + yoff);
+    float z = *reinterpret_cast<const float*>(point + zoff);
+
+    Ogre::Vector3& pos = points_out[i].position;
+    pos.x = m00 * x + m01 * y + m02 * z + m03;
+    pos.y = m10 * x + m11 * y + m12 * z + m13;
+    pos.z = m20 * x + m21 * y + m22 * z + m23;
+  }
+}
+
 bool XYZPCTransformer::transform(const sensor_msgs::PointCloud2ConstPtr& cloud, uint32_t mask, const Ogre::Matrix4& transform, V_PointCloudPoint& points_out)
 {
   if (!(mask & Support_XYZ))
@@ -288,25 +394,19 @@ bool XYZPCTransformer::transform(const sensor_msgs::PointCloud2ConstPtr& cloud,
     return false;
   }
 
-  int32_t xi = findChannelIndex(cloud, "x");
-  int32_t yi = findChannelIndex(cloud, "y");
-  int32_t zi = findChannelIndex(cloud, "z");
-
-  const uint32_t xoff = cloud->fields[xi].offset;
-  const uint32_t yoff = cloud->fields[yi].offset;
-  const uint32_t zoff = cloud->fields[zi].offset;
-  const uint32_t point_step = cloud->point_step;
-  const uint32_t num_points = cloud->width * cloud->height;
-  uint8_t const* point = &cloud->data.front();
-  for (uint32_t i = 0; i < num_points; ++i, point += point_step)
+  XYZLayout layout;
+  if (!layout.init(cloud))
   {
-    float x = *reinterpret_cast<const float*>(point + xoff);
-    float y = *reinterpret_cast<const float*>(point + yoff);
-    float z = *reinterpret_cast<const float*>(point + zoff);
+    return false;
+  }
 
-    Ogre::Vector3 pos(x, y, z);
-    pos = transform * pos;
-    points_out[i].position = pos;
+  if (layout.packed)
+  {
+    transformXYZ<true>(*cloud, layout, transform, points_out);
+  }
+  else
+  {
+    transformXYZ<false>(*cloud, layout, transform, points_out);
   }
 
   return true;
@@ -338,13 +438,11 @@ bool RGB8PCTransformer::transform(const sensor_msgs::PointCloud2ConstPtr& cloud,
 
   int32_t index = findChannelIndex(cloud, "rgb");
 
-  const uint32_t off = cloud->fields[index].offset;
-  const uint32_t point_step = cloud->point_step;
+  const FieldReader<uint32_t> rgb_field(*cloud, cloud->fields[index].offset);
   const uint32_t num_points = cloud->width * cloud->height;
-  uint8_t const* point = &cloud->data.front();
-  for (uint32_t i = 0; i < num_points; ++i, point += point_step)
+  for (uint32_t i = 0; i < num_points; ++i)
   {
-    uint32_t rgb = *reinterpret_cast<const uint32_t*>(point + off);
+    uint32_t rgb = rgb_field[i];
     float r = ((rgb >> 16) & 0xff) / 255.0f;
     float g = ((rgb >> 8) & 0xff) / 255.0f;
     float b = (rgb & 0xff) / 255.0f;
@@ -383,17 +481,15 @@ bool RGBF32PCTransformer::transform(const sensor_msgs::PointCloud2ConstPtr& clou
   int32_t gi = findChannelIndex(cloud, "g");
   int32_t bi = findChannelIndex(cloud, "b");
 
-  const uint32_t roff = cloud->fields[ri].offset;
-  const uint32_t goff = cloud->fields[gi].offset;
-  const uint32_t boff = cloud->fields[bi].offset;
-  const uint32_t point_step = cloud->point_step;
+  const FieldReader<float> r_field(*cloud, cloud->fields[ri].offset);
+  const FieldReader<float> g_field(*cloud, cloud->fields[gi].offset);
+  const FieldReader<float> b_field(*cloud, cloud->fields[bi].offset);
   const uint32_t num_points = cloud->width * cloud->height;
-  uint8_t const* point = &cloud->data.front();
-  for (uint32_t i = 0; i < num_points; ++i, point += point_step)
+  for (uint32_t i = 0; i < num_points; ++i)
   {
-    float r = *reinterpret_cast<const float*>(point + roff);
-    float g = *reinterpret_cast<const float*>(point + goff);
-    float b = *reinterpret_cast<const float*>(point + boff);
+    float r = r_field[i];
+    float g = g_field[i];
+    float b = b_field[i];
     points_out[i].color = Ogre::ColourValue(r, g, b);
   }
 
@@ -462,13 +558,15 @@ bool AxisColorPCTransformer::transform( const sensor_msgs::PointCloud2ConstPtr&
     return false;
   }
 
-  int32_t xi = findChannelIndex( cloud, "x" );
-  int32_t yi = findChannelIndex( cloud, "y" );
-  int32_t zi = findChannelIndex( cloud, "z" );
+  XYZLayout layout;
+  if( !layout.init( cloud ))
+  {
+    return false;
+  }
 
-  const uint32_t xoff = cloud->fields[xi].offset;
-  const uint32_t yoff = cloud->fields[yi].offset;
-  const uint32_t zoff = cloud->fields[zi].offset;
+  const uint32_t xoff = layout.xoff;
+  const uint32_t yoff = layout.yoff;
+  const uint32_t zoff = layout.zoff;
   const uint32_t point_step = cloud->point_step;
   const uint32_t num_points = cloud->width * cloud->height;
   uint8_t const* point = &cloud->data.front();
@@ -477,20 +575,20 @@ bool AxisColorPCTransformer::transform( const sensor_msgs::PointCloud2ConstPtr&
   int axis = axis_property_->getOptionInt();
   std::vector<float> values;
   values.reserve( num_points );
-  Ogre::Vector3 pos;
   if( use_fixed_frame_property_->getBool() )
   {
+    // Only the row of the (affine) transform for the chosen axis is needed.
+    const float m0 = transform[ axis ][ 0 ];
+    const float m1 = transform[ axis ][ 1 ];
+    const float m2 = transform[ axis ][ 2 ];
+    const float m3 = transform[ axis ][ 3 ];
     for (uint32_t i = 0; i < num_points; ++i, point += point_step)
     {
-      // TODO: optimize this by only doing the multiplication needed
-      // for the desired output value, instead of doing all of them
-      // and then throwing most away.
-      pos.x = *reinterpret_cast<const float*>(point + xoff);
-      pos.y = *reinterpret_cast<const float*>(point + yoff);
-      pos.z = *reinterpret_cast<const float*>(point + zoff);
-
-      pos = transform * pos;
-      values.push_back( pos[ axis ]);
+      float x = *reinterpret_cast<const float*>(point + xoff);
+      float y = *reinterpret_cast<const float*>(point + yoff);
+      float z = *reinterpret_cast<const float*>(point + zoff);
+
+      values.push_back( m0 * x + m1 * y + m2 * z + m3 );
     }
   }
   else
@@ -110,10 +110,120 @@ inline T valueFromCloud(const sensor_msgs::PointCloud2ConstPtr& cloud, uint32_t
   return ret;
 }
 
+/**
+ * \brief Random-access reader for one field of a PointCloud2, with the field's storage type fixed at
+ * compile time so reads inside a per-point loop do not branch on the datatype.
+ */
+template<typename FieldType>
+class FieldReader
+{
+public:
+  FieldReader(const sensor_msgs::PointCloud2& cloud, uint32_t offset)
+  : data_(&cloud.data.front() + offset)
+  , point_step_(cloud.point_step)
+  {}
+
+  inline FieldType operator[](uint32_t index) const
+  {
+    return *reinterpret_cast<const FieldType*>(data_ + point_step_ * index);
+  }
+
+private:
+  const uint8_t* data_;
+  uint32_t point_step_;
+};
+
+/**
+ * \brief Copy one field of every point in the cloud into out, converting from FieldType to T.
+ */
+template<typename T, typename FieldType>
+inline void copyFieldFromCloud(const sensor_msgs::PointCloud2& cloud, uint32_t offset, T* out)
+{
+  const uint32_t num_points = cloud.width * cloud.height;
+  const uint32_t point_step = cloud.point_step;
+  const uint8_t* point = &cloud.data.front() + offset;
+  for (uint32_t i = 0; i < num_points; ++i, point += point_step)
+  {
+    out[i] = static_cast<T>(*reinterpret_cast<const FieldType*>(point));
+  }
+}
+
+/**
+ * \brief Copy one field of every point in the cloud into out, which must hold width * height values.
+ *
+ * Unlike valueFromCloud(), the datatype is resolved once per cloud instead of once per point.
+ * Integer types are read as unsigned, the same as valueFromCloud().
+ * @return false if the datatype is not supported.
+ */
+template<typename T>
+inline bool copyFieldFromCloud(const sensor_msgs::PointCloud2ConstPtr& cloud, uint32_t offset, uint8_t type, T* out)
+{
+  switch (type)
+  {
+  case sensor_msgs::PointField::INT8:
+  case sensor_msgs::PointField::UINT8:
+    copyFieldFromCloud<T, uint8_t>(*cloud, offset, out);
+    return true;
+  case sensor_msgs::PointField::INT16:
+  case sensor_msgs::PointField::UINT16:
+    copyFieldFromCloud<T, uint16_t>(*cloud, offset, out);
+    return true;
+  case sensor_msgs::PointField::INT32:
+  case sensor_msgs::PointField::UINT32:
+    copyFieldFromCloud<T, uint32_t>(*cloud, offset, out);
+    return true;
+  case sensor_msgs::PointField::FLOAT32:
+    copyFieldFromCloud<T, float>(*cloud, offset, out);
+    return true;
+  case sensor_msgs::PointField::FLOAT64:
+    copyFieldFromCloud<T, double>(*cloud, offset, out);
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * \brief Offsets of the x/y/z fields of a cloud, resolved once per message.
+ */
+struct XYZLayout
+{
+  /** @return false if the cloud does not have float32 x, y and z fields. */
+  bool init(const sensor_msgs::PointCloud2ConstPtr& cloud)
+  {
+    int32_t xi = findChannelIndex(cloud, "x");
+    int32_t yi = findChannelIndex(cloud, "y");
+    int32_t zi = findChannelIndex(cloud, "z");
+    if (xi == -1 || yi == -1 || zi == -1 || cloud->fields[xi].datatype != sensor_msgs::PointField::FLOAT32)
+    {
+      return false;
+    }
+
+    xoff = cloud->fields[xi].offset;
+    yoff = cloud->fields[yi].offset;
+    zoff = cloud->fields[zi].offset;
+    packed = (yoff == xoff + sizeof(float) && zoff == yoff + sizeof(float));
+    return true;
+  }
+
+  uint32_t xoff;
+  uint32_t yoff;
+  uint32_t zoff;
+  bool packed; ///< True for the common x/y/z-adjacent layout, which can be read as a float[3]
+};
+
 class IntensityPCTransformer : public PointCloudTransformer
 {
 Q_OBJECT
 public:
+  enum Colormap
+  {
+    Rainbow,
+    Viridis,
+    Grayscale,
+    MinMaxColor ///< Interpolate between the Min Color and Max Color properties
+  };
+
   virtual uint8_t supports(const sensor_msgs::PointCloud2ConstPtr& cloud);
   virtual bool transform(const sensor_msgs::PointCloud2ConstPtr& cloud,
                          uint32_t mask,
@@ -124,16 +234,20 @@ public:
   void updateChannels(const sensor_msgs::PointCloud2ConstPtr& cloud); 
 
 private Q_SLOTS:
-  void updateUseRainbow();
+  void updateColormap();
   void updateAutoComputeIntensityBounds();
 
 private:
+  /** @brief Fill lut_ with the selected colormap, from the color of the minimum intensity to that of the maximum. */
+  void updateLookupTable();
+
   V_string available_channels_;
+  std::vector<Ogre::ColourValue> lut_;
 
   ColorProperty* min_color_property_;
   ColorProperty* max_color_property_;
   BoolProperty* auto_compute_intensity_bounds_property_;
-  BoolProperty* use_rainbow_property_;
+  EnumProperty* colormap_property_;
   FloatProperty* min_intensity_property_;
   FloatProperty* max_intensity_property_;
   EditableEnumProperty* channel_name_property_;
@@ -345,6 +345,10 @@ void TFDisplay::updateFrames()
   std::sort(frames.begin(), frames.end());
 
   S_FrameInfo current_frames;
+  std::vector<FrameInfo*> infos;
+  std::vector<FrameManager::FrameId> frame_ids;
+  infos.reserve( frames.size() );
+  frame_ids.reserve( frames.size() );
 
   {
     V_string::iterator it = frames.begin();
@@ -363,15 +367,22 @@ void TFDisplay::updateFrames()
       {
         info = createFrame(frame);
       }
-      else
-      {
-        updateFrame(info);
-      }
 
       current_frames.insert( info );
+      infos.push_back( info );
+      frame_ids.push_back( info->frame_id_ );
     }
   }
 
+  // Look up all frames in one walk of the tf tree.  This also leaves
+  // the parents' poses in the FrameManager cache for the arrows.
+  FrameManager::V_FramePose poses;
+  context_->getFrameManager()->getTransforms( frame_ids, ros::Time(), poses );
+  for ( size_t i = 0; i < infos.size(); ++i )
+  {
+    updateFrame( infos[i], poses[i] );
+  }
+
   {
     S_FrameInfo to_delete;
     M_FrameInfo::iterator frame_it = frames_.begin();
@@ -404,6 +415,7 @@ FrameInfo* TFDisplay::createFrame(const std::string& frame)
   frames_.insert( std::make_pair( frame, info ) );
 
   info->name_ = frame;
+  info->frame_id_ = context_->getFrameManager()->internFrame( frame );
   info->last_update_ = ros::Time::now();
   info->axes_ = new Axes( scene_manager_, axes_node_, 0.2, 0.02 );
   info->axes_->getSceneNode()->setVisible( show_axes_property_->getBool() );
@@ -438,8 +450,6 @@ FrameInfo* TFDisplay::createFrame(const std::string& frame)
                                                         info->enabled_property_ );
   info->orientation_property_->setReadOnly( true );
 
-  updateFrame( info );
-
   return info;
 }
 
@@ -448,13 +458,12 @@ Ogre::ColourValue lerpColor(const Ogre::ColourValue& start, const Ogre::ColourVa
   return start * t + end * (1 - t);
 }
 
-void TFDisplay::updateFrame( FrameInfo* frame )
+void TFDisplay::updateFrame( FrameInfo* frame, const FrameManager::FramePose& pose )
 {
   tf::TransformListener* tf = context_->getTFClient();
 
   // Check last received time so we can grey out/fade out frames that have stopped being published
-  ros::Time latest_time;
-  tf->getLatestCommonTime( fixed_frame_.toStdString(), frame->name_, latest_time, 0 );
+  const ros::Time& latest_time = pose.stamp;
   if( latest_time != frame->last_time_to_fixed_ )
   {
     frame->last_update_ = ros::Time::now();
@@ -508,9 +517,9 @@ void TFDisplay::updateFrame( FrameInfo* frame )
 
   setStatusStd(StatusProperty::Ok, frame->name_, "Transform OK");
 
-  Ogre::Vector3 position;
-  Ogre::Quaternion orientation;
-  if( !context_->getFrameManager()->getTransform( frame->name_, ros::Time(), position, orientation ))
+  const Ogre::Vector3& position = pose.position;
+  const Ogre::Quaternion& orientation = pose.orientation;
+  if( !pose.valid )
   {
     std::stringstream ss;
     ss << "No transform from [" << frame->name_ << "] to frame [" << fixed_frame_.toStdString() << "]";
@@ -652,6 +661,7 @@ void TFDisplay::reset()
 
 FrameInfo::FrameInfo( TFDisplay* display )
   : display_( display )
+  , frame_id_( 0 )
   , axes_( NULL )
   , axes_coll_(NULL)
   , parent_arrow_( NULL )
@@ -39,6 +39,7 @@
 #include "rviz/selection/forwards.h"
 
 #include "rviz/display.h"
+#include "rviz/frame_manager.h"
 
 namespace Ogre
 {
@@ -85,7 +86,7 @@ private Q_SLOTS:
 private:
   void updateFrames();
   FrameInfo* createFrame(const std::string& frame);
-  void updateFrame(FrameInfo* frame);
+  void updateFrame(FrameInfo* frame, const FrameManager::FramePose& pose);
   void deleteFrame(FrameInfo* frame, bool delete_properties);
 
   FrameInfo* getFrameInfo(const std::string& frame);
@@ -142,6 +143,7 @@ public Q_SLOTS:
 public:
   TFDisplay* display_;
   std::string name_;
+  FrameManager::FrameId frame_id_;
   std::string parent_;
   Axes* axes_;
   CollObjectHandle axes_coll_;
@@ -41,9 +41,11 @@
 #include <yaml-cpp/emitter.h>
 
 #include "rviz/display_context.h"
+#include "rviz/frame_profiler.h"
 #include "rviz/properties/yaml_helpers.h"
 #include "rviz/properties/property_tree_model.h"
 #include "rviz/properties/status_list.h"
+#include "rviz/worker_pool.h"
 
 #include "display.h"
 
@@ -55,6 +57,7 @@ namespace rviz
 Display::Display()
   : context_( 0 )
   , scene_node_( NULL )
+  , profile_name_( 0 )
   , status_( 0 )
   , initialized_( false )
   , visibility_bits_( 0xFFFFFFFF )
@@ -80,8 +83,17 @@ void Display::initialize( DisplayContext* context )
   scene_node_ = scene_manager_->getRootSceneNode()->createChildSceneNode();
   
   update_nh_.setCallbackQueue( context_->getUpdateQueue() );
-  threaded_nh_.setCallbackQueue( context_->getThreadedQueue() );
+  if( WorkerPool* pool = context_->getWorkerPool() )
+  {
+    threaded_queue_ = pool->createQueue();
+    threaded_nh_.setCallbackQueue( threaded_queue_.get() );
+  }
+  else
+  {
+    threaded_nh_.setCallbackQueue( context_->getThreadedQueue() );
+  }
   fixed_frame_ = context_->getFixedFrame();
+  updateProfileNames();
 
   onInitialize();
 
@@ -273,6 +285,59 @@ void Display::reset()
   clearStatuses();
 }
 
+void Display::stopThreadedQueue()
+{
+  if( threaded_queue_ )
+  {
+    threaded_queue_->close();
+  }
+}
+
+void Display::updateProfileNames()
+{
+  FrameProfiler* profiler = context_->getFrameProfiler();
+  if( !profiler || getName() == profiled_name_ )
+  {
+    return;
+  }
+
+  profiled_name_ = getName();
+  std::string name = profiled_name_.toStdString();
+  profile_name_ = profiler->registerName( name );
+  if( threaded_queue_ )
+  {
+    threaded_queue_->setProfiling( profiler, profiler->registerName( name + " (messages)" ));
+  }
+}
+
+void Display::updateQueueStatus()
+{
+  // Catch renames, so the profiler shows the current name.
+  updateProfileNames();
+
+  if( !threaded_queue_ )
+  {
+    return;
+  }
+
+  WorkerQueue::Stats stats = threaded_queue_->takeStats();
+  if( stats.calls == 0 && stats.depth == 0 )
+  {
+    if( status_ )
+    {
+      deleteStatus( "Message Processing" );
+    }
+    return;
+  }
+
+  QString text = QString( "%1 queued, %2 processed" ).arg( stats.depth ).arg( stats.calls );
+  if( stats.calls > 0 )
+  {
+    text += QString( " at %1 ms each" ).arg( stats.busy.toSec() * 1000.0 / stats.calls, 0, 'f', 2 );
+  }
+  setStatus( StatusProperty::Ok, "Message Processing", text );
+}
+
 void Display::onEnableChanged()
 {
   QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
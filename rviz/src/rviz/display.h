@@ -33,6 +33,8 @@
 
 #include <ros/ros.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include "rviz/properties/status_property.h"
 #include "rviz/properties/property.h"
 
@@ -49,6 +51,7 @@ namespace rviz
 
 class StatusList;
 class DisplayContext;
+class WorkerQueue;
 
 class Display: public Property
 {
@@ -118,6 +121,14 @@ public:
   /** @brief Called to tell the display to clear its state */
   virtual void reset();
 
+  /** @brief Show how many messages are waiting in threaded_nh_'s queue and how long they take to process.
+   *
+   * Called about once a second by the visualization manager. */
+  virtual void updateQueueStatus();
+
+  /** @brief Return the FrameProfiler id under which update() of this display is recorded. */
+  uint32_t getProfileName() const { return profile_name_; }
+
   /** @brief Show status level and text.
    * @param level One of StatusProperty::Ok, StatusProperty::Warn, or StatusProperty::Error.
    * @param name The name of the child entry to set.
@@ -181,6 +192,13 @@ protected:
   /** @brief Derived classes override this to do the actual work of disabling themselves. */
   virtual void onDisable() {}
 
+  /** @brief Stop running callbacks from threaded_nh_'s queue, waiting for one which is running.
+   *
+   * Call this at the start of a destructor which deletes objects the
+   * callbacks use, when the subscriptions adding them are only torn
+   * down later by a parent class destructor. */
+  void stopThreadedQueue();
+
   /** @brief Delete all status children.
    *
    * This removes all status children and updates the top-level status. */
@@ -212,6 +230,9 @@ protected:
   ros::NodeHandle update_nh_;
 
   /** @brief A NodeHandle whose CallbackQueue is run from a different thread than the GUI.
+   *
+   * Each Display has a queue of its own on the shared WorkerPool, so
+   * its callbacks run one at a time and in order.
    *
    * This is configured after the constructor and before onInitialize() is called. */
   ros::NodeHandle threaded_nh_;
@@ -229,6 +250,12 @@ private Q_SLOTS:
   void onEnableChanged();
 
 private:
+  /** @brief Register the profiler names for this display, if its name changed. */
+  void updateProfileNames();
+
+  boost::shared_ptr<WorkerQueue> threaded_queue_;
+  QString profiled_name_;      ///< Display name the profiler names were made from
+  uint32_t profile_name_;
   StatusList* status_;
   QString class_id_;
   bool initialized_;
@@ -58,8 +58,10 @@ class BitAllocator;
 class DisplayFactory;
 class DisplayGroup;
 class FrameManager;
+class FrameProfiler;
 class RenderPanel;
 class SelectionManager;
+class WorkerPool;
 class ToolManager;
 class ViewController;
 class ViewportMouseEvent;
@@ -111,6 +113,12 @@ public:
   /** @brief Return a CallbackQueue using a different thread than the main GUI one. */
   virtual ros::CallbackQueueInterface* getThreadedQueue() = 0;
 
+  /** @brief Return the pool of threads running message processing callbacks. */
+  virtual WorkerPool* getWorkerPool() = 0;
+
+  /** @brief Return the profiler recording how long each part of a frame takes. */
+  virtual FrameProfiler* getFrameProfiler() = 0;
+
   /** @brief Handle a single key event for a given RenderPanel. */
   virtual void handleChar( QKeyEvent* event, RenderPanel* panel ) = 0;
 
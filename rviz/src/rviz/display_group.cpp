@@ -36,6 +36,7 @@
 #include "rviz/display_context.h"
 #include "rviz/display_factory.h"
 #include "rviz/failed_display.h"
+#include "rviz/frame_profiler.h"
 #include "rviz/properties/yaml_helpers.h"
 #include "rviz/properties/property_tree_model.h"
 
@@ -214,17 +215,34 @@ void DisplayGroup::fixedFrameChanged()
 
 void DisplayGroup::update( float wall_dt, float ros_dt )
 {
+  FrameProfiler* profiler = context_ ? context_->getFrameProfiler() : 0;
   int num_children = displays_.size();
   for( int i = 0; i < num_children; i++ )
   {
     Display* display = displays_.at( i );
     if( display->isEnabled() )
     {
+      ProfileScope scope( profiler, display->getProfileName() );
       display->update( wall_dt, ros_dt );
     }
   }  
 }
 
+void DisplayGroup::updateQueueStatus()
+{
+  Display::updateQueueStatus();
+
+  int num_children = displays_.size();
+  for( int i = 0; i < num_children; i++ )
+  {
+    Display* display = displays_.at( i );
+    if( display->isEnabled() )
+    {
+      display->updateQueueStatus();
+    }
+  }
+}
+
 void DisplayGroup::reset()
 {
   Display::reset();
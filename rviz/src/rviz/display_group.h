@@ -138,6 +138,9 @@ public:
   /** @brief Call update() on all child Displays. */
   virtual void update( float wall_dt, float ros_dt );
 
+  /** @brief Call updateQueueStatus() on this and all enabled child Displays. */
+  virtual void updateQueueStatus();
+
   /** @brief Reset this and all child Displays. */
   virtual void reset();
 
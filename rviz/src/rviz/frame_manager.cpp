@@ -34,10 +34,151 @@
 #include <tf/transform_listener.h>
 #include <ros/ros.h>
 
+#include <algorithm>
+
 namespace rviz
 {
 
+namespace
+{
+
+/** @brief Walks the tf tree for FrameManager::lookupTransforms().
+ *
+ * Every frame resolved is remembered with its transform to the root
+ * of its tree, so the chain above a frame is looked up only once no
+ * matter how many frames below it are asked for. */
+class TransformTreeWalker
+{
+public:
+  struct Node
+  {
+    Node()
+    : parent(NULL)
+    , depth(0)
+    , valid(false)
+    {}
+
+    const Node* parent;
+    tf::Transform to_root;  ///< Transform from this frame to the root of its tree
+    ros::Time stamp;        ///< Time of the transform to parent
+    int depth;              ///< Number of transforms between this frame and the root
+    bool valid;
+  };
+
+  TransformTreeWalker(tf::Transformer* tf, ros::Time time)
+  : tf_(tf)
+  , tf_prefix_(tf->getTFPrefix())
+  , time_(time)
+  {}
+
+  const Node& resolve(const std::string& frame_name)
+  {
+    // getParent() returns resolved names, so resolve the others the same way to share their nodes
+    std::string frame = tf::resolve(tf_prefix_, frame_name);
+
+    M_Node::iterator it = nodes_.find(frame);
+    if (it != nodes_.end())
+    {
+      return it->second;
+    }
+
+    // Inserted before recursing, so a loop in the tree ends at this invalid node.
+    // References into the map stay valid when it grows.
+    Node& node = nodes_[frame];
+
+    std::string parent;
+    tf::StampedTransform to_parent;
+    try
+    {
+      if (!tf_->frameExists(frame))
+      {
+        return node;
+      }
+
+      if (!tf_->getParent(frame, time_, parent))
+      {
+        node.to_root.setIdentity();
+        node.valid = true;
+        return node;
+      }
+
+      tf_->lookupTransform(parent, frame, time_, to_parent);
+    }
+    catch (tf::TransformException& e)
+    {
+      ROS_DEBUG("Error transforming from frame '%s' to frame '%s': %s", frame.c_str(), parent.c_str(), e.what());
+      return node;
+    }
+
+    const Node& parent_node = resolve(parent);
+    if (parent_node.valid)
+    {
+      node.parent = &parent_node;
+      node.to_root = parent_node.to_root * to_parent;
+      node.stamp = to_parent.stamp_;
+      node.depth = parent_node.depth + 1;
+      node.valid = true;
+    }
+
+    return node;
+  }
+
+  /** @brief Compute the transform from source to target, and the oldest time of the transforms in between.
+   * @return false if either frame is invalid or they are in different trees. */
+  bool relative(const Node& target, const Node& source, tf::Transform& transform, ros::Time& stamp) const
+  {
+    if (!target.valid || !source.valid)
+    {
+      return false;
+    }
+
+    // Walk both frames up to their closest common ancestor
+    ros::Time oldest = ros::TIME_MAX;
+    const Node* s = &source;
+    const Node* t = &target;
+    while (s->depth > t->depth)
+    {
+      oldest = std::min(oldest, s->stamp);
+      s = s->parent;
+    }
+    while (t->depth > s->depth)
+    {
+      oldest = std::min(oldest, t->stamp);
+      t = t->parent;
+    }
+    while (s != t)
+    {
+      if (!s->parent || !t->parent)
+      {
+        return false;
+      }
+      oldest = std::min(oldest, std::min(s->stamp, t->stamp));
+      s = s->parent;
+      t = t->parent;
+    }
+
+    transform = target.to_root.inverse() * source.to_root;
+    // Like tf::Transformer::getLatestCommonTime() for a frame and itself
+    stamp = (oldest == ros::TIME_MAX) ? ros::Time::now() : oldest;
+    return true;
+  }
+
+private:
+  typedef boost::unordered_map<std::string, Node> M_Node;
+
+  tf::Transformer* tf_;
+  std::string tf_prefix_;
+  ros::Time time_;
+  M_Node nodes_;
+};
+
+} // namespace
+
 FrameManager::FrameManager()
+: snapshot_(new M_Cache)
+, frame_table_(new FrameTable)
+, cache_hits_(0)
+, cache_misses_(0)
 {
   tf_ = new tf::TransformListener(ros::NodeHandle(), ros::Duration(10*60), false);
 }
@@ -49,8 +190,73 @@ FrameManager::~FrameManager()
 
 void FrameManager::update()
 {
+  std::vector<FrameId> latest;
+  {
+    boost::mutex::scoped_lock lock(cache_mutex_);
+
+    CachePtr old_snapshot = getSnapshot();
+    M_Cache::const_iterator it = old_snapshot->begin();
+    for (; it != old_snapshot->end(); ++it)
+    {
+      // Entries nobody asked for since the last update are let go
+      if (it->first.time.isZero() && it->second.used != 0)
+      {
+        latest.push_back(it->first.frame);
+      }
+    }
+    for (it = pending_.begin(); it != pending_.end(); ++it)
+    {
+      if (it->first.time.isZero())
+      {
+        latest.push_back(it->first.frame);
+      }
+    }
+  }
+
+  std::sort(latest.begin(), latest.end());
+  latest.erase(std::unique(latest.begin(), latest.end()), latest.end());
+
+  // Looked up through tf one by one, rather than in one walk like getTransforms(), so each pose
+  // stays at the latest time common to its whole chain as displays calling getTransform() expect.
+  // Without cache_mutex_, so misses on other threads don't wait for all of them: tf locks itself,
+  // and only this thread changes fixed_frame_.
+  boost::shared_ptr<M_Cache> snapshot(new M_Cache);
+  for (size_t i = 0; i < latest.size(); ++i)
+  {
+    FramePose pose;
+    if (lookupTransform(latest[i], ros::Time(), pose))
+    {
+      snapshot->insert(std::make_pair(CacheKey(latest[i], ros::Time()), CacheEntry(pose)));
+    }
+  }
+
   boost::mutex::scoped_lock lock(cache_mutex_);
-  cache_.clear();
+  // Transforms missed meanwhile are dropped with the rest, and looked up again if asked for
+  pending_.clear();
+  publishSnapshot(CachePtr(snapshot));
+}
+
+FrameManager::CachePtr FrameManager::getSnapshot() const
+{
+  boost::mutex::scoped_lock lock(publish_mutex_);
+  return snapshot_;
+}
+
+void FrameManager::publishSnapshot(const CachePtr& snapshot)
+{
+  CachePtr old_snapshot;
+  {
+    boost::mutex::scoped_lock lock(publish_mutex_);
+    old_snapshot = snapshot_;
+    snapshot_ = snapshot;
+  }
+  // old_snapshot is freed here, outside the lock, unless a reader still holds it
+}
+
+FrameManager::FrameTablePtr FrameManager::getFrameTable() const
+{
+  boost::mutex::scoped_lock lock(publish_mutex_);
+  return frame_table_;
 }
 
 void FrameManager::setFixedFrame(const std::string& frame)
@@ -61,7 +267,8 @@ void FrameManager::setFixedFrame(const std::string& frame)
     if( fixed_frame_ != frame )
     {
       fixed_frame_ = frame;
-      cache_.clear();
+      pending_.clear();
+      publishSnapshot(CachePtr(new M_Cache));
       emit = true;
     }
   }
@@ -72,40 +279,219 @@ void FrameManager::setFixedFrame(const std::string& frame)
   }
 }
 
+FrameManager::FrameId FrameManager::internFrame(const std::string& frame)
+{
+  FrameTablePtr table = getFrameTable();
+  boost::unordered_map<std::string, FrameId>::const_iterator it = table->ids.find(frame);
+  if (it != table->ids.end())
+  {
+    return it->second;
+  }
+
+  boost::mutex::scoped_lock lock(intern_mutex_);
+
+  // Another thread may have added it in the meantime
+  table = getFrameTable();
+  it = table->ids.find(frame);
+  if (it != table->ids.end())
+  {
+    return it->second;
+  }
+
+  // New frame names are rare, so copying the table keeps readers lock-free at little cost
+  boost::shared_ptr<FrameTable> new_table(new FrameTable(*table));
+  FrameId id = new_table->names.size();
+  new_table->names.push_back(frame);
+  new_table->ids[frame] = id;
+  {
+    boost::mutex::scoped_lock publish_lock(publish_mutex_);
+    frame_table_ = new_table;
+  }
+
+  return id;
+}
+
 bool FrameManager::getTransform(const std::string& frame, ros::Time time, Ogre::Vector3& position, Ogre::Quaternion& orientation)
 {
-  boost::mutex::scoped_lock lock(cache_mutex_);
+  return getTransform(internFrame(frame), time, position, orientation);
+}
 
+bool FrameManager::getTransform(FrameId frame, ros::Time time, Ogre::Vector3& position, Ogre::Quaternion& orientation)
+{
   position = Ogre::Vector3(9999999, 9999999, 9999999);
   orientation = Ogre::Quaternion::IDENTITY;
 
-  if (fixed_frame_.empty())
+  CacheKey key(frame, time);
+  CachePtr snapshot = getSnapshot();
+  M_Cache::const_iterator it = snapshot->find(key);
+  if (it != snapshot->end())
   {
-    return false;
+    ++cache_hits_;
+    it->second.markUsed();
+    position = it->second.pose.position;
+    orientation = it->second.pose.orientation;
+    return true;
   }
 
-  M_Cache::iterator it = cache_.find(CacheKey(frame, time));
-  if (it != cache_.end())
+  boost::mutex::scoped_lock lock(cache_mutex_);
+
+  it = pending_.find(key);
+  if (it != pending_.end())
   {
-    position = it->second.position;
-    orientation = it->second.orientation;
+    ++cache_hits_;
+    position = it->second.pose.position;
+    orientation = it->second.pose.orientation;
     return true;
   }
 
-  geometry_msgs::Pose pose;
-  pose.orientation.w = 1.0f;
-
-  if (!transform(frame, time, pose, position, orientation))
+  ++cache_misses_;
+  FramePose pose;
+  if (!lookupTransform(frame, time, pose))
   {
     return false;
   }
 
-  cache_.insert(std::make_pair(CacheKey(frame, time), CacheEntry(position, orientation)));
+  pending_.insert(std::make_pair(key, CacheEntry(pose)));
 
+  position = pose.position;
+  orientation = pose.orientation;
   return true;
 }
 
+size_t FrameManager::getTransforms(const std::vector<FrameId>& frames, ros::Time time, V_FramePose& poses)
+{
+  poses.assign(frames.size(), FramePose());
+
+  size_t found = 0;
+  std::vector<size_t> misses;
+
+  CachePtr snapshot = getSnapshot();
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    M_Cache::const_iterator it = snapshot->find(CacheKey(frames[i], time));
+    if (it != snapshot->end())
+    {
+      ++cache_hits_;
+      it->second.markUsed();
+      poses[i] = it->second.pose;
+      ++found;
+    }
+    else
+    {
+      misses.push_back(i);
+    }
+  }
+
+  if (misses.empty())
+  {
+    return found;
+  }
+
+  boost::mutex::scoped_lock lock(cache_mutex_);
+
+  std::vector<size_t> lookups;
+  for (size_t i = 0; i < misses.size(); ++i)
+  {
+    M_Cache::const_iterator it = pending_.find(CacheKey(frames[misses[i]], time));
+    if (it != pending_.end())
+    {
+      ++cache_hits_;
+      poses[misses[i]] = it->second.pose;
+      ++found;
+    }
+    else
+    {
+      ++cache_misses_;
+      lookups.push_back(misses[i]);
+    }
+  }
+
+  lookupTransforms(frames, lookups, time, poses);
+
+  for (size_t i = 0; i < lookups.size(); ++i)
+  {
+    const FramePose& pose = poses[lookups[i]];
+    if (pose.valid)
+    {
+      pending_.insert(std::make_pair(CacheKey(frames[lookups[i]], time), CacheEntry(pose)));
+      ++found;
+    }
+  }
+
+  return found;
+}
+
+bool FrameManager::lookupTransform(FrameId frame, ros::Time time, FramePose& pose)
+{
+  if (fixed_frame_.empty())
+  {
+    return false;
+  }
+
+  FrameTablePtr table = getFrameTable();
+  if (frame >= table->names.size())
+  {
+    return false;
+  }
+
+  geometry_msgs::Pose pose_msg;
+  pose_msg.orientation.w = 1.0f;
+
+  pose.valid = transformPose(table->names[frame], time, pose_msg, pose.position, pose.orientation, pose.stamp);
+  return pose.valid;
+}
+
+void FrameManager::lookupTransforms(const std::vector<FrameId>& frames, const std::vector<size_t>& indices, ros::Time time, V_FramePose& poses)
+{
+  if (indices.empty() || fixed_frame_.empty())
+  {
+    return;
+  }
+
+  FrameTablePtr table = getFrameTable();
+  TransformTreeWalker walker(tf_, time);
+
+  const TransformTreeWalker::Node& fixed = walker.resolve(fixed_frame_);
+  if (!fixed.valid)
+  {
+    return;
+  }
+
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    FrameId frame = frames[indices[i]];
+    if (frame >= table->names.size())
+    {
+      continue;
+    }
+
+    const TransformTreeWalker::Node& node = walker.resolve(table->names[frame]);
+
+    tf::Transform transform;
+    ros::Time stamp;
+    if (!walker.relative(fixed, node, transform, stamp))
+    {
+      ROS_DEBUG("Error transforming from frame '%s' to frame '%s'", table->names[frame].c_str(), fixed_frame_.c_str());
+      continue;
+    }
+
+    FramePose& pose = poses[indices[i]];
+    const tf::Vector3& origin = transform.getOrigin();
+    pose.position = Ogre::Vector3(origin.x(), origin.y(), origin.z());
+    tf::Quaternion rotation = transform.getRotation();
+    pose.orientation = Ogre::Quaternion(rotation.w(), rotation.x(), rotation.y(), rotation.z());
+    pose.stamp = stamp;
+    pose.valid = true;
+  }
+}
+
 bool FrameManager::transform(const std::string& frame, ros::Time time, const geometry_msgs::Pose& pose_msg, Ogre::Vector3& position, Ogre::Quaternion& orientation)
+{
+  ros::Time stamp;
+  return transformPose(frame, time, pose_msg, position, orientation, stamp);
+}
+
+bool FrameManager::transformPose(const std::string& frame, ros::Time time, const geometry_msgs::Pose& pose_msg, Ogre::Vector3& position, Ogre::Quaternion& orientation, ros::Time& stamp)
 {
   position = Ogre::Vector3::ZERO;
   orientation = Ogre::Quaternion::IDENTITY;
@@ -139,6 +525,8 @@ bool FrameManager::transform(const std::string& frame, ros::Time time, const geo
   bt_orientation = pose_out.getRotation();
   orientation = Ogre::Quaternion( bt_orientation.w(), bt_orientation.x(), bt_orientation.y(), bt_orientation.z() );
 
+  stamp = pose_out.stamp_;
+
   return true;
 }
 
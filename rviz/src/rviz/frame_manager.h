@@ -30,7 +30,8 @@
 #ifndef RVIZ_FRAME_MANAGER_H
 #define RVIZ_FRAME_MANAGER_H
 
-#include <map>
+#include <string>
+#include <vector>
 
 #include <QObject>
 
@@ -39,7 +40,11 @@
 #include <OGRE/OgreVector3.h>
 #include <OGRE/OgreQuaternion.h>
 
+#include <boost/detail/atomic_count.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <geometry_msgs/Pose.h>
 
@@ -57,11 +62,35 @@ class Display;
 /** @brief Helper class for transforming data into Ogre's world frame (the fixed frame).
  *
  * During one frame update (nominally 33ms), the tf tree stays consistent and queries are cached for speedup.
+ *
+ * The cache is published once per update() as an immutable snapshot,
+ * so getTransform() calls which hit it, from any thread, only hold a
+ * lock for as long as it takes to copy a shared_ptr.  Only misses
+ * serialize on a mutex for their tf lookup.
  */
 class FrameManager: public QObject
 {
 Q_OBJECT
 public:
+  /** @brief Small integer standing for a frame name, see internFrame(). */
+  typedef uint32_t FrameId;
+
+  /** @brief Pose of a frame relative to the fixed frame, as returned by getTransforms(). */
+  struct FramePose
+  {
+    FramePose()
+    : position(9999999, 9999999, 9999999)
+    , orientation(Ogre::Quaternion::IDENTITY)
+    , valid(false)
+    {}
+
+    Ogre::Vector3 position;
+    Ogre::Quaternion orientation;
+    ros::Time stamp;   ///< Latest time common to all transforms between the frame and the fixed frame
+    bool valid;        ///< False if the frame could not be transformed into the fixed frame
+  };
+  typedef std::vector<FramePose> V_FramePose;
+
   FrameManager();
 
   /** @brief Destructor.
@@ -96,6 +125,34 @@ public:
    * @return true on success, false on failure. */
   bool getTransform(const std::string& frame, ros::Time time, Ogre::Vector3& position, Ogre::Quaternion& orientation);
 
+  /** @brief Same as above, for a frame name already interned with internFrame().
+   *
+   * Saves hashing the frame name, for callers asking for the same frames every update. */
+  bool getTransform(FrameId frame, ros::Time time, Ogre::Vector3& position, Ogre::Quaternion& orientation);
+
+  /** @brief Return the poses of many frames relative to the fixed frame at once.
+   * @param[in] frames The frames to find the poses of, interned with internFrame().
+   * @param[in] time The time at which to get the poses.
+   * @param[out] poses One pose per entry in frames, with FramePose::valid set on success.
+   * @return The number of frames transformed successfully.
+   *
+   * Frames missing from the cache are resolved in a single walk of
+   * the tf tree: each transform between a frame and its parent is
+   * looked up once and shared by every frame below it, instead of
+   * tf walking the whole chain for every frame.  With
+   * ros::Time(), each of those transforms is taken at its own latest
+   * time rather than at the latest time common to the whole chain. */
+  size_t getTransforms(const std::vector<FrameId>& frames, ros::Time time, V_FramePose& poses);
+
+  /** @brief Return the id of a frame name.  The same name always gets the same id. */
+  FrameId internFrame(const std::string& frame);
+
+  /** @brief Return the number of getTransform() calls answered from the cache so far. */
+  unsigned long getCacheHits() const { return cache_hits_; }
+
+  /** @brief Return the number of getTransform() calls which had to ask tf so far. */
+  unsigned long getCacheMisses() const { return cache_misses_; }
+
   /** @brief Transform a pose from a frame into the fixed frame.
    * @param[in] header The source of the input frame and time.
    * @param[in] pose The input pose, relative to the header frame.
@@ -117,7 +174,17 @@ public:
    * @return true on success, false on failure. */
   bool transform(const std::string& frame, ros::Time time, const geometry_msgs::Pose& pose, Ogre::Vector3& position, Ogre::Quaternion& orientation);
 
-  /** @brief Clear the internal cache. */
+  /** @brief Publish a new cache snapshot for this frame update.
+   *
+   * Transforms at the latest time (ros::Time()) which were asked for
+   * since the last update, whether they hit the cache or not, are
+   * looked up again and carry over, so the frames displays ask for
+   * every update stay cache hits.  Everything else is dropped.
+   *
+   * The lookups go through tf like getTransform(), so carried over
+   * poses are at the latest time common to the whole chain, even for
+   * frames first asked for with getTransforms().  They are done before
+   * taking the lock cache misses wait on.  Call from the GUI thread. */
   void update();
 
   /** @brief Check to see if a frame exists in the tf::TransformListener.
@@ -191,39 +258,103 @@ private:
 
   struct CacheKey
   {
-    CacheKey(const std::string& f, ros::Time t)
+    CacheKey(FrameId f, ros::Time t)
     : frame(f)
     , time(t)
     {}
 
-    bool operator<(const CacheKey& rhs) const
+    bool operator==(const CacheKey& rhs) const
     {
-      if (frame != rhs.frame)
-      {
-        return frame < rhs.frame;
-      }
+      return frame == rhs.frame && time == rhs.time;
+    }
 
-      return time < rhs.time;
+    friend std::size_t hash_value(const CacheKey& key)
+    {
+      std::size_t seed = key.frame;
+      boost::hash_combine(seed, key.time.sec);
+      boost::hash_combine(seed, key.time.nsec);
+      return seed;
     }
 
-    std::string frame;
+    FrameId frame;
     ros::Time time;
   };
 
   struct CacheEntry
   {
-    CacheEntry(const Ogre::Vector3& p, const Ogre::Quaternion& o)
-    : position(p)
-    , orientation(o)
+    CacheEntry(const FramePose& p)
+    : pose(p)
+    , used(0)
     {}
 
-    Ogre::Vector3 position;
-    Ogre::Quaternion orientation;
+    CacheEntry(const CacheEntry& other)
+    : pose(other.pose)
+    , used(static_cast<long>(other.used))
+    {}
+
+    /** @brief Record a hit.  Only writes the first time, so threads hitting the same entry don't fight over it. */
+    void markUsed() const
+    {
+      if (used == 0)
+      {
+        ++used;
+      }
+    }
+
+    FramePose pose;
+    mutable boost::detail::atomic_count used;   ///< Non-zero once hit, see update()
   };
-  typedef std::map<CacheKey, CacheEntry > M_Cache;
 
-  boost::mutex cache_mutex_;
-  M_Cache cache_;
+  typedef boost::unordered_map<CacheKey, CacheEntry> M_Cache;
+
+  /** @brief Lookup transform of an interned frame.
+   *
+   * Call with cache_mutex_ locked, or from the GUI thread, which is the
+   * only one changing fixed_frame_. */
+  bool lookupTransform(FrameId frame, ros::Time time, FramePose& pose);
+
+  /** @brief Lookup transforms of many interned frames in one walk of the tf tree.  Call with cache_mutex_ locked.
+   *
+   * Only the entries of poses listed in indices are filled in. */
+  void lookupTransforms(const std::vector<FrameId>& frames, const std::vector<size_t>& indices, ros::Time time, V_FramePose& poses);
+
+  /** @brief transform(), also returning the time the transform was looked up at. */
+  bool transformPose(const std::string& frame, ros::Time time, const geometry_msgs::Pose& pose, Ogre::Vector3& position, Ogre::Quaternion& orientation, ros::Time& stamp);
+
+  typedef boost::shared_ptr<const M_Cache> CachePtr;
+
+  /** @brief Return the current snapshot, see publishSnapshot(). */
+  CachePtr getSnapshot() const;
+
+  /** @brief Replace the snapshot.  It is never modified afterwards, apart from CacheEntry::used. */
+  void publishSnapshot(const CachePtr& snapshot);
+
+  // Only ever swapped whole, under publish_mutex_
+  CachePtr snapshot_;
+
+  boost::mutex cache_mutex_;   ///< Guards pending_ and fixed_frame_, and is held for tf lookups of misses
+  M_Cache pending_;            ///< Transforms looked up since snapshot_ was published
+
+  struct FrameTable
+  {
+    boost::unordered_map<std::string, FrameId> ids;
+    std::vector<std::string> names;
+  };
+  typedef boost::shared_ptr<const FrameTable> FrameTablePtr;
+
+  /** @brief Return the current frame table, see internFrame(). */
+  FrameTablePtr getFrameTable() const;
+
+  FrameTablePtr frame_table_;  ///< Published like snapshot_
+  boost::mutex intern_mutex_;  ///< Serializes writers of frame_table_
+
+  // boost::atomic_load() on shared_ptr needs Boost 1.53, so the two
+  // pointers are copied and swapped under this instead.  It is never
+  // held for anything else.
+  mutable boost::mutex publish_mutex_;
+
+  boost::detail::atomic_count cache_hits_;
+  boost::detail::atomic_count cache_misses_;
 
   tf::TransformListener* tf_;
   std::string fixed_frame_;
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdio.h>
+
+#include "rviz/frame_profiler.h"
+
+namespace rviz
+{
+
+/** Keep the compiler and CPU from moving slot writes across the
+ * sequence number writes.  C++03 has nothing portable for this. */
+static inline void memoryBarrier()
+{
+#if defined(__GNUC__)
+  __sync_synchronize();
+#endif
+}
+
+static bool eventStartsBefore( const FrameProfiler::Event& a, const FrameProfiler::Event& b )
+{
+  return a.start < b.start;
+}
+
+static void writeJsonString( std::ostream& out, const std::string& str )
+{
+  out << '"';
+  for( size_t i = 0; i < str.size(); i++ )
+  {
+    unsigned char c = str[ i ];
+    if( c == '"' || c == '\\' )
+    {
+      out << '\\' << c;
+    }
+    else if( c < 0x20 )
+    {
+      char buf[ 8 ];
+      snprintf( buf, sizeof( buf ), "\\u%04x", c );
+      out << buf;
+    }
+    else
+    {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+FrameProfiler::FrameProfiler( size_t capacity )
+: slots_( new Slot[ capacity ] )
+, capacity_( capacity )
+, next_( 0 )
+, frame_( 0 )
+, threads_( 0 )
+, enabled_( false )
+{
+}
+
+uint32_t FrameProfiler::registerName( const std::string& name )
+{
+  boost::mutex::scoped_lock lock( names_mutex_ );
+  std::map<std::string, uint32_t>::iterator it = name_ids_.find( name );
+  if( it != name_ids_.end() )
+  {
+    return it->second;
+  }
+  uint32_t id = names_.size();
+  names_.push_back( name );
+  name_ids_[ name ] = id;
+  return id;
+}
+
+std::string FrameProfiler::getName( uint32_t id ) const
+{
+  boost::mutex::scoped_lock lock( names_mutex_ );
+  return id < names_.size() ? names_[ id ] : std::string();
+}
+
+uint32_t FrameProfiler::getThreadId()
+{
+  uint32_t* id = thread_id_.get();
+  if( !id )
+  {
+    id = new uint32_t( ++threads_ );
+    thread_id_.reset( id );
+  }
+  return *id;
+}
+
+void FrameProfiler::record( uint32_t name, const ros::WallTime& start, const ros::WallTime& end )
+{
+  if( !enabled_ )
+  {
+    return;
+  }
+
+  long index = ++next_ - 1;
+  Slot& slot = slots_[ index % capacity_ ];
+
+  slot.sequence = 0;
+  memoryBarrier();
+  slot.event.name = name;
+  slot.event.thread = getThreadId();
+  slot.event.frame = getFrame();
+  slot.event.start = start;
+  slot.event.duration = end - start;
+  memoryBarrier();
+  slot.sequence = index + 1;
+}
+
+void FrameProfiler::getEvents( std::vector<Event>& events ) const
+{
+  events.clear();
+
+  long end = next_;
+  long begin = std::max( 0L, end - (long) capacity_ );
+  events.reserve( end - begin );
+
+  for( long index = begin; index < end; index++ )
+  {
+    const Slot& slot = slots_[ index % capacity_ ];
+    long sequence = slot.sequence;
+    memoryBarrier();
+    Event event = slot.event;
+    memoryBarrier();
+    // Skip slots being written, or overwritten since we looked at next_.
+    if( sequence == index + 1 && slot.sequence == sequence )
+    {
+      events.push_back( event );
+    }
+  }
+
+  // Events are written when they end, so nested ones come first.
+  std::stable_sort( events.begin(), events.end(), eventStartsBefore );
+}
+
+void FrameProfiler::clear()
+{
+  // Events written while this runs may survive, which is harmless.
+  for( size_t i = 0; i < capacity_; i++ )
+  {
+    slots_[ i ].sequence = 0;
+  }
+}
+
+void FrameProfiler::writeChromeTrace( std::ostream& out ) const
+{
+  std::vector<Event> events;
+  getEvents( events );
+
+  ros::WallTime origin = events.empty() ? ros::WallTime() : events.front().start;
+
+  // Microseconds, with full precision however long after the origin
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision( 3 );
+
+  out << "{\"traceEvents\":[";
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    const Event& event = events[ i ];
+    if( i > 0 )
+    {
+      out << ",";
+    }
+    out << "\n{\"name\":";
+    writeJsonString( out, getName( event.name ));
+    out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread;
+    out << ",\"ts\":" << (event.start - origin).toNSec() / 1000.0;
+    out << ",\"dur\":" << event.duration.toNSec() / 1000.0;
+    out << ",\"args\":{\"frame\":" << event.frame << "}}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  out.flags( flags );
+  out.precision( precision );
+}
+
+bool FrameProfiler::writeChromeTrace( const std::string& path ) const
+{
+  std::ofstream out( path.c_str() );
+  if( !out )
+  {
+    return false;
+  }
+  writeChromeTrace( out );
+  return out.good();
+}
+
+} // namespace rviz
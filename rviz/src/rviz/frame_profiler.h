@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_FRAME_PROFILER_H
+#define RVIZ_FRAME_PROFILER_H
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <ros/time.h>
+
+namespace rviz
+{
+
+/** @brief Records how long the parts of each update and render take.
+ *
+ * Timings go into a fixed-size ring buffer which any thread may
+ * write without taking a lock, so the GUI thread and the worker
+ * threads can be measured the same way.  When the buffer is full the
+ * oldest events are overwritten.  Recording is off by default, and
+ * costs one branch per measured scope while off.
+ *
+ * Each measured thing is identified by a number from registerName(),
+ * so recording does not have to copy strings. */
+class FrameProfiler
+{
+public:
+  /** @brief A single finished measurement, see getEvents(). */
+  struct Event
+  {
+    uint32_t name;           ///< Id from registerName()
+    uint32_t thread;         ///< Small number identifying the thread, starting at 1
+    uint32_t frame;          ///< Value of getFrame() when the event ended
+    ros::WallTime start;
+    ros::WallDuration duration;
+  };
+
+  FrameProfiler( size_t capacity = 16384 );
+
+  /** @brief Return the id for @a name, registering it the first time. */
+  uint32_t registerName( const std::string& name );
+
+  /** @brief Return the name registered as @a id. */
+  std::string getName( uint32_t id ) const;
+
+  void setEnabled( bool enabled ) { enabled_ = enabled; }
+  bool isEnabled() const { return enabled_; }
+
+  /** @brief Start a new frame.  Called once per update cycle by the GUI thread. */
+  void beginFrame() { ++frame_; }
+
+  /** @brief Return the number of the current frame. */
+  uint32_t getFrame() const { return (uint32_t) frame_; }
+
+  /** @brief Record a measurement, if enabled.  Safe to call from any thread. */
+  void record( uint32_t name, const ros::WallTime& start, const ros::WallTime& end );
+
+  /** @brief Copy the events in the buffer to @a events, oldest first.
+   *
+   * Events being overwritten while this runs are left out. */
+  void getEvents( std::vector<Event>& events ) const;
+
+  /** @brief Throw away all recorded events. */
+  void clear();
+
+  /** @brief Write the buffered events in the Chrome trace event format.
+   *
+   * The output can be loaded in chrome://tracing. */
+  void writeChromeTrace( std::ostream& out ) const;
+
+  /** @brief Write a Chrome trace to a file.  Returns false if it can't be written. */
+  bool writeChromeTrace( const std::string& path ) const;
+
+private:
+  struct Slot
+  {
+    Slot()
+    : sequence( 0 )
+    {}
+
+    /** Index of the event in the slot plus one, written last.  Zero
+     * while the slot is being written. */
+    volatile long sequence;
+    Event event;
+  };
+
+  uint32_t getThreadId();
+
+  boost::scoped_array<Slot> slots_;
+  size_t capacity_;
+  boost::detail::atomic_count next_;       ///< Index of the next event to be written
+  boost::detail::atomic_count frame_;
+  boost::detail::atomic_count threads_;    ///< Number of thread ids handed out
+  volatile bool enabled_;
+
+  boost::thread_specific_ptr<uint32_t> thread_id_;
+
+  std::vector<std::string> names_;
+  std::map<std::string, uint32_t> name_ids_;
+  mutable boost::mutex names_mutex_;       ///< Guards names_ and name_ids_
+};
+
+/** @brief Records the time from its construction to its destruction in a FrameProfiler.
+ *
+ * Does nothing if the profiler is NULL or not enabled when the scope starts. */
+class ProfileScope
+{
+public:
+  ProfileScope( FrameProfiler* profiler, uint32_t name )
+  : profiler_( profiler && profiler->isEnabled() ? profiler : 0 )
+  , name_( name )
+  {
+    if( profiler_ )
+    {
+      start_ = ros::WallTime::now();
+    }
+  }
+
+  ~ProfileScope()
+  {
+    if( profiler_ )
+    {
+      profiler_->record( name_, start_, ros::WallTime::now() );
+    }
+  }
+
+private:
+  FrameProfiler* profiler_;
+  uint32_t name_;
+  ros::WallTime start_;
+};
+
+} // namespace rviz
+
+#endif // RVIZ_FRAME_PROFILER_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "rviz/frame_scheduler.h"
+
+namespace rviz
+{
+
+// Without activity for this long, updates drop to the idle rate.
+static const double IDLE_AFTER = 1.0;
+
+const FrameScheduler::Timing FrameScheduler::TIMINGS[] =
+{
+  // min_update, max_update, idle_update, min_frame, max_frame
+  { 0.033, 0.033, 0.033, 0.016, 0.1 }, // Continuous: the fixed timers rviz always had
+  { 0.016, 0.033, 0.1,   0.016, 1.0 }, // OnChange
+  { 0.004, 0.016, 0.033, 0.0,   1.0 }, // LowLatency: vsync limits the frame rate
+  { 0.1,   0.2,   0.5,   0.1,   0.0 }, // PowerSaving
+};
+
+FrameScheduler::FrameScheduler( Mode mode )
+: mode_( mode )
+, last_activity_( -1.0 )
+, activity_interval_( 0.0 )
+, last_render_( -1.0 )
+{
+  setMode( mode );
+}
+
+void FrameScheduler::setMode( Mode mode )
+{
+  mode_ = mode;
+  activity_interval_ = timing().max_update;
+}
+
+void FrameScheduler::activity( double now )
+{
+  if( last_activity_ >= 0.0 && now - last_activity_ < IDLE_AFTER )
+  {
+    activity_interval_ = 0.8 * activity_interval_ + 0.2 * ( now - last_activity_ );
+  }
+  last_activity_ = now;
+}
+
+double FrameScheduler::nextUpdateDelay( double now ) const
+{
+  const Timing& t = timing();
+  if( last_activity_ < 0.0 || now - last_activity_ > IDLE_AFTER )
+  {
+    return t.idle_update;
+  }
+  return std::max( t.min_update, std::min( t.max_update, activity_interval_ * 0.5 ));
+}
+
+double FrameScheduler::minUpdateDelay() const
+{
+  return timing().min_update;
+}
+
+double FrameScheduler::nextRenderDelay( double now, bool requested ) const
+{
+  const Timing& t = timing();
+  if( last_render_ < 0.0 )
+  {
+    return 0.0;
+  }
+
+  double since_render = now - last_render_;
+  if( !requested )
+  {
+    if( t.max_frame <= 0.0 || since_render < t.max_frame )
+    {
+      return -1.0;
+    }
+    return 0.0;
+  }
+  return std::max( 0.0, t.min_frame - since_render );
+}
+
+void FrameScheduler::rendered( double now )
+{
+  last_render_ = now;
+}
+
+} // namespace rviz
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_FRAME_SCHEDULER_H
+#define RVIZ_FRAME_SCHEDULER_H
+
+namespace rviz
+{
+
+/** @brief Decides when VisualizationManager updates displays and when it renders.
+ *
+ * Pure bookkeeping: it is told when messages or input arrive and
+ * when frames are rendered, and answers how long to wait before the
+ * next update and the next render.  All times are in seconds. */
+class FrameScheduler
+{
+public:
+  enum Mode
+  {
+    Continuous,   ///< Update at 30Hz, render at least every 100ms whether or not anything changed
+    OnChange,     ///< Render only when something changed, update as often as messages arrive
+    LowLatency,   ///< Like OnChange, but update soon after every message and render without a frame rate cap
+    PowerSaving   ///< Like OnChange, with low update and frame rates
+  };
+
+  FrameScheduler( Mode mode = OnChange );
+
+  void setMode( Mode mode );
+  Mode getMode() const { return mode_; }
+
+  /** @brief Record that messages or input arrived since the last update. */
+  void activity( double now );
+
+  /** @brief Return how long to wait before the next update.
+   *
+   * While messages keep arriving, updates happen about twice per
+   * message interval, within the limits of the mode.  After a second
+   * without any, updates slow down to the mode's idle rate. */
+  double nextUpdateDelay( double now ) const;
+
+  /** @brief Return the shortest time to wait before any update, for waking up early on input. */
+  double minUpdateDelay() const;
+
+  /** @brief Return how long to wait before rendering, or a negative value if no render is needed.
+   * @param requested True if a render was queued since the last one. */
+  double nextRenderDelay( double now, bool requested ) const;
+
+  /** @brief Record that a frame was rendered. */
+  void rendered( double now );
+
+  /** @brief Return the smoothed time between updates which saw activity. */
+  double getActivityInterval() const { return activity_interval_; }
+
+private:
+  struct Timing
+  {
+    double min_update;   ///< Shortest update interval while messages arrive
+    double max_update;   ///< Longest update interval while messages arrive
+    double idle_update;  ///< Update interval without messages
+    double min_frame;    ///< Shortest time between renders
+    double max_frame;    ///< Longest time between renders, or 0 to render only when asked
+  };
+
+  const Timing& timing() const { return TIMINGS[ mode_ ]; }
+
+  static const Timing TIMINGS[];  ///< Indexed by Mode
+
+  Mode mode_;
+  double last_activity_;
+  double activity_interval_;
+  double last_render_;
+};
+
+} // namespace rviz
+
+#endif // RVIZ_FRAME_SCHEDULER_H
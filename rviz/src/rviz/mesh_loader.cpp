@@ -255,12 +255,13 @@ void buildMesh(const aiScene* scene, const aiNode* node, const Ogre::MeshPtr& me
 
     // todo vertex colors
 
-    // allocate the vertex buffer
+    // allocate the vertex buffer, with a shadow copy so ray picks can
+    // read the triangles without going to the GPU
     vertex_data->vertexCount = input_mesh->mNumVertices;
     Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(vertex_decl->getVertexSize(0),
                                                                           vertex_data->vertexCount,
                                                                           Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY,
-                                                                          false);
+                                                                          true);
 
     vertex_data->vertexBufferBinding->setBinding(0, vbuf);
     float* vertices = static_cast<float*>(vbuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
@@ -313,7 +314,7 @@ void buildMesh(const aiScene* scene, const aiNode* node, const Ogre::MeshPtr& me
         Ogre::HardwareIndexBuffer::IT_16BIT,
         submesh->indexData->indexCount,
         Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY,
-        false);
+        true);
 
       Ogre::HardwareIndexBufferSharedPtr ibuf = submesh->indexData->indexBuffer;
       uint16_t* indices = static_cast<uint16_t*>(ibuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
@@ -341,7 +342,7 @@ void buildMesh(const aiScene* scene, const aiNode* node, const Ogre::MeshPtr& me
         Ogre::HardwareIndexBuffer::IT_32BIT,
         submesh->indexData->indexCount,
         Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY,
-        false);
+        true);
 
       Ogre::HardwareIndexBufferSharedPtr ibuf = submesh->indexData->indexBuffer;
       uint32_t* indices = static_cast<uint32_t*>(ibuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
@@ -30,6 +30,8 @@
 #include "point_cloud.h"
 #include <ros/assert.h>
 
+#include "rviz/validate_floats.h"
+
 #include <OGRE/OgreSceneManager.h>
 #include <OGRE/OgreSceneNode.h>
 #include <OGRE/OgreVector3.h>
@@ -40,6 +42,10 @@
 #include <OGRE/OgreBillboard.h>
 #include <OGRE/OgreTexture.h>
 #include <OGRE/OgreTextureManager.h>
+#include <OGRE/OgreMath.h>
+#include <OGRE/OgreMatrix4.h>
+#include <OGRE/OgreRay.h>
+#include <OGRE/OgreRenderSystem.h>
 
 #include <sstream>
 
@@ -54,6 +60,17 @@
 namespace rviz
 {
 
+/** @brief Distance from the origin to the farthest corner of a non-null box. */
+static float farthestCornerDistance(const Ogre::AxisAlignedBox& box)
+{
+  const Ogre::Vector3& min = box.getMinimum();
+  const Ogre::Vector3& max = box.getMaximum();
+  Ogre::Vector3 corner(std::max(Ogre::Math::Abs(min.x), Ogre::Math::Abs(max.x)),
+                       std::max(Ogre::Math::Abs(min.y), Ogre::Math::Abs(max.y)),
+                       std::max(Ogre::Math::Abs(min.z), Ogre::Math::Abs(max.z)));
+  return corner.length();
+}
+
 static float g_point_vertices[3] =
 {
   0.0f, 0.0f, 0.0f
@@ -129,12 +146,22 @@ static float g_box_vertices[6*6*3] =
 
 Ogre::String PointCloud::sm_Type = "PointCloud";
 
+PointCloud::ColorFormat PointCloud::color_format_ = PointCloud::COLOR_FORMAT_UNKNOWN;
+
+void PointCloud::resolveColorFormat()
+{
+  Ogre::RenderSystem* render_system = Ogre::Root::getSingletonPtr()->getRenderSystem();
+  color_format_ = render_system->getColourVertexElementType() == Ogre::VET_COLOUR_ABGR ? COLOR_FORMAT_ABGR : COLOR_FORMAT_ARGB;
+}
+
 PointCloud::PointCloud()
 : bounding_radius_( 0.0f )
 , point_count_( 0 )
 , common_direction_( Ogre::Vector3::NEGATIVE_UNIT_Z )
 , common_up_vector_( Ogre::Vector3::UNIT_Y )
 , color_by_index_(false)
+, pick_index_offset_(0)
+, pick_index_shift_(0)
 , current_mode_supports_geometry_shader_(false)
 {
   std::stringstream ss;
@@ -166,11 +193,14 @@ PointCloud::PointCloud()
 
 PointCloud::~PointCloud()
 {
-  point_material_->unload();
-  square_material_->unload();
-  sphere_material_->unload();
-  tile_material_->unload();
-  box_material_->unload();
+  // The materials are clones made for this cloud only, so remove them rather than leave them in the
+  // material manager.  Displays that keep one cloud per message would otherwise leak five per message.
+  Ogre::MaterialPtr* materials[] = { &point_material_, &square_material_, &sphere_material_, &tile_material_, &box_material_ };
+  for (size_t i = 0; i < sizeof(materials) / sizeof(materials[0]); ++i)
+  {
+    (*materials[i])->unload();
+    Ogre::MaterialManager::getSingleton().remove((*materials[i])->getName());
+  }
 }
 
 const Ogre::AxisAlignedBox& PointCloud::getBoundingBox() const
@@ -215,8 +245,7 @@ void PointCloud::regenerateAll()
     return;
   }
 
-  V_Point points;
-  points.swap(points_);
+  V_Point points(points_.begin(), points_.begin() + point_count_);
   uint32_t count = point_count_;
 
   clear();
@@ -224,9 +253,11 @@ void PointCloud::regenerateAll()
   addPoints(&points.front(), count);
 }
 
-void PointCloud::setColorByIndex(bool set)
+void PointCloud::setColorByIndex(bool set, uint32_t index_offset, uint32_t index_shift)
 {
   color_by_index_ = set;
+  pick_index_offset_ = index_offset;
+  pick_index_shift_ = index_shift;
   ROS_INFO("void PointCloud::setColorByIndex(bool set)");
 
   regenerateAll();
@@ -409,22 +440,86 @@ void PointCloud::setAlpha(float alpha)
   }
 }
 
-void PointCloud::addPoints(Point* points, uint32_t num_points)
+void PointCloud::addPoints(const Point* points, uint32_t num_points)
+{
+  if (num_points == 0)
+  {
+    return;
+  }
+
+  reservePoints(num_points);
+  memcpy(&points_[point_count_], points, sizeof(Point) * num_points);
+
+  appendVertices(num_points);
+}
+
+void PointCloud::addPoints( const uint8_t* data, uint32_t point_step, uint32_t xyz_offset, uint32_t rgb_offset,
+                            uint32_t num_points, const Ogre::Matrix4& transform )
 {
   if (num_points == 0)
   {
     return;
   }
 
-  Ogre::Root* root = Ogre::Root::getSingletonPtr();
+  bool abgr = isColorFormatABGR();
+
+  // Clouds posed by their scene node pass the identity, and their points are copied as they are
+  const bool identity = (transform == Ogre::Matrix4::IDENTITY);
+  const float m00 = transform[0][0], m01 = transform[0][1], m02 = transform[0][2], m03 = transform[0][3];
+  const float m10 = transform[1][0], m11 = transform[1][1], m12 = transform[1][2], m13 = transform[1][3];
+  const float m20 = transform[2][0], m21 = transform[2][1], m22 = transform[2][2], m23 = transform[2][3];
+
+  reservePoints(num_points);
+  Point* out = &points_[point_count_];
+  for (uint32_t i = 0; i < num_points; ++i, data += point_step)
+  {
+    const float* xyz = reinterpret_cast<const float*>(data + xyz_offset);
+    uint32_t rgb = *reinterpret_cast<const uint32_t*>(data + rgb_offset);
+    Point& p = out[i];
+
+    float x = xyz[0];
+    float y = xyz[1];
+    float z = xyz[2];
+    if (!validateFloats(x) || !validateFloats(y) || !validateFloats(z))
+    {
+      p.x = 999999.0f;
+      p.y = 999999.0f;
+      p.z = 999999.0f;
+    }
+    else if (identity)
+    {
+      p.x = x;
+      p.y = y;
+      p.z = z;
+    }
+    else
+    {
+      p.x = m00 * x + m01 * y + m02 * z + m03;
+      p.y = m10 * x + m11 * y + m12 * z + m13;
+      p.z = m20 * x + m21 * y + m22 * z + m23;
+    }
+
+    if (abgr)
+    {
+      rgb = ((rgb & 0xff) << 16) | (rgb & 0xff00) | ((rgb >> 16) & 0xff);
+    }
+    p.color = 0xff000000 | (rgb & 0xffffff);
+  }
+
+  appendVertices(num_points);
+}
 
+void PointCloud::reservePoints(uint32_t num_points)
+{
   if ( points_.size() < point_count_ + num_points )
   {
     points_.resize( point_count_ + num_points );
   }
+}
 
-  Point* begin = &points_.front() + point_count_;
-  memcpy( begin, points, sizeof( Point ) * num_points );
+void PointCloud::appendVertices(uint32_t num_points)
+{
+  bool abgr = isColorFormatABGR();
 
   uint32_t vpp = getVerticesPerPoint();
   Ogre::RenderOperation::OperationType op_type;
@@ -482,8 +577,8 @@ void PointCloud::addPoints(Point* points, uint32_t num_points)
   Ogre::AxisAlignedBox aabb;
   aabb.setNull();
   uint32_t current_vertex_count = 0;
-  bounding_radius_ = 0.0f;
   uint32_t vertex_size = 0;
+  const Point* new_points = &points_[point_count_];
   for (uint32_t current_point = 0; current_point < num_points; ++current_point)
   {
     while (current_vertex_count >= VERTEX_BUFFER_CAPACITY || !rend)
@@ -510,10 +605,15 @@ void PointCloud::addPoints(Point* points, uint32_t num_points)
       uint32_t data_pos = current_vertex_count * vertex_size;
       fptr = (float*)((uint8_t*)vdata + data_pos);
 
-      aabb.setNull();
+      // Keep the bounds of any points already living in this renderable
+      aabb = rend->getBoundingBox();
+      if (op->vertexData->vertexCount == 0)
+      {
+        aabb.setNull();
+      }
     }
 
-    const Point& p = points[current_point];
+    const Point& p = new_points[current_point];
     float x = p.x;
     float y = p.y;
     float z = p.z;
@@ -521,20 +621,17 @@ void PointCloud::addPoints(Point* points, uint32_t num_points)
 
     if (color_by_index_)
     {
-      // convert to ColourValue, so we can then convert to the rendersystem-specific color type
-      color = (current_point + point_count_ + 1);
-      Ogre::ColourValue c;
-      c.a = 1.0f;
-      c.r = ((color >> 16) & 0xff) / 255.0f;
-      c.g = ((color >> 8) & 0xff) / 255.0f;
-      c.b = (color & 0xff) / 255.0f;
-      root->convertColourValue(c, &color);
+      // The index is already 8-bit r/g/b, so it only needs swizzling into the rendersystem-specific color type
+      color = ((pick_index_offset_ + current_point + point_count_ + 1) >> pick_index_shift_) & 0xffffff;
+      if (abgr)
+      {
+        color = ((color & 0xff) << 16) | (color & 0xff00) | ((color >> 16) & 0xff);
+      }
+      color |= 0xff000000;
     }
 
     Ogre::Vector3 pos(x, y, z);
     aabb.merge(pos);
-    bounding_box_.merge( pos );
-    bounding_radius_ = std::max( bounding_radius_, pos.squaredLength() );
 
     for (uint32_t j = 0; j < vpp; ++j, ++current_vertex_count)
     {
@@ -566,6 +663,7 @@ void PointCloud::addPoints(Point* points, uint32_t num_points)
   point_count_ += num_points;
 
   shrinkRenderables();
+  mergeRenderableBounds();
 
   if (getParentSceneNode())
   {
@@ -573,54 +671,149 @@ void PointCloud::addPoints(Point* points, uint32_t num_points)
   }
 }
 
-void PointCloud::popPoints(uint32_t num_points)
+void PointCloud::setColors(uint32_t first, const uint32_t* colors, uint32_t num_points)
 {
+  ROS_ASSERT(first + num_points <= point_count_);
+  if (num_points == 0)
+  {
+    return;
+  }
+
+  // Keep the points up to date so regenerateAll() picks the new colors up
+  for (uint32_t i = 0; i < num_points; ++i)
+  {
+    points_[first + i].color = colors[i];
+  }
+
+  if (color_by_index_)
+  {
+    // The vertex colors currently hold pick indices; they get rebuilt from the points afterwards
+    return;
+  }
+
   uint32_t vpp = getVerticesPerPoint();
+  uint32_t skip_vertices = first * vpp;
+  uint32_t color_index = 0;
+  V_PointCloudRenderable::iterator it = renderables_.begin();
+  V_PointCloudRenderable::iterator end = renderables_.end();
+  for (; it != end && color_index < num_points; ++it)
+  {
+    Ogre::RenderOperation* op = (*it)->getRenderOperation();
+    uint32_t vertex_count = op->vertexData->vertexCount;
+    if (skip_vertices >= vertex_count)
+    {
+      skip_vertices -= vertex_count;
+      continue;
+    }
 
-  ROS_ASSERT(num_points <= point_count_);
-  points_.erase(points_.begin(), points_.begin() + num_points);
+    uint32_t start_vertex = op->vertexData->vertexStart + skip_vertices;
+    uint32_t count = std::min((vertex_count - skip_vertices) / vpp, num_points - color_index);
+    skip_vertices = 0;
 
-  point_count_ -= num_points;
+    // The color is the last element of each vertex.  HBL_NORMAL preserves the positions we don't touch.
+    uint32_t vertex_size = op->vertexData->vertexDeclaration->getVertexSize(0);
+    Ogre::HardwareVertexBufferSharedPtr vbuf = (*it)->getBuffer();
+    uint8_t* vdata = (uint8_t*)vbuf->lock(start_vertex * vertex_size, count * vpp * vertex_size, Ogre::HardwareBuffer::HBL_NORMAL);
+    uint8_t* cptr = vdata + vertex_size - sizeof(uint32_t);
+    for (uint32_t i = 0; i < count; ++i, ++color_index)
+    {
+      uint32_t color = colors[color_index];
+      for (uint32_t j = 0; j < vpp; ++j, cptr += vertex_size)
+      {
+        *(uint32_t*)cptr = color;
+      }
+    }
+    vbuf->unlock();
+  }
+}
 
-  // Now clear out popped points
-  uint32_t popped_count = 0;
-  while (popped_count < num_points * vpp)
+bool PointCloud::intersectRay(const Ogre::Ray& ray, float pixel_angle, uint32_t& index, float& distance) const
+{
+  if (point_count_ == 0 || !mParentNode)
   {
-    PointCloudRenderablePtr rend = renderables_.front();
-    Ogre::RenderOperation* op = rend->getRenderOperation();
+    return false;
+  }
 
-    uint32_t popped = std::min((size_t)(num_points * vpp - popped_count), op->vertexData->vertexCount);
-    op->vertexData->vertexStart += popped;
-    op->vertexData->vertexCount -= popped;
+  // Test in the cloud's own frame.  Its scene node is rigid, so distances along the ray are unchanged.
+  Ogre::Matrix4 inverse = _getParentNodeFullTransform().inverseAffine();
+  Ogre::Matrix3 rotation;
+  inverse.extract3x3Matrix(rotation);
+  Ogre::Ray local_ray(inverse * ray.getOrigin(), rotation * ray.getDirection());
+  const Ogre::Vector3& origin = local_ray.getOrigin();
+  const Ogre::Vector3& direction = local_ray.getDirection();
 
-    popped_count += popped;
+  float radius = 0.5f * std::max(width_, std::max(height_, depth_));
+  float radius_per_meter = 0.0f;
+  if (render_mode_ == RM_POINTS)
+  {
+    radius = 0.0f;
+    radius_per_meter = 0.5f * width_ * pixel_angle;
+  }
 
-    if (op->vertexData->vertexCount == 0)
+  bool hit = false;
+  const uint32_t vpp = getVerticesPerPoint();
+  uint32_t first = 0;
+  V_PointCloudRenderable::const_iterator it = renderables_.begin();
+  V_PointCloudRenderable::const_iterator end = renderables_.end();
+  for (; it != end; ++it)
+  {
+    uint32_t count = (*it)->getRenderOperation()->vertexData->vertexCount / vpp;
+    if (count == 0)
     {
-      renderables_.erase(renderables_.begin(), renderables_.begin() + 1);
+      continue;
+    }
 
-      op->vertexData->vertexStart = 0;
-      renderables_.push_back(rend);
+    // Grow the renderable's box by the largest point radius it can have along the ray
+    const Ogre::AxisAlignedBox& box = (*it)->getBoundingBox();
+    float far_distance = (box.getCenter() - origin).length() + box.getHalfSize().length();
+    float pad = radius + radius_per_meter * far_distance;
+    Ogre::AxisAlignedBox padded(box.getMinimum() - pad, box.getMaximum() + pad);
+    if (Ogre::Math::intersects(local_ray, padded).first)
+    {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        const Point& p = points_[first + i];
+
+        Ogre::Vector3 to_point(p.x - origin.x, p.y - origin.y, p.z - origin.z);
+        float t = to_point.dotProduct(direction);
+        if (t <= 0.0f || (hit && t >= distance))
+        {
+          continue;
+        }
+
+        float r = radius + radius_per_meter * t;
+        if (to_point.squaredLength() - t * t <= r * r)
+        {
+          hit = true;
+          distance = t;
+          index = first + i;
+        }
+      }
     }
+
+    first += count;
   }
-  ROS_ASSERT(popped_count == num_points * vpp);
 
-  // reset bounds
+  return hit;
+}
+
+void PointCloud::mergeRenderableBounds()
+{
   bounding_box_.setNull();
-  bounding_radius_ = 0.0f;
-  for (uint32_t i = 0; i < point_count_; ++i)
+  V_PointCloudRenderable::iterator it = renderables_.begin();
+  V_PointCloudRenderable::iterator end = renderables_.end();
+  for (; it != end; ++it)
   {
-    Point& p = points_[i];
-    Ogre::Vector3 pos(p.x, p.y, p.z);
-    bounding_box_.merge(pos);
-    bounding_radius_ = std::max(bounding_radius_, pos.squaredLength());
+    if ((*it)->getRenderOperation()->vertexData->vertexCount > 0)
+    {
+      bounding_box_.merge((*it)->getBoundingBox());
+    }
   }
 
-  shrinkRenderables();
-
-  if (getParentSceneNode())
+  bounding_radius_ = 0.0f;
+  if (!bounding_box_.isNull())
   {
-    getParentSceneNode()->needUpdate();
+    bounding_radius_ = farthestCornerDistance(bounding_box_);
   }
 }
 
@@ -652,7 +845,11 @@ void PointCloud::_updateRenderQueue(Ogre::RenderQueue* queue)
   V_PointCloudRenderable::iterator end = renderables_.end();
   for (; it != end; ++it)
   {
-    queue->addRenderable((*it).get());
+    // Skip spare renderables that have been popped empty but not yet refilled
+    if ((*it)->getRenderOperation()->vertexData->vertexCount > 0)
+    {
+      queue->addRenderable((*it).get());
+    }
   }
 }
 
@@ -661,7 +858,7 @@ void PointCloud::_notifyAttached(Ogre::Node *parent, bool isTagPoint)
   MovableObject::_notifyAttached(parent, isTagPoint);
 }
 
-uint32_t PointCloud::getVerticesPerPoint()
+uint32_t PointCloud::getVerticesPerPoint() const
 {
   if (current_mode_supports_geometry_shader_)
   {
@@ -808,7 +1005,7 @@ void PointCloudRenderable::_notifyCurrentCamera(Ogre::Camera* camera)
 
 Ogre::Real PointCloudRenderable::getBoundingRadius(void) const
 {
-  return Ogre::Math::Sqrt(std::max(mBox.getMaximum().squaredLength(), mBox.getMinimum().squaredLength()));
+  return farthestCornerDistance(mBox);
 }
 
 Ogre::Real PointCloudRenderable::getSquaredViewDepth(const Ogre::Camera* cam) const
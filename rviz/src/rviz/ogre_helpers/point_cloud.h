@@ -55,6 +55,7 @@ class RenderQueue;
 class Camera;
 class RenderSystem;
 class Matrix4;
+class Ray;
 }
 
 namespace rviz
@@ -121,8 +122,7 @@ public:
   {
     inline void setColor(float r, float g, float b)
     {
-      Ogre::Root* root = Ogre::Root::getSingletonPtr();
-      root->convertColourValue(Ogre::ColourValue(r, g, b), &color);
+      color = packColor(r, g, b);
     }
 
     float x;
@@ -131,19 +131,71 @@ public:
     uint32_t color;
   };
 
+  /**
+   * \brief Pack a color into the render system's vertex color format, as stored in Point::color
+   *
+   * Same result as Ogre::Root::convertColourValue(), but the format is only looked up once and
+   * components are clamped to [0, 1].
+   */
+  static inline uint32_t packColor(float r, float g, float b, float a = 1.0f)
+  {
+    uint32_t r8 = toByte(r);
+    uint32_t g8 = toByte(g);
+    uint32_t b8 = toByte(b);
+    uint32_t a8 = toByte(a);
+    if (isColorFormatABGR())
+    {
+      return (a8 << 24) | (b8 << 16) | (g8 << 8) | r8;
+    }
+    return (a8 << 24) | (r8 << 16) | (g8 << 8) | b8;
+  }
+
+  /**
+   * \brief Returns true if the render system wants vertex colors as ABGR, false for ARGB
+   */
+  static inline bool isColorFormatABGR()
+  {
+    if (color_format_ == COLOR_FORMAT_UNKNOWN)
+    {
+      resolveColorFormat();
+    }
+    return color_format_ == COLOR_FORMAT_ABGR;
+  }
+
   /**
    * \brief Add points to this point cloud
    *
    * @param points An array of Point structures
    * @param num_points The number of points in the array
    */
-  void addPoints( Point* points, uint32_t num_points );
+  void addPoints( const Point* points, uint32_t num_points );
+
+  /**
+   * \brief Add points read straight out of an interleaved buffer, such as the data of a sensor_msgs::PointCloud2,
+   * without going through an intermediate array of Point structures.
+   *
+   * @param data Pointer to the first point
+   * @param point_step Distance in bytes between consecutive points
+   * @param xyz_offset Offset within a point of three consecutive float32 x/y/z values
+   * @param rgb_offset Offset within a point of a packed 0x00RRGGBB uint32 color
+   * @param num_points The number of points to read
+   * @param transform Affine transform applied to each position.  Points with non-finite positions are moved out of the way.
+   *
+   * The converted points still land in #points_ before being written to the vertex buffers, on purpose:
+   * regenerateAll() and intersectRay() need them there, and the vertex buffers are write-only.
+   */
+  void addPoints( const uint8_t* data, uint32_t point_step, uint32_t xyz_offset, uint32_t rgb_offset,
+                  uint32_t num_points, const Ogre::Matrix4& transform );
 
   /**
-   * \brief Remove a number of points from this point cloud
-   * \param num_points The number of points to pop
+   * \brief Change the colors of points already in this point cloud, leaving their positions alone
+   *
+   * Only the color bytes of the affected vertices are rewritten, so this is much cheaper than clear() and addPoints().
+   * @param first Index of the first point to change, counting from the oldest point in the cloud
+   * @param colors Colors in the same format as Point::color
+   * @param num_points The number of colors in the array
    */
-  void popPoints( uint32_t num_points );
+  void setColors( uint32_t first, const uint32_t* colors, uint32_t num_points );
 
   /**
    * \brief Set what type of rendering primitives should be used, currently points, billboards and boxes are supported
@@ -165,10 +217,28 @@ public:
   void setAlpha( float alpha );
 
   void setPickColor(const Ogre::ColourValue& color);
-  void setColorByIndex(bool set);
+  /**
+   * \brief Color each point by its index, for the selection pick pass
+   * @param index_offset Added to the point indices, so several clouds can share one range of pick indices
+   * @param index_shift Right shift applied to the indices before they are cut to the 24 bits a color can hold,
+   *        so indices past 2^24 can be rendered over several pick passes
+   */
+  void setColorByIndex(bool set, uint32_t index_offset = 0, uint32_t index_shift = 0);
 
   void setHighlightColor( float r, float g, float b );
 
+  /**
+   * \brief Find the point nearest the origin of a ray among the points it passes through, for picking on the CPU
+   *
+   * Points count as spheres of half the point width, or of half the point size in pixels for RM_POINTS.
+   * Only the points of renderables whose bounds the ray crosses are tested.
+   * @param ray World-space ray, with a unit direction
+   * @param pixel_angle Angle subtended by one pixel, used for RM_POINTS
+   * @param index Set to the index of the point hit, counting from the oldest point in the cloud
+   * @param distance Set to the distance along the ray to the point hit
+   */
+  bool intersectRay( const Ogre::Ray& ray, float pixel_angle, uint32_t& index, float& distance ) const;
+
   virtual const Ogre::String& getMovableType() const { return sm_Type; }
   virtual const Ogre::AxisAlignedBox& getBoundingBox() const;
   virtual float getBoundingRadius() const;
@@ -182,16 +252,47 @@ public:
 
 private:
 
-  uint32_t getVerticesPerPoint();
+  typedef std::vector<Point> V_Point;
+
+  enum ColorFormat
+  {
+    COLOR_FORMAT_UNKNOWN,
+    COLOR_FORMAT_ARGB,
+    COLOR_FORMAT_ABGR
+  };
+  static ColorFormat color_format_;     ///< Vertex color format of the render system, see isColorFormatABGR()
+  static void resolveColorFormat();
+
+  static inline uint32_t toByte(float v)
+  {
+    v = v > 0.0f ? v : 0.0f;
+    v = v < 1.0f ? v : 1.0f;
+    return (uint32_t)(v * 255.0f);
+  }
+
+  uint32_t getVerticesPerPoint() const;
   PointCloudRenderablePtr getOrCreateRenderable();
   void regenerateAll();
   void shrinkRenderables();
+  /**
+   * \brief Make room in #points_ for num_points more points after the #point_count_ already there
+   */
+  void reservePoints( uint32_t num_points );
+  /**
+   * \brief Write the num_points points just placed after the end of #points_ into the vertex buffers,
+   * and count them as part of the cloud.
+   */
+  void appendVertices( uint32_t num_points );
+  /**
+   * \brief Rebuild #bounding_box_ and #bounding_radius_ by merging the bounding boxes of the renderables.
+   * This is O(renderables) rather than O(points).
+   */
+  void mergeRenderableBounds();
 
   Ogre::AxisAlignedBox bounding_box_;       ///< The bounding box of this point cloud
   float bounding_radius_;                   ///< The bounding radius of this point cloud
 
-  typedef std::vector<Point> V_Point;
-  V_Point points_;                          ///< The list of points we're displaying.  Allocates to a high-water-mark.
+  V_Point points_;                          ///< The points we're displaying.  Allocates to a high-water-mark.
   uint32_t point_count_;                    ///< The number of points currently in #points_
 
   RenderMode render_mode_;
@@ -210,6 +311,8 @@ private:
   float alpha_;
 
   bool color_by_index_;
+  uint32_t pick_index_offset_;
+  uint32_t pick_index_shift_;
 
   V_PointCloudRenderable renderables_;
 
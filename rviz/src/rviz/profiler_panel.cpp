@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "rviz/frame_profiler.h"
+#include "rviz/visualization_manager.h"
+
+#include "rviz/profiler_panel.h"
+
+namespace rviz
+{
+
+/** Number of most recent frames summarized in the table. */
+static const uint32_t SUMMARY_FRAMES = 100;
+
+/** Running totals for one name. */
+struct ProfileSummary
+{
+  ProfileSummary()
+  : calls( 0 )
+  , total( 0.0 )
+  , max( 0.0 )
+  {}
+
+  int calls;
+  double total;   ///< Seconds
+  double max;     ///< Seconds
+};
+
+/** Convert seconds to milliseconds, rounded to microseconds for display. */
+static double toMsec( double seconds )
+{
+  return qRound( seconds * 1e6 ) / 1000.0;
+}
+
+ProfilerPanel::ProfilerPanel( QWidget* parent )
+  : QWidget( parent )
+  , profiler_( NULL )
+{
+  record_checkbox_ = new QCheckBox( "Record" );
+  QPushButton* clear_button = new QPushButton( "Clear" );
+  QPushButton* export_button = new QPushButton( "Export Chrome Trace..." );
+
+  table_ = new QTreeWidget;
+  table_->setRootIsDecorated( false );
+  table_->setAlternatingRowColors( true );
+  table_->setHeaderLabels( QStringList() << "Name" << "ms / Frame" << "Average ms" << "Max ms" << "Calls" );
+  table_->setSortingEnabled( true );
+  table_->sortByColumn( 1, Qt::DescendingOrder );
+  table_->header()->setResizeMode( 0, QHeaderView::Stretch );
+  table_->header()->setStretchLastSection( false );
+
+  QHBoxLayout* button_layout = new QHBoxLayout;
+  button_layout->addWidget( record_checkbox_ );
+  button_layout->addStretch( 1000 );
+  button_layout->addWidget( clear_button );
+  button_layout->addWidget( export_button );
+
+  QVBoxLayout* layout = new QVBoxLayout;
+  layout->addLayout( button_layout );
+  layout->addWidget( table_ );
+  layout->setContentsMargins( 11, 5, 11, 5 );
+  setLayout( layout );
+
+  update_timer_ = new QTimer( this );
+  update_timer_->setInterval( 1000 );
+
+  connect( record_checkbox_, SIGNAL( toggled( bool )), this, SLOT( onRecordToggled( bool )));
+  connect( clear_button, SIGNAL( clicked( bool )), this, SLOT( clear() ));
+  connect( export_button, SIGNAL( clicked( bool )), this, SLOT( exportTrace() ));
+  connect( update_timer_, SIGNAL( timeout() ), this, SLOT( updateTable() ));
+}
+
+void ProfilerPanel::initialize( VisualizationManager* manager )
+{
+  profiler_ = manager->getFrameProfiler();
+  record_checkbox_->setChecked( profiler_->isEnabled() );
+}
+
+void ProfilerPanel::onRecordToggled( bool record )
+{
+  if( !profiler_ )
+  {
+    return;
+  }
+
+  profiler_->setEnabled( record );
+  if( record )
+  {
+    update_timer_->start();
+  }
+  else
+  {
+    update_timer_->stop();
+    updateTable();
+  }
+}
+
+void ProfilerPanel::clear()
+{
+  if( profiler_ )
+  {
+    profiler_->clear();
+    updateTable();
+  }
+}
+
+void ProfilerPanel::exportTrace()
+{
+  if( !profiler_ )
+  {
+    return;
+  }
+
+  QString filename = QFileDialog::getSaveFileName( this, "Export Chrome Trace", "rviz_trace.json",
+                                                   "Chrome trace (*.json)" );
+  if( filename.isEmpty() )
+  {
+    return;
+  }
+
+  if( !profiler_->writeChromeTrace( filename.toStdString() ))
+  {
+    QMessageBox::critical( this, "Failed to export trace", "Could not write to " + filename );
+  }
+}
+
+void ProfilerPanel::updateTable()
+{
+  if( !profiler_ || !isVisible() )
+  {
+    return;
+  }
+
+  std::vector<FrameProfiler::Event> events;
+  profiler_->getEvents( events );
+
+  // Only look at the last few frames, and only frames which are
+  // complete.  Worker thread events count in the frame they finished.
+  uint32_t last_frame = profiler_->getFrame();
+  uint32_t first_frame = last_frame > SUMMARY_FRAMES ? last_frame - SUMMARY_FRAMES : 1;
+  uint32_t oldest_frame = last_frame;
+
+  std::map<uint32_t, ProfileSummary> summaries;
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    const FrameProfiler::Event& event = events[ i ];
+    if( event.frame < first_frame || event.frame >= last_frame )
+    {
+      continue;
+    }
+    oldest_frame = std::min( oldest_frame, event.frame );
+
+    ProfileSummary& summary = summaries[ event.name ];
+    double duration = event.duration.toSec();
+    summary.calls++;
+    summary.total += duration;
+    summary.max = std::max( summary.max, duration );
+  }
+  int num_frames = std::max( 1, (int) (last_frame - oldest_frame) );
+
+  table_->setSortingEnabled( false );
+  table_->clear();
+  std::map<uint32_t, ProfileSummary>::const_iterator it;
+  for( it = summaries.begin(); it != summaries.end(); ++it )
+  {
+    const ProfileSummary& summary = it->second;
+    QTreeWidgetItem* item = new QTreeWidgetItem( table_ );
+    item->setText( 0, QString::fromStdString( profiler_->getName( it->first )));
+    // Numbers as data instead of text, so they sort by value.
+    item->setData( 1, Qt::DisplayRole, toMsec( summary.total / num_frames ));
+    item->setData( 2, Qt::DisplayRole, toMsec( summary.total / summary.calls ));
+    item->setData( 3, Qt::DisplayRole, toMsec( summary.max ));
+    item->setData( 4, Qt::DisplayRole, summary.calls );
+  }
+  table_->setSortingEnabled( true );
+}
+
+} // namespace rviz
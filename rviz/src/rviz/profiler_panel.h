@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_PROFILER_PANEL_H
+#define RVIZ_PROFILER_PANEL_H
+
+#include <QWidget>
+
+class QCheckBox;
+class QTimer;
+class QTreeWidget;
+
+namespace rviz
+{
+
+class FrameProfiler;
+class VisualizationManager;
+
+/**
+ * \class ProfilerPanel
+ * @brief Shows how long each part of recent frames took, from the FrameProfiler.
+ */
+class ProfilerPanel: public QWidget
+{
+Q_OBJECT
+public:
+  ProfilerPanel( QWidget* parent = 0 );
+
+  void initialize( VisualizationManager* manager );
+
+protected Q_SLOTS:
+  /** Start or stop recording, following the checkbox. */
+  void onRecordToggled( bool record );
+
+  /** Throw away recorded events. */
+  void clear();
+
+  /** Ask for a file name and write the recorded events to it as a Chrome trace. */
+  void exportTrace();
+
+  /** Summarize the recorded events in the table. */
+  void updateTable();
+
+protected:
+  FrameProfiler* profiler_;
+
+  QCheckBox* record_checkbox_;
+  QTreeWidget* table_;
+  QTimer* update_timer_;
+};
+
+} // namespace rviz
+
+#endif // RVIZ_PROFILER_PANEL_H
@@ -129,6 +129,15 @@ void RenderPanel::onRenderWindowMouseEvents( QMouseEvent* event )
   }
 }
 
+void RenderPanel::paintEvent( QPaintEvent* event )
+{
+  if( context_ )
+  {
+    context_->queueRender();
+  }
+  QtOgreRenderWindow::paintEvent( event );
+}
+
 void RenderPanel::wheelEvent( QWheelEvent* event )
 {
   int last_x = mouse_x_;
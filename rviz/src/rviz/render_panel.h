@@ -111,6 +111,9 @@ protected:
 
   virtual void keyPressEvent( QKeyEvent* event );
 
+  /// Rendering only happens when requested, so ask for a frame when the window is exposed or resized.
+  virtual void paintEvent( QPaintEvent* event );
+
   // Mouse handling
   int mouse_x_;                                           ///< X position of the last mouse event
   int mouse_y_;                                           ///< Y position of the last mouse event
@@ -31,6 +31,7 @@
 #define RVIZ_ROBOT_LINK_UPDATER_H
 
 #include <string>
+#include <vector>
 #include "rviz/properties/status_property.h"
 
 namespace Ogre
@@ -45,6 +46,12 @@ namespace rviz
 class LinkUpdater
 {
 public:
+  /** @brief Called by Robot::update() with the names of all its links before calling getLinkTransforms() for each.
+   *
+   * Updaters which can look up many transforms at once more cheaply
+   * than one at a time can do so here.  The default does nothing. */
+  virtual void prepareLinkTransforms(const std::vector<std::string>& link_names) const {}
+
   virtual bool getLinkTransforms(const std::string& link_name, Ogre::Vector3& visual_position, Ogre::Quaternion& visual_orientation,
                                  Ogre::Vector3& collision_position, Ogre::Quaternion& collision_orientation, bool& apply_offset_transforms) const = 0;
 
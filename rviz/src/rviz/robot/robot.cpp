@@ -215,6 +215,15 @@ RobotLink* Robot::getLink( const std::string& name )
 
 void Robot::update(const LinkUpdater& updater)
 {
+  std::vector<std::string> link_names;
+  link_names.reserve( links_.size() );
+  M_NameToLink::iterator name_it = links_.begin();
+  for ( ; name_it != links_.end(); ++name_it )
+  {
+    link_names.push_back( name_it->first );
+  }
+  updater.prepareLinkTransforms( link_names );
+
   M_NameToLink::iterator link_it = links_.begin();
   M_NameToLink::iterator link_end = links_.end();
   for ( ; link_it != link_end; ++link_it )
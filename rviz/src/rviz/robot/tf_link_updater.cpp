@@ -45,6 +45,26 @@ TFLinkUpdater::TFLinkUpdater(FrameManager* frame_manager, const StatusCallback&
 {
 }
 
+void TFLinkUpdater::prepareLinkTransforms(const std::vector<std::string>& link_names) const
+{
+  std::vector<std::string> names(link_names.size());
+  std::vector<FrameManager::FrameId> frames(link_names.size());
+  for (size_t i = 0; i < link_names.size(); ++i)
+  {
+    names[i] = tf_prefix_.empty() ? link_names[i] : tf::resolve(tf_prefix_, link_names[i]);
+    frames[i] = frame_manager_->internFrame(names[i]);
+  }
+
+  FrameManager::V_FramePose poses;
+  frame_manager_->getTransforms(frames, ros::Time(), poses);
+
+  prepared_poses_.clear();
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    prepared_poses_[names[i]] = poses[i];
+  }
+}
+
 bool TFLinkUpdater::getLinkTransforms(const std::string& _link_name, Ogre::Vector3& visual_position, Ogre::Quaternion& visual_orientation,
                                       Ogre::Vector3& collision_position, Ogre::Quaternion& collision_orientation, bool& apply_offset_transforms) const
 {
@@ -56,7 +76,20 @@ bool TFLinkUpdater::getLinkTransforms(const std::string& _link_name, Ogre::Vecto
 
   Ogre::Vector3 position;
   Ogre::Quaternion orientation;
-  if (!frame_manager_->getTransform(link_name, ros::Time(), position, orientation))
+  bool ok;
+  M_FramePose::const_iterator it = prepared_poses_.find(link_name);
+  if (it != prepared_poses_.end())
+  {
+    position = it->second.position;
+    orientation = it->second.orientation;
+    ok = it->second.valid;
+  }
+  else
+  {
+    ok = frame_manager_->getTransform(link_name, ros::Time(), position, orientation);
+  }
+
+  if (!ok)
   {
     std::stringstream ss;
     ss << "No transform from [" << link_name << "] to [" << frame_manager_->getFixedFrame() << "]";
@@ -31,7 +31,9 @@
 #define RVIZ_ROBOT_TF_LINK_UPDATER_H
 
 #include "link_updater.h"
+#include "frame_manager.h"
 
+#include <map>
 #include <string>
 #include <boost/function.hpp>
 
@@ -43,14 +45,16 @@ class Transformer;
 namespace rviz
 {
 
-class FrameManager;
-
 class TFLinkUpdater : public LinkUpdater
 {
 public:
   typedef boost::function<void(StatusLevel, const std::string&, const std::string&)> StatusCallback;
 
   TFLinkUpdater(FrameManager* frame_manager, const StatusCallback& status_cb = StatusCallback(), const std::string& tf_prefix = std::string());
+
+  /** @brief Look up the transforms of all links with one FrameManager::getTransforms() call. */
+  virtual void prepareLinkTransforms(const std::vector<std::string>& link_names) const;
+
   virtual bool getLinkTransforms(const std::string& link_name, Ogre::Vector3& visual_position, Ogre::Quaternion& visual_orientation,
                                  Ogre::Vector3& collision_position, Ogre::Quaternion& collision_orientation, bool& apply_offset_transforms) const;
 
@@ -60,6 +64,10 @@ private:
   FrameManager* frame_manager_;
   StatusCallback status_callback_;
   std::string tf_prefix_;
+
+  /** @brief Poses from prepareLinkTransforms(), by resolved link name. */
+  typedef std::map<std::string, FrameManager::FramePose> M_FramePose;
+  mutable M_FramePose prepared_poses_;
 };
 
 } // namespace rviz
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <OGRE/OgreMath.h>
+
+#include <ros/assert.h>
+
+#include "rviz/selection/selection_bvh.h"
+
+namespace rviz
+{
+
+static float surfaceArea( const Ogre::AxisAlignedBox& box )
+{
+  Ogre::Vector3 size = box.getSize();
+  return 2.0f * ( size.x * size.y + size.y * size.z + size.z * size.x );
+}
+
+static Ogre::AxisAlignedBox merged( const Ogre::AxisAlignedBox& a, const Ogre::AxisAlignedBox& b )
+{
+  Ogre::AxisAlignedBox box = a;
+  box.merge( b );
+  return box;
+}
+
+SelectionBVH::SelectionBVH()
+: root_( -1 )
+, free_list_( -1 )
+{
+}
+
+void SelectionBVH::clear()
+{
+  nodes_.clear();
+  root_ = -1;
+  free_list_ = -1;
+}
+
+int SelectionBVH::allocateNode()
+{
+  if( free_list_ == -1 )
+  {
+    nodes_.push_back( Node() );
+    free_list_ = nodes_.size() - 1;
+    nodes_.back().parent = -1;
+  }
+
+  int node = free_list_;
+  free_list_ = nodes_[ node ].parent;
+  nodes_[ node ].parent = -1;
+  nodes_[ node ].left = -1;
+  nodes_[ node ].right = -1;
+  nodes_[ node ].handle = 0;
+  return node;
+}
+
+void SelectionBVH::freeNode( int node )
+{
+  nodes_[ node ].parent = free_list_;
+  nodes_[ node ].left = -1;
+  free_list_ = node;
+}
+
+int SelectionBVH::insert( const Ogre::AxisAlignedBox& box, CollObjectHandle handle )
+{
+  ROS_ASSERT( box.isFinite() );
+
+  int leaf = allocateNode();
+  Node& node = nodes_[ leaf ];
+  node.handle = handle;
+
+  // Pad the box so objects can move a little without the tree changing
+  Ogre::Vector3 pad = box.getSize() * 0.1f + Ogre::Vector3( 0.01f, 0.01f, 0.01f );
+  node.box.setExtents( box.getMinimum() - pad, box.getMaximum() + pad );
+
+  insertLeaf( leaf );
+  return leaf;
+}
+
+void SelectionBVH::remove( int leaf )
+{
+  removeLeaf( leaf );
+  freeNode( leaf );
+}
+
+void SelectionBVH::move( int leaf, const Ogre::AxisAlignedBox& box )
+{
+  if( nodes_[ leaf ].box.contains( box ))
+  {
+    return;
+  }
+
+  CollObjectHandle handle = nodes_[ leaf ].handle;
+  removeLeaf( leaf );
+
+  Ogre::Vector3 pad = box.getSize() * 0.1f + Ogre::Vector3( 0.01f, 0.01f, 0.01f );
+  nodes_[ leaf ].box.setExtents( box.getMinimum() - pad, box.getMaximum() + pad );
+  nodes_[ leaf ].handle = handle;
+  insertLeaf( leaf );
+}
+
+void SelectionBVH::insertLeaf( int leaf )
+{
+  nodes_[ leaf ].left = -1;
+  nodes_[ leaf ].right = -1;
+
+  if( root_ == -1 )
+  {
+    root_ = leaf;
+    nodes_[ leaf ].parent = -1;
+    return;
+  }
+
+  // Walk down to the sibling that grows the tree's surface area the least
+  const Ogre::AxisAlignedBox box = nodes_[ leaf ].box;
+  int index = root_;
+  while( nodes_[ index ].left != -1 )
+  {
+    const Node& node = nodes_[ index ];
+    float area = surfaceArea( node.box );
+    float combined_area = surfaceArea( merged( node.box, box ));
+
+    // Cost of making a new parent for this node and the leaf, and the cost pushed down to the children
+    float cost = 2.0f * combined_area;
+    float inherited = 2.0f * ( combined_area - area );
+
+    float child_cost[2];
+    int children[2] = { node.left, node.right };
+    for( int i = 0; i < 2; ++i )
+    {
+      const Node& child = nodes_[ children[ i ]];
+      float child_area = surfaceArea( merged( child.box, box ));
+      if( child.left != -1 )
+      {
+        child_area -= surfaceArea( child.box );
+      }
+      child_cost[ i ] = child_area + inherited;
+    }
+
+    if( cost < child_cost[0] && cost < child_cost[1] )
+    {
+      break;
+    }
+    index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+  }
+
+  int sibling = index;
+  int old_parent = nodes_[ sibling ].parent;
+  int new_parent = allocateNode(); // may reallocate nodes_, so no references are held across this
+
+  nodes_[ new_parent ].parent = old_parent;
+  nodes_[ new_parent ].left = sibling;
+  nodes_[ new_parent ].right = leaf;
+  nodes_[ new_parent ].box = merged( nodes_[ sibling ].box, box );
+  nodes_[ sibling ].parent = new_parent;
+  nodes_[ leaf ].parent = new_parent;
+
+  if( old_parent == -1 )
+  {
+    root_ = new_parent;
+  }
+  else if( nodes_[ old_parent ].left == sibling )
+  {
+    nodes_[ old_parent ].left = new_parent;
+  }
+  else
+  {
+    nodes_[ old_parent ].right = new_parent;
+  }
+
+  refit( old_parent );
+}
+
+void SelectionBVH::removeLeaf( int leaf )
+{
+  if( leaf == root_ )
+  {
+    root_ = -1;
+    return;
+  }
+
+  int parent = nodes_[ leaf ].parent;
+  int grand_parent = nodes_[ parent ].parent;
+  int sibling = nodes_[ parent ].left == leaf ? nodes_[ parent ].right : nodes_[ parent ].left;
+
+  if( grand_parent == -1 )
+  {
+    root_ = sibling;
+    nodes_[ sibling ].parent = -1;
+  }
+  else
+  {
+    if( nodes_[ grand_parent ].left == parent )
+    {
+      nodes_[ grand_parent ].left = sibling;
+    }
+    else
+    {
+      nodes_[ grand_parent ].right = sibling;
+    }
+    nodes_[ sibling ].parent = grand_parent;
+    refit( grand_parent );
+  }
+  freeNode( parent );
+}
+
+void SelectionBVH::refit( int node )
+{
+  while( node != -1 )
+  {
+    Node& n = nodes_[ node ];
+    n.box = merged( nodes_[ n.left ].box, nodes_[ n.right ].box );
+    node = n.parent;
+  }
+}
+
+void SelectionBVH::intersect( const Ogre::Ray& ray, std::vector<std::pair<float, CollObjectHandle> >& hits ) const
+{
+  if( root_ == -1 )
+  {
+    return;
+  }
+
+  std::vector<int> stack;
+  stack.push_back( root_ );
+  while( !stack.empty() )
+  {
+    const Node& node = nodes_[ stack.back() ];
+    stack.pop_back();
+
+    std::pair<bool, Ogre::Real> hit = Ogre::Math::intersects( ray, node.box );
+    if( !hit.first )
+    {
+      continue;
+    }
+
+    if( node.left == -1 )
+    {
+      hits.push_back( std::make_pair( (float) hit.second, node.handle ));
+    }
+    else
+    {
+      stack.push_back( node.left );
+      stack.push_back( node.right );
+    }
+  }
+}
+
+} // namespace rviz
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_SELECTION_BVH_H
+#define RVIZ_SELECTION_BVH_H
+
+#include <vector>
+
+#include <OGRE/OgreAxisAlignedBox.h>
+#include <OGRE/OgreRay.h>
+
+#include "rviz/selection/forwards.h"
+
+namespace rviz
+{
+
+/**
+ * \class SelectionBVH
+ * \brief Dynamic bounding volume hierarchy over the world-space bounds of selectable objects.
+ *
+ * Leaves are inserted, moved and removed one at a time, so the tree follows objects as displays
+ * create, move and destroy them without being rebuilt.  Leaf boxes are padded a little, so small
+ * motions don't change the tree at all.  Used by SelectionManager to answer ray picks on the CPU.
+ */
+class SelectionBVH
+{
+public:
+  SelectionBVH();
+
+  /** @brief Add a leaf for @a handle and return its id.  @a box must be finite. */
+  int insert( const Ogre::AxisAlignedBox& box, CollObjectHandle handle );
+
+  /** @brief Remove a leaf returned by insert(). */
+  void remove( int leaf );
+
+  /** @brief Update the box of a leaf.  Only touches the tree if the box left the leaf's padded box. */
+  void move( int leaf, const Ogre::AxisAlignedBox& box );
+
+  /** @brief Append the handles of all leaves whose boxes the ray hits, with the distance along the ray
+   * at which it enters each box. */
+  void intersect( const Ogre::Ray& ray, std::vector<std::pair<float, CollObjectHandle> >& hits ) const;
+
+  void clear();
+
+  bool empty() const { return root_ == -1; }
+
+private:
+  struct Node
+  {
+    Ogre::AxisAlignedBox box;
+    int parent;
+    int left;   ///< -1 for leaves
+    int right;
+    CollObjectHandle handle;
+  };
+
+  int allocateNode();
+  void freeNode( int node );
+  void insertLeaf( int leaf );
+  void removeLeaf( int leaf );
+
+  /** @brief Recompute the boxes of @a node and its ancestors from their children. */
+  void refit( int node );
+
+  std::vector<Node> nodes_;
+  int root_;
+  int free_list_;     ///< Unused nodes, chained through Node::parent
+};
+
+} // namespace rviz
+
+#endif // RVIZ_SELECTION_BVH_H
@@ -31,6 +31,8 @@
 
 #include "properties/property.h"
 #include "visualization_manager.h"
+#include "ogre_helpers/movable_text.h"
+#include "ogre_helpers/point_cloud.h"
 
 #include <ros/assert.h>
 
@@ -40,12 +42,16 @@
 #include <OGRE/OgreWireBoundingBox.h>
 #include <OGRE/OgreEntity.h>
 #include <OGRE/OgreSubEntity.h>
+#include <OGRE/OgreSubMesh.h>
+#include <OGRE/OgreMath.h>
+#include <OGRE/OgreRay.h>
 
 namespace rviz
 {
 
 SelectionHandler::SelectionHandler()
 : manager_(0)
+, pick_bounds_dirty_(true)
 , listener_(new Listener(this))
 {
 }
@@ -57,7 +63,11 @@ SelectionHandler::~SelectionHandler()
   for (; it != end; ++it)
   {
     Ogre::MovableObject* m = *it;
-    m->setListener(0);
+    // A newer handler may have started tracking the same object
+    if (m->getListener() == listener_.get())
+    {
+      m->setListener(0);
+    }
   }
 
   while (!boxes_.empty())
@@ -97,12 +107,17 @@ void SelectionHandler::addTrackedObject(Ogre::MovableObject* object)
 {
   tracked_objects_.insert(object);
   object->setListener(listener_.get());
+  markPickBoundsDirty();
 }
 
 void SelectionHandler::removeTrackedObject(Ogre::MovableObject* object)
 {
   tracked_objects_.erase(object);
-  object->setListener(0);
+  if (object->getListener() == listener_.get())
+  {
+    object->setListener(0);
+  }
+  markPickBoundsDirty();
 
   updateTrackedBoxes();
 }
@@ -143,6 +158,202 @@ void SelectionHandler::getAABBs(const Picked& obj, V_AABB& aabbs)
   }
 }
 
+Ogre::AxisAlignedBox SelectionHandler::getPickBounds()
+{
+  Ogre::AxisAlignedBox bounds;
+  S_Movable::iterator it = tracked_objects_.begin();
+  S_Movable::iterator end = tracked_objects_.end();
+  for (; it != end; ++it)
+  {
+    bounds.merge((*it)->getWorldBoundingBox(true));
+  }
+  return bounds;
+}
+
+/** @brief Return the position element of a triangle list submesh, or 0 if it has none. */
+static const Ogre::VertexElement* getTrianglePositions(Ogre::Mesh* mesh, Ogre::SubMesh* sub_mesh)
+{
+  if (sub_mesh->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST || sub_mesh->indexData->indexCount == 0)
+  {
+    return 0;
+  }
+  Ogre::VertexData* vertex_data = sub_mesh->useSharedVertices ? mesh->sharedVertexData : sub_mesh->vertexData;
+  return vertex_data->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+}
+
+/** @brief Return true if the triangles of an entity's mesh can be read without a GPU round trip.
+ *
+ * That is if its buffers keep a shadow copy in system memory, as those
+ * of meshes loaded by MeshManager and mesh_loader do.  Reading back
+ * write-only buffers instead would be slow, or undefined on D3D. */
+static bool hasShadowedTriangles(Ogre::Entity* entity)
+{
+  Ogre::MeshPtr mesh = entity->getMesh();
+  if (mesh.isNull())
+  {
+    return false;
+  }
+
+  for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+  {
+    Ogre::SubMesh* sub_mesh = mesh->getSubMesh(i);
+    const Ogre::VertexElement* pos_elem = getTrianglePositions(mesh.get(), sub_mesh);
+    if (!pos_elem)
+    {
+      continue;
+    }
+
+    Ogre::VertexData* vertex_data = sub_mesh->useSharedVertices ? mesh->sharedVertexData : sub_mesh->vertexData;
+    if (!vertex_data->vertexBufferBinding->getBuffer(pos_elem->getSource())->hasShadowBuffer() ||
+        !sub_mesh->indexData->indexBuffer->hasShadowBuffer())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** @brief Return true if intersectRay() can test a tracked object exactly enough to stand in for a render pick. */
+static bool isRayPickable(Ogre::MovableObject* object)
+{
+  if (Ogre::Entity* entity = dynamic_cast<Ogre::Entity*>(object))
+  {
+    return hasShadowedTriangles(entity);
+  }
+  // Text is about as big as its bounding box.  Other objects, like
+  // ManualObjects, can be far smaller than theirs and would hide what
+  // is behind them, and their geometry only lives on the GPU.
+  return dynamic_cast<PointCloud*>(object) || dynamic_cast<MovableText*>(object);
+}
+
+/** @brief Intersect a world-space ray with the triangles of an entity's mesh.
+ *
+ * Only call this if hasShadowedTriangles() is true, so the locks read the shadow buffers. */
+static bool intersectEntity(Ogre::Entity* entity, const Ogre::Ray& ray, float& distance)
+{
+  Ogre::MeshPtr mesh = entity->getMesh();
+  if (mesh.isNull())
+  {
+    return false;
+  }
+
+  // Bring the ray into mesh space instead of transforming every vertex.  The direction isn't
+  // renormalized, so distances along the ray stay in world units even for scaled entities.
+  Ogre::Matrix4 inverse = entity->_getParentNodeFullTransform().inverseAffine();
+  Ogre::Matrix3 linear;
+  inverse.extract3x3Matrix(linear);
+  Ogre::Ray local_ray(inverse * ray.getOrigin(), linear * ray.getDirection());
+
+  if (!Ogre::Math::intersects(local_ray, mesh->getBounds()).first)
+  {
+    return false;
+  }
+
+  bool hit = false;
+  for (unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+  {
+    Ogre::SubMesh* sub_mesh = mesh->getSubMesh(i);
+    const Ogre::VertexElement* pos_elem = getTrianglePositions(mesh.get(), sub_mesh);
+    if (!pos_elem)
+    {
+      continue;
+    }
+
+    Ogre::VertexData* vertex_data = sub_mesh->useSharedVertices ? mesh->sharedVertexData : sub_mesh->vertexData;
+    Ogre::IndexData* index_data = sub_mesh->indexData;
+
+    Ogre::HardwareVertexBufferSharedPtr vbuf = vertex_data->vertexBufferBinding->getBuffer(pos_elem->getSource());
+    Ogre::HardwareIndexBufferSharedPtr ibuf = index_data->indexBuffer;
+    const uint8_t* vertices = (const uint8_t*)vbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY);
+    const void* indices = ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY);
+    bool use_32bit = ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT;
+    size_t vertex_size = vbuf->getVertexSize();
+
+    for (size_t j = index_data->indexStart; j + 2 < index_data->indexStart + index_data->indexCount; j += 3)
+    {
+      Ogre::Vector3 corners[3];
+      for (int k = 0; k < 3; ++k)
+      {
+        size_t index = use_32bit ? ((const uint32_t*)indices)[j + k] : ((const uint16_t*)indices)[j + k];
+        const float* pos = (const float*)(vertices + (vertex_data->vertexStart + index) * vertex_size + pos_elem->getOffset());
+        corners[k] = Ogre::Vector3(pos[0], pos[1], pos[2]);
+      }
+
+      std::pair<bool, Ogre::Real> result = Ogre::Math::intersects(local_ray, corners[0], corners[1], corners[2], true, true);
+      if (result.first && result.second >= 0 && (!hit || result.second < distance))
+      {
+        hit = true;
+        distance = result.second;
+      }
+    }
+
+    ibuf->unlock();
+    vbuf->unlock();
+  }
+
+  return hit;
+}
+
+bool SelectionHandler::supportsRayPick()
+{
+  if (tracked_objects_.empty())
+  {
+    return false;
+  }
+
+  S_Movable::iterator it = tracked_objects_.begin();
+  S_Movable::iterator end = tracked_objects_.end();
+  for (; it != end; ++it)
+  {
+    if (!isRayPickable(*it))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SelectionHandler::intersectRay( const Ogre::Ray& ray, float pixel_angle, float& distance, uint64_t& extra_handle )
+{
+  bool hit = false;
+  S_Movable::iterator it = tracked_objects_.begin();
+  S_Movable::iterator end = tracked_objects_.end();
+  for (; it != end; ++it)
+  {
+    Ogre::MovableObject* object = *it;
+    if (!object->isVisible() || !object->isInScene())
+    {
+      continue;
+    }
+
+    float object_distance = 0.0f;
+    bool object_hit = false;
+    if (Ogre::Entity* entity = dynamic_cast<Ogre::Entity*>(object))
+    {
+      object_hit = intersectEntity(entity, ray, object_distance);
+    }
+    else if (PointCloud* cloud = dynamic_cast<PointCloud*>(object))
+    {
+      uint32_t index;
+      object_hit = cloud->intersectRay(ray, pixel_angle, index, object_distance);
+    }
+    else if (dynamic_cast<MovableText*>(object))
+    {
+      std::pair<bool, Ogre::Real> result = Ogre::Math::intersects(ray, object->getWorldBoundingBox(true));
+      object_hit = result.first;
+      object_distance = result.second;
+    }
+
+    if (object_hit && (!hit || object_distance < distance))
+    {
+      hit = true;
+      distance = object_distance;
+    }
+  }
+
+  return hit;
+}
+
 void SelectionHandler::destroyProperties( const Picked& obj, Property* parent_property )
 {
   for( int i = 0; i < properties_.size(); i++ )
@@ -45,6 +45,7 @@
 
 namespace Ogre
 {
+class Ray;
 class WireBoundingBox;
 class SceneNode;
 class MovableObject;
@@ -110,6 +111,38 @@ public:
 
   virtual void getAABBs(const Picked& obj, V_AABB& aabbs);
 
+  /** @brief Return a world-space box around everything this handler can pick.
+   *
+   * Used by SelectionManager's CPU pick tree.  This base implementation
+   * merges the world bounding boxes of the tracked objects. */
+  virtual Ogre::AxisAlignedBox getPickBounds();
+
+  /** @brief Return true if intersectRay() can answer picks for this handler.
+   *
+   * If any handler can't, SelectionManager picks by rendering instead.
+   * This base implementation returns true if there are tracked objects
+   * and all of them are PointClouds, MovableTexts or Ogre::Entity
+   * objects whose mesh buffers have shadow copies to read. */
+  virtual bool supportsRayPick();
+
+  /** @brief Intersect a world-space ray with the objects of this handler, for picking without rendering.
+   *
+   * This base implementation tests the triangles of tracked
+   * Ogre::Entity objects, the points of tracked PointClouds and the
+   * world bounding boxes of tracked MovableTexts.
+   *
+   * @param pixel_angle Angle subtended by one pixel, for objects sized in pixels.
+   * @param distance Set to the distance along the ray of the nearest hit.
+   * @param extra_handle Set to the extra handle of the part hit, for
+   *        handlers which need additional render passes.
+   * @return true if the ray hits. */
+  virtual bool intersectRay( const Ogre::Ray& ray, float pixel_angle, float& distance, uint64_t& extra_handle );
+
+  /** @brief Tell SelectionManager the result of getPickBounds() has changed.
+   *
+   * Moving, adding or removing tracked objects does this automatically. */
+  void markPickBoundsDirty() { pick_bounds_dirty_ = true; }
+
   virtual void onSelect(const Picked& obj);
   virtual void onDeselect(const Picked& obj);
 
@@ -143,6 +176,8 @@ protected:
   typedef std::set<Ogre::MovableObject*> S_Movable;
   S_Movable tracked_objects_;
 
+  bool pick_bounds_dirty_;
+
   class Listener : public Ogre::MovableObject::Listener
   {
   public:
@@ -152,6 +187,7 @@ protected:
     virtual void objectMoved(Ogre::MovableObject* object)
     {
       handler_->updateTrackedBoxes();
+      handler_->markPickBoundsDirty();
     }
 
     virtual void objectDestroyed(Ogre::MovableObject* object)
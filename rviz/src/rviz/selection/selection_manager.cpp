@@ -70,6 +70,7 @@ SelectionManager::SelectionManager(VisualizationManager* manager)
   , uid_counter_(0)
   , interaction_enabled_(false)
   , debug_mode_( false )
+  , ray_pick_enabled_( true )
   , property_model_( new PropertyTreeModel( new Property( "root" )))
 {
   for (uint32_t i = 0; i < s_num_render_textures_; ++i)
@@ -77,6 +78,10 @@ SelectionManager::SelectionManager(VisualizationManager* manager)
     pixel_boxes_[i].data = 0;
   }
   depth_pixel_box_.data = 0;
+  frame_cache_.pick_box.data = 0;
+  frame_cache_.depth_box.data = 0;
+  frame_cache_.texture_size = 0;
+  frame_cache_.valid = false;
 
   QTimer* timer = new QTimer( this );
   connect( timer, SIGNAL( timeout() ), this, SLOT( updateProperties() ));
@@ -97,6 +102,8 @@ SelectionManager::~SelectionManager()
     delete [] (uint8_t*)pixel_boxes_[i].data;
   }
   delete [] (uint8_t*)depth_pixel_box_.data;
+  delete [] (uint8_t*)frame_cache_.pick_box.data;
+  delete [] (uint8_t*)frame_cache_.depth_box.data;
 
   vis_manager_->getSceneManager()->destroyCamera( camera_ );
 
@@ -197,7 +204,7 @@ void SelectionManager::initDepthFinder()
       float size = 0.6;
 
       float left = 1.0-size;
-      float top = 1.0 - size * (float)2 * 1.02;
+      float top = 1.0 - size * (float)s_num_render_textures_ * 1.02;
       float right = left + size;
       float bottom = top - size;
 
@@ -234,12 +241,66 @@ void SelectionManager::setDebugVisibility( bool visible )
   }
 }
 
+/** @brief Unpack a depth value written by the "Depth" material scheme (see pack_depth.frag).
+ * @return The view-space depth, or 0 if nothing was drawn at this pixel. */
+static float unpackDepth( const uint8_t* data, float far_clip_distance )
+{
+  uint8_t a = data[0];
+  uint8_t b = data[1];
+  uint8_t c = data[2];
+
+  int int_depth = (c << 16) | (b << 8) | a;
+  float normalized_depth = ((float) int_depth) / (float) 0xffffff;
+  return normalized_depth * far_clip_distance;
+}
+
+/** @brief Return the point on the ray through pixel x, y of the viewport at the given view-space depth. */
+static Ogre::Vector3 pointAtDepth( Ogre::Viewport* viewport, int x, int y, float depth )
+{
+  Ogre::Camera* camera = viewport->getCamera();
+  Ogre::Ray ray;
+  camera->getCameraToViewportRay( (x + 0.5f) / viewport->getActualWidth(),
+                                  (y + 0.5f) / viewport->getActualHeight(), &ray );
+
+  // The depth shaders write the distance from the camera plane, not along the ray.  The ray starts on
+  // the near plane, and for perspective views its direction is tilted away from the view direction.
+  Ogre::Vector3 forward = camera->getDerivedDirection();
+  float origin_depth = ( ray.getOrigin() - camera->getDerivedPosition() ).dotProduct( forward );
+  return ray.getPoint( ( depth - origin_depth ) / ray.getDirection().dotProduct( forward ));
+}
+
 bool SelectionManager::get3DPoint( Ogre::Viewport* viewport, int x, int y, Ogre::Vector3& result_point )
 {
   ROS_DEBUG("SelectionManager.get3DPoint()");
 
   boost::recursive_mutex::scoped_lock lock(global_mutex_);
 
+  // The buffers captured after the last frame show exactly what's on screen, so they are authoritative.
+  if( isFrameCacheValid( viewport ))
+  {
+    const uint8_t* pixel = frameCachePixel( frame_cache_.depth_box, x, y );
+    float depth = pixel ? unpackDepth( pixel, camera_->getFarClipDistance() ) : 0;
+    if( depth == 0 )
+    {
+      return false;
+    }
+    result_point = pointAtDepth( viewport, x, y, depth );
+    return true;
+  }
+
+  // Use the ray pick if it hits a selectable object.  If it misses, render the depth pass anyway,
+  // since non-selectable geometry like the grid should still give a point.
+  Ogre::Ray ray;
+  CollObjectHandle handle;
+  float distance;
+  uint64_t extra_handle;
+  if( rayPick( viewport, x, y, ray, handle, distance, extra_handle ) && handle )
+  {
+    result_point = ray.getPoint( distance );
+    ROS_DEBUG("SelectionManager.get3DPoint(): ray pick point = %f, %f, %f", result_point.x, result_point.y, result_point.z);
+    return true;
+  }
+
   setDebugVisibility( false );
 
   M_CollisionObjectToSelectionHandler::iterator handler_it = objects_.begin();
@@ -253,59 +314,10 @@ bool SelectionManager::get3DPoint( Ogre::Viewport* viewport, int x, int y, Ogre:
   bool success = false;
   if( render( viewport, depth_render_texture_, x, y, x + 1, y + 1, depth_pixel_box_, "Depth", depth_texture_size_ ))
   {
-    uint8_t* data_ptr = (uint8_t*) depth_pixel_box_.data;
-    uint8_t a = *data_ptr++;
-    uint8_t b = *data_ptr++;
-    uint8_t c = *data_ptr++;
-
-    int int_depth = (c << 16) | (b << 8) | a;
-    float normalized_depth = ((float) int_depth) / (float) 0xffffff;
-
-    float depth = normalized_depth * camera_->getFarClipDistance();
-    
+    float depth = unpackDepth( (uint8_t*) depth_pixel_box_.data, camera_->getFarClipDistance() );
     if( depth != 0 )
     {
-      Ogre::Matrix4 projection = camera_->getProjectionMatrix();
-      if( projection[3][3] == 0.0 ) // If this is a perspective projection
-      {
-        // We don't use camera_->getCameraToViewportRay() here because
-        // it normalizes the ray direction vector.  We need the scale
-        // of the direction vector to account for the fact that the
-        // depth value we get is not a distance from the camera, it is
-        // a depth coordinate.  If we used the normalized vector, a
-        // sweep along a plane parallel to the camera plane would
-        // yield an arc of points instead of a line.
-        Ogre::Matrix4 view = camera_->getViewMatrix();
-        Ogre::Matrix4 pv = projection * view;
-        Ogre::Matrix4 ip = pv.inverse();
-
-        Ogre::Vector4 near_point(0, 0, -1, 1);
-        Ogre::Vector4 far_point(0, 0, 0, 1);
-
-        Ogre::Vector4 ray_origin = ip * near_point;
-        Ogre::Vector4 ray_target = ip * far_point;
-      
-        ray_origin /= ray_origin[3];
-        ray_target /= ray_target[3];
-
-        Ogre::Vector3 origin3( ray_origin[0], ray_origin[1], ray_origin[2] );
-        Ogre::Vector3 target3( ray_target[0], ray_target[1], ray_target[2] );
-
-        Ogre::Vector3 dir = target3 - origin3;
-
-        // TODO: Not sure where this scale factor actually comes from nor its precise value. (hersh)
-        float magic_scale_factor = 100;
-        result_point = target3 + dir * magic_scale_factor * depth;
-      }
-      else // else this must be an orthographic projection.
-      {
-        // For orthographic projection, getCameraToViewportRay() does
-        // the right thing for us, and the above math does not work.
-        Ogre::Ray ray;
-        camera_->getCameraToViewportRay( 0.5, 0.5, &ray );
-
-        result_point = ray.getPoint( depth );
-      }
+      result_point = pointAtDepth( viewport, x, y, depth );
 
       ROS_DEBUG("SelectionManager.get3DPoint(): point = %f, %f, %f", result_point.x, result_point.y, result_point.z);
 
@@ -325,6 +337,113 @@ bool SelectionManager::get3DPoint( Ogre::Viewport* viewport, int x, int y, Ogre:
   return success;
 }
 
+/** @brief (Re)create a render texture used to capture a whole viewport for the frame cache. */
+static Ogre::TexturePtr createFrameCacheTexture( const std::string& name, unsigned size )
+{
+  if( Ogre::TextureManager::getSingleton().resourceExists( name ))
+  {
+    Ogre::TextureManager::getSingleton().remove( name );
+  }
+
+  Ogre::TexturePtr tex = Ogre::TextureManager::getSingleton().createManual( name,
+      Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, size, size, 0,
+      Ogre::PF_R8G8B8, Ogre::TU_STATIC | Ogre::TU_RENDERTARGET );
+  tex->getBuffer()->getRenderTarget()->setAutoUpdated( false );
+  return tex;
+}
+
+void SelectionManager::updateFrameCache( Ogre::Viewport* viewport )
+{
+  boost::recursive_mutex::scoped_lock lock(global_mutex_);
+
+  frame_cache_.valid = false;
+
+  int width = viewport->getActualWidth();
+  int height = viewport->getActualHeight();
+  if( width <= 0 || height <= 0 )
+  {
+    return;
+  }
+
+  // Larger viewports are captured at reduced resolution, see frameCachePixel()
+  unsigned size = 1;
+  while( size < (unsigned) std::max( width, height ) && size < 2048 )
+  {
+    size *= 2;
+  }
+  if( size != frame_cache_.texture_size )
+  {
+    frame_cache_.pick_texture = createFrameCacheTexture( "SelectionFrameCachePickTexture", size );
+    frame_cache_.depth_texture = createFrameCacheTexture( "SelectionFrameCacheDepthTexture", size );
+    frame_cache_.texture_size = size;
+  }
+
+  setDebugVisibility( false );
+
+  M_CollisionObjectToSelectionHandler::iterator handler_it = objects_.begin();
+  M_CollisionObjectToSelectionHandler::iterator handler_end = objects_.end();
+  for (; handler_it != handler_end; ++handler_it)
+  {
+    handler_it->second->preRenderPass(0);
+  }
+
+  bool success =
+    render( viewport, frame_cache_.pick_texture, 0, 0, width, height, frame_cache_.pick_box, "Pick", size ) &&
+    render( viewport, frame_cache_.depth_texture, 0, 0, width, height, frame_cache_.depth_box, "Depth", size );
+
+  handler_it = objects_.begin();
+  handler_end = objects_.end();
+  for (; handler_it != handler_end; ++handler_it)
+  {
+    handler_it->second->postRenderPass(0);
+  }
+
+  setDebugVisibility( true );
+
+  if( success )
+  {
+    Ogre::Camera* camera = viewport->getCamera();
+    frame_cache_.viewport = viewport;
+    frame_cache_.frame_count = vis_manager_->getFrameCount();
+    frame_cache_.width = width;
+    frame_cache_.height = height;
+    frame_cache_.camera_position = camera->getDerivedPosition();
+    frame_cache_.camera_orientation = camera->getDerivedOrientation();
+    frame_cache_.projection = camera->getProjectionMatrix();
+    frame_cache_.valid = true;
+  }
+}
+
+bool SelectionManager::isFrameCacheValid( Ogre::Viewport* viewport )
+{
+  if( !frame_cache_.valid ||
+      frame_cache_.viewport != viewport ||
+      frame_cache_.frame_count != vis_manager_->getFrameCount() ||
+      frame_cache_.width != viewport->getActualWidth() ||
+      frame_cache_.height != viewport->getActualHeight() )
+  {
+    return false;
+  }
+
+  // The view controller may have moved the camera since the last frame was rendered
+  Ogre::Camera* camera = viewport->getCamera();
+  return frame_cache_.camera_position == camera->getDerivedPosition() &&
+         frame_cache_.camera_orientation == camera->getDerivedOrientation() &&
+         frame_cache_.projection == camera->getProjectionMatrix();
+}
+
+const uint8_t* SelectionManager::frameCachePixel( const Ogre::PixelBox& box, int x, int y )
+{
+  if( x < 0 || y < 0 || x >= frame_cache_.width || y >= frame_cache_.height )
+  {
+    return 0;
+  }
+
+  size_t box_x = (size_t) x * box.getWidth() / frame_cache_.width;
+  size_t box_y = (size_t) y * box.getHeight() / frame_cache_.height;
+  return (const uint8_t*) box.data + (box_x + box_y * box.rowPitch) * Ogre::PixelUtil::getNumElemBytes( box.format );
+}
+
 void SelectionManager::setTextureSize( unsigned size )
 {
   if ( size > 1024 )
@@ -408,6 +527,8 @@ void SelectionManager::clearHandlers()
   boost::recursive_mutex::scoped_lock lock(global_mutex_);
 
   objects_.clear();
+  pick_tree_.clear();
+  pick_leaves_.clear();
 }
 
 void SelectionManager::enableInteraction( bool enable )
@@ -468,6 +589,8 @@ void SelectionManager::addObject(CollObjectHandle obj, const SelectionHandlerPtr
 
   bool inserted = objects_.insert(std::make_pair(obj, handler)).second;
   ROS_ASSERT(inserted);
+
+  handler->markPickBoundsDirty();
 }
 
 void SelectionManager::removeObject(CollObjectHandle obj)
@@ -489,6 +612,13 @@ void SelectionManager::removeObject(CollObjectHandle obj)
   }
 
   objects_.erase(obj);
+
+  M_CollObjectToLeaf::iterator leaf_it = pick_leaves_.find(obj);
+  if (leaf_it != pick_leaves_.end())
+  {
+    pick_tree_.remove(leaf_it->second);
+    pick_leaves_.erase(leaf_it);
+  }
 }
 
 void SelectionManager::update()
@@ -569,36 +699,39 @@ void SelectionManager::setHighlightRect(Ogre::Viewport* viewport, int x1, int y1
   highlight_rectangle_->setCorners(nx1, ny1, nx2, ny2);
 }
 
-void SelectionManager::unpackColors( const Ogre::PixelBox& box, V_Pixel& pixels)
+void SelectionManager::unpackColors( const Ogre::PixelBox& box, V_CollObject& handles )
 {
   int w = box.getWidth();
   int h = box.getHeight();
 
-  pixels.clear();
-  pixels.reserve( w*h );
+  handles.resize( w*h );
+
+  // Decide the layout once, so the loop below is a plain shift and mask
+  uint32_t shift = 0;
+  uint32_t mask = 0x00ffffff;
+  if (box.format == Ogre::PF_R8G8B8A8)
+  {
+    shift = 8;
+  }
+  else if (box.format != Ogre::PF_A8R8G8B8 && box.format != Ogre::PF_X8R8G8B8)
+  {
+    ROS_DEBUG("Incompatible pixel format [%d]", box.format);
+    mask = 0;
+  }
 
+  CollObjectHandle* dst = handles.empty() ? 0 : &handles.front();
   for (int y = 0; y < h; y ++)
   {
+    const uint32_t* src = (const uint32_t*)box.data + y * box.rowPitch;
     for (int x = 0; x < w; x ++)
     {
-      uint32_t pos = (x + y*w) * 4;
-
-      uint32_t pix_val = *(uint32_t*)((uint8_t*)box.data + pos);
-      uint32_t handle = colorToHandle(box.format, pix_val);
-
-      //ROS_INFO( "%d %d = %u", x, y, handle );
-
-      Pixel p;
-      p.x = x;
-      p.y = y;
-      p.handle = handle;
-
-      pixels.push_back(p);
+      dst[x] = (src[x] >> shift) & mask;
     }
+    dst += w;
   }
 }
 
-void SelectionManager::renderAndUnpack(Ogre::Viewport* viewport, uint32_t pass, int x1, int y1, int x2, int y2, V_Pixel& pixels)
+void SelectionManager::renderAndUnpack(Ogre::Viewport* viewport, uint32_t pass, int x1, int y1, int x2, int y2, V_CollObject& handles)
 {
   ROS_ASSERT(pass < s_num_render_textures_);
 
@@ -611,7 +744,11 @@ void SelectionManager::renderAndUnpack(Ogre::Viewport* viewport, uint32_t pass,
 
   if( render( viewport, render_textures_[pass], x1, y1, x2, y2, pixel_boxes_[pass], scheme.str(), texture_size_ ))
   {
-    unpackColors(pixel_boxes_[pass], pixels);
+    unpackColors(pixel_boxes_[pass], handles);
+  }
+  else
+  {
+    handles.clear();
   }
 }
 
@@ -771,19 +908,154 @@ void SelectionManager::renderQueueStarted( uint8_t queueGroupId,
   skipThisInvocation = true;
 }
 
+bool SelectionManager::updatePickTree()
+{
+  bool complete = true;
+
+  M_CollisionObjectToSelectionHandler::iterator handler_it = objects_.begin();
+  M_CollisionObjectToSelectionHandler::iterator handler_end = objects_.end();
+  for (; handler_it != handler_end; ++handler_it)
+  {
+    CollObjectHandle handle = handler_it->first;
+    const SelectionHandlerPtr& handler = handler_it->second;
+
+    if (!handler->supportsRayPick())
+    {
+      complete = false;
+      continue;
+    }
+
+    if (!handler->pick_bounds_dirty_)
+    {
+      continue;
+    }
+
+    Ogre::AxisAlignedBox bounds = handler->getPickBounds();
+    if (bounds.isInfinite())
+    {
+      // Leave the flag set so this is retried on the next pick
+      complete = false;
+      continue;
+    }
+    handler->pick_bounds_dirty_ = false;
+
+    M_CollObjectToLeaf::iterator leaf_it = pick_leaves_.find(handle);
+    if (bounds.isNull())
+    {
+      if (leaf_it != pick_leaves_.end())
+      {
+        pick_tree_.remove(leaf_it->second);
+        pick_leaves_.erase(leaf_it);
+      }
+    }
+    else if (leaf_it == pick_leaves_.end())
+    {
+      pick_leaves_[handle] = pick_tree_.insert(bounds, handle);
+    }
+    else
+    {
+      pick_tree_.move(leaf_it->second, bounds);
+    }
+  }
+
+  return complete;
+}
+
+bool SelectionManager::rayPick( Ogre::Viewport* viewport, int x, int y, Ogre::Ray& ray,
+                                CollObjectHandle& handle, float& distance, uint64_t& extra_handle )
+{
+  if (!ray_pick_enabled_ || !updatePickTree())
+  {
+    return false;
+  }
+
+  Ogre::Camera* camera = viewport->getCamera();
+  float width = viewport->getActualWidth();
+  float height = viewport->getActualHeight();
+  camera->getCameraToViewportRay( (x + 0.5f) / width, (y + 0.5f) / height, &ray );
+  float pixel_angle = camera->getFOVy().valueRadians() / height;
+
+  std::vector<std::pair<float, CollObjectHandle> > candidates;
+  pick_tree_.intersect(ray, candidates);
+  std::sort(candidates.begin(), candidates.end());
+
+  handle = 0;
+  extra_handle = 0;
+  for (size_t i = 0; i < candidates.size(); ++i)
+  {
+    // Candidates are sorted by where the ray enters their bounds, so nothing further can be closer
+    if (handle && candidates[i].first > distance)
+    {
+      break;
+    }
+
+    SelectionHandlerPtr handler = getHandler(candidates[i].second);
+    float candidate_distance;
+    uint64_t candidate_extra = 0;
+    if (handler && handler->intersectRay(ray, pixel_angle, candidate_distance, candidate_extra) &&
+        (!handle || candidate_distance < distance))
+    {
+      handle = candidates[i].second;
+      distance = candidate_distance;
+      extra_handle = candidate_extra;
+    }
+  }
+
+  return true;
+}
+
 void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, int y2, M_Picked& results, bool single_render_pass)
 {
   boost::recursive_mutex::scoped_lock lock(global_mutex_);
 
+  // Single clicks and hover queries don't need to render anything if the last frame's pick buffer
+  // is still current, or if every handler can answer a ray
+  if (abs(x2 - x1) <= 1 && abs(y2 - y1) <= 1)
+  {
+    if (isFrameCacheValid(viewport))
+    {
+      const uint8_t* pixel = frameCachePixel(frame_cache_.pick_box, x1, y1);
+      CollObjectHandle handle = pixel ? colorToHandle(frame_cache_.pick_box.format, *(const uint32_t*)pixel) : 0;
+      SelectionHandlerPtr handler = getHandler(handle);
+
+      // Only the first pass is cached, so handlers which need more passes still render
+      if (!handler)
+      {
+        return;
+      }
+      if (single_render_pass || !handler->needsAdditionalRenderPass(1))
+      {
+        results.insert(std::make_pair(handle, Picked(handle)));
+        return;
+      }
+    }
+
+    Ogre::Ray ray;
+    CollObjectHandle handle;
+    float distance;
+    uint64_t extra_handle;
+    if (rayPick(viewport, x1, y1, ray, handle, distance, extra_handle))
+    {
+      if (handle)
+      {
+        Picked picked(handle);
+        if (extra_handle && !single_render_pass)
+        {
+          picked.extra_handles.insert(extra_handle);
+        }
+        results.insert(std::make_pair(handle, picked));
+      }
+      return;
+    }
+  }
+
   setDebugVisibility( false );
 
   bool need_additional_render = false;
 
-  V_CollObject handles_by_pixel;
+  V_CollObject& handles_by_pixel = pixel_buffer_;
   S_CollObject need_additional;
 
-  V_Pixel& pixels = pixel_buffer_;
-
   // First render is special... does the initial object picking, determines which objects have been selected
   // After that, individual handlers can specify that they need additional renders (max # defined in s_num_render_textures_)
   {
@@ -796,7 +1068,7 @@ void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, in
       handler->preRenderPass(0);
     }
 
-    renderAndUnpack(viewport, 0, x1, y1, x2, y2, pixels);
+    renderAndUnpack(viewport, 0, x1, y1, x2, y2, handles_by_pixel);
 
     handler_it = objects_.begin();
     handler_end = objects_.end();
@@ -807,47 +1079,74 @@ void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, in
       handler->postRenderPass(0);
     }
 
-    handles_by_pixel.reserve(pixels.size());
-    V_Pixel::iterator it = pixels.begin();
-    V_Pixel::iterator end = pixels.end();
+    // Histogram of the handles.  Neighbouring pixels mostly show the same object, so each run
+    // is counted locally and only added to the map when the handle changes.
+    typedef boost::unordered_map<CollObjectHandle, int> M_HandleCount;
+    M_HandleCount counts;
+    CollObjectHandle run_handle = 0;
+    int run_length = 0;
+    V_CollObject::const_iterator it = handles_by_pixel.begin();
+    V_CollObject::const_iterator end = handles_by_pixel.end();
     for (; it != end; ++it)
     {
-      const Pixel& p = *it;
+      if (*it == run_handle)
+      {
+        ++run_length;
+        continue;
+      }
 
-      CollObjectHandle handle = p.handle;
+      if (run_handle)
+      {
+        counts[run_handle] += run_length;
+      }
+      run_handle = *it;
+      run_length = 1;
+    }
+    if (run_handle)
+    {
+      counts[run_handle] += run_length;
+    }
 
-      handles_by_pixel.push_back(handle);
+    // Resolve each handler once, not once per pixel
+    M_HandleCount::iterator count_it = counts.begin();
+    M_HandleCount::iterator count_end = counts.end();
+    for (; count_it != count_end; ++count_it)
+    {
+      CollObjectHandle handle = count_it->first;
 
-      if (handle == 0)
+      M_CollisionObjectToSelectionHandler::iterator handler_it = objects_.find(handle);
+      if (handler_it == objects_.end())
       {
         continue;
       }
+      const SelectionHandlerPtr& handler = handler_it->second;
 
-      SelectionHandlerPtr handler = getHandler(handle);
-
-      if (handle && handler)
+      Picked picked(handle);
+      picked.pixel_count = count_it->second;
+      std::pair<M_Picked::iterator, bool> insert_result = results.insert(std::make_pair(handle, picked));
+      if (insert_result.second)
       {
-        std::pair<M_Picked::iterator, bool> insert_result = results.insert(std::make_pair(handle, Picked(handle)));
-        if (insert_result.second)
-        {
-          if (handler->needsAdditionalRenderPass(1) && !single_render_pass)
-          {
-            need_additional.insert(handle);
-            need_additional_render = true;
-          }
-        }
-        else
+        if (handler->needsAdditionalRenderPass(1) && !single_render_pass)
         {
-          insert_result.first->second.pixel_count++;
+          need_additional.insert(handle);
+          need_additional_render = true;
         }
       }
+      else
+      {
+        insert_result.first->second.pixel_count += count_it->second;
+      }
     }
   }
 
   uint32_t pass = 1;
 
   V_uint64 extra_by_pixel;
-  extra_by_pixel.resize(handles_by_pixel.size());
+  V_CollObject extra_handles_by_pixel;
+  if (need_additional_render)
+  {
+    extra_by_pixel.assign(handles_by_pixel.size(), 0);
+  }
   while (need_additional_render && pass < s_num_render_textures_)
   {
     {
@@ -862,7 +1161,7 @@ void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, in
       }
     }
 
-    renderAndUnpack(viewport, pass, x1, y1, x2, y2, pixels);
+    renderAndUnpack(viewport, pass, x1, y1, x2, y2, extra_handles_by_pixel);
 
     {
       S_CollObject::iterator need_it = need_additional.begin();
@@ -876,29 +1175,25 @@ void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, in
       }
     }
 
-    int i = 0;
-    V_Pixel::iterator pix_it = pixels.begin();
-    V_Pixel::iterator pix_end = pixels.end();
-    for (; pix_it != pix_end; ++pix_it, ++i)
+    // Both passes cover the same rectangle, so the buffers line up pixel for pixel
+    size_t num_pixels = std::min(extra_handles_by_pixel.size(), handles_by_pixel.size());
+    CollObjectHandle last_handle = 0;
+    bool last_needed = false;
+    for (size_t i = 0; i < num_pixels; ++i)
     {
-      const Pixel& p = *pix_it;
-
       CollObjectHandle handle = handles_by_pixel[i];
-
-      if (pass == 1)
+      if (handle != last_handle)
       {
-        extra_by_pixel[i] = 0;
+        last_handle = handle;
+        last_needed = need_additional.find(handle) != need_additional.end();
       }
 
-      if (need_additional.find(handle) != need_additional.end())
+      // Pixels of handlers which are done keep the extra handle bits of their earlier passes
+      if (last_needed)
       {
-        CollObjectHandle extra_handle = p.handle;
+        uint64_t extra_handle = extra_handles_by_pixel[i];
         extra_by_pixel[i] |= extra_handle << (32 * (pass-1));
       }
-      else
-      {
-        extra_by_pixel[i] = 0;
-      }
     }
 
     need_additional_render = false;
@@ -915,31 +1210,36 @@ void SelectionManager::pick(Ogre::Viewport* viewport, int x1, int y1, int x2, in
         need_additional.insert(handle);
       }
     }
+
+    ++pass;
   }
 
-  int i = 0;
-  V_uint64::iterator pix_2_it = extra_by_pixel.begin();
-  V_uint64::iterator pix_2_end = extra_by_pixel.end();
-  for (; pix_2_it != pix_2_end; ++pix_2_it, ++i)
+  CollObjectHandle last_handle = 0;
+  uint64_t last_extra = 0;
+  Picked* picked = 0;
+  for (size_t i = 0; i < extra_by_pixel.size(); ++i)
   {
     CollObjectHandle handle = handles_by_pixel[i];
+    uint64_t extra = extra_by_pixel[i];
 
-    if (handle == 0)
+    if (handle == 0 || extra == 0)
     {
       continue;
     }
 
-    M_Picked::iterator picked_it = results.find(handle);
-    if (picked_it == results.end())
+    if (handle != last_handle)
     {
-      continue;
+      M_Picked::iterator picked_it = results.find(handle);
+      picked = picked_it == results.end() ? 0 : &picked_it->second;
+      last_handle = handle;
+      last_extra = 0;
     }
 
-    Picked& picked = picked_it->second;
-
-    if (*pix_2_it)
+    // Skip the set insert for runs of pixels showing the same point
+    if (picked && extra != last_extra)
     {
-      picked.extra_handles.insert(*pix_2_it);
+      picked->extra_handles.insert(extra);
+      last_extra = extra;
     }
   }
 
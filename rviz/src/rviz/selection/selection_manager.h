@@ -34,6 +34,7 @@
 
 #include "forwards.h"
 #include "selection_handler.h"
+#include "selection_bvh.h"
 
 #include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
@@ -42,7 +43,9 @@
 #include <OGRE/OgreTexture.h>
 #include <OGRE/OgreMaterial.h>
 #include <OGRE/OgreMaterialManager.h>
+#include <OGRE/OgreMatrix4.h>
 #include <OGRE/OgreMovableObject.h>
+#include <OGRE/OgreQuaternion.h>
 #include <OGRE/OgreRenderQueueListener.h>
 
 #include <vector>
@@ -149,6 +152,21 @@ public:
    * be changed to contain the 3D point corresponding to it. */
   bool get3DPoint( Ogre::Viewport* viewport, int x, int y, Ogre::Vector3& result_point );
 
+  /** @brief Enable or disable answering single-pixel picks on the CPU.
+   *
+   * When enabled (the default), pick() and get3DPoint() intersect a
+   * ray with the bounds of all selection handlers before falling back
+   * to rendering the pick schemes. */
+  void setRayPickEnabled( bool enabled ) { ray_pick_enabled_ = enabled; }
+  bool getRayPickEnabled() { return ray_pick_enabled_; }
+
+  /** @brief Capture the pick and depth buffers of the whole viewport.
+   *
+   * Call this right after rendering a frame.  Until the camera moves
+   * or the next frame is rendered, single-pixel picks and get3DPoint()
+   * on this viewport are answered from the captured buffers. */
+  void updateFrameCache( Ogre::Viewport* viewport );
+
   // Implementation for Ogre::RenderQueueListener.
   void renderQueueStarted( uint8_t queueGroupId,
                            const std::string& invocation, 
@@ -170,8 +188,8 @@ private:
 
   void setHighlightRect(Ogre::Viewport* viewport, int x1, int y1, int x2, int y2);
 
-  /** Render to a texture for one of the picking passes and unpack the resulting pixels. */
-  void renderAndUnpack(Ogre::Viewport* viewport, uint32_t pass, int x1, int y1, int x2, int y2, V_Pixel& pixels);
+  /** Render to a texture for one of the picking passes and unpack the handle of each pixel, row by row. */
+  void renderAndUnpack(Ogre::Viewport* viewport, uint32_t pass, int x1, int y1, int x2, int y2, V_CollObject& handles);
 
   /** Internal render function to render to a texture and read the pixels back out. */
   bool render( Ogre::Viewport* viewport, Ogre::TexturePtr tex,
@@ -179,10 +197,26 @@ private:
                Ogre::PixelBox& dst_box, std::string material_scheme,
                unsigned texture_size );
 
-  void unpackColors(const Ogre::PixelBox& box, V_Pixel& pixels);
+  void unpackColors(const Ogre::PixelBox& box, V_CollObject& handles);
 
   void initDepthFinder();
 
+  /** @brief Bring pick_tree_ up to date with the pick bounds of all handlers.
+   * @return false if some handler can't be picked by ray, in which case ray picks must not be used. */
+  bool updatePickTree();
+
+  /** @brief Pick the object under pixel x, y by intersecting a ray with pick_tree_ and the handlers it hits.
+   * @return false if ray picking can't be used, in which case the outputs are untouched.
+   *         Otherwise true, with @a handle set to 0 if nothing was hit. */
+  bool rayPick( Ogre::Viewport* viewport, int x, int y, Ogre::Ray& ray,
+                CollObjectHandle& handle, float& distance, uint64_t& extra_handle );
+
+  /** @brief Return true if the frame cache still shows what @a viewport shows. */
+  bool isFrameCacheValid( Ogre::Viewport* viewport );
+
+  /** @brief Return a pointer to the pixel of a frame cache buffer under viewport pixel x, y, or 0 if outside. */
+  const uint8_t* frameCachePixel( const Ogre::PixelBox& box, int x, int y );
+
   // Set the visibility of the debug windows.  If debug_mode_ is false, this has no effect.
   void setDebugVisibility( bool visible );
 
@@ -207,7 +241,7 @@ private:
 
   M_Picked selection_;
 
-  const static uint32_t s_num_render_textures_ = 2; // If you want to change this number to something > 3 you must provide more width for extra handles in the Picked structure (currently a u64)
+  const static uint32_t s_num_render_textures_ = 3; // If you want to change this number to something > 3 you must provide more width for extra handles in the Picked structure (currently a u64)
   Ogre::TexturePtr render_textures_[s_num_render_textures_];
   Ogre::PixelBox pixel_boxes_[s_num_render_textures_];
 
@@ -224,7 +258,7 @@ private:
   Ogre::SceneNode* highlight_node_;
   Ogre::Camera *camera_;
 
-  V_Pixel pixel_buffer_;
+  V_CollObject pixel_buffer_;
 
   bool interaction_enabled_;
 
@@ -237,6 +271,32 @@ private:
 
   uint32_t texture_size_;
 
+  // CPU picking of single pixels.
+  bool ray_pick_enabled_;
+  SelectionBVH pick_tree_;
+  typedef boost::unordered_map<CollObjectHandle, int> M_CollObjectToLeaf;
+  M_CollObjectToLeaf pick_leaves_;
+
+  // Pick and depth buffers of the last rendered frame, see updateFrameCache().
+  struct FrameCache
+  {
+    Ogre::TexturePtr pick_texture;
+    Ogre::TexturePtr depth_texture;
+    unsigned texture_size;
+    Ogre::PixelBox pick_box;
+    Ogre::PixelBox depth_box;
+
+    bool valid;
+    Ogre::Viewport* viewport;
+    uint64_t frame_count;
+    int width;
+    int height;
+    Ogre::Vector3 camera_position;
+    Ogre::Quaternion camera_orientation;
+    Ogre::Matrix4 projection;
+  };
+  FrameCache frame_cache_;
+
   PropertyTreeModel* property_model_;
 };
 
@@ -75,6 +75,7 @@
 #include "rviz/selection/selection_manager.h"
 #include "rviz/selection_panel.h"
 #include "rviz/splash_screen.h"
+#include "rviz/profiler_panel.h"
 #include "rviz/time_panel.h"
 #include "rviz/tool.h"
 #include "rviz/tool_manager.h"
@@ -109,6 +110,7 @@ VisualizationFrame::VisualizationFrame( QWidget* parent )
   , displays_panel_(NULL)
   , views_panel_(NULL)
   , time_panel_(NULL)
+  , profiler_panel_(NULL)
   , selection_panel_(NULL)
   , tool_properties_panel_(NULL)
   , help_panel_(NULL)
@@ -227,6 +229,7 @@ void VisualizationFrame::initialize(const QString& display_config_file )
   displays_panel_ = new DisplaysPanel( this );
   views_panel_ = new ViewsPanel( this );
   time_panel_ = new TimePanel( this );
+  profiler_panel_ = new ProfilerPanel( this );
   selection_panel_ = new SelectionPanel( this );
   tool_properties_panel_ = new ToolPropertiesPanel( this );
 
@@ -260,6 +263,8 @@ void VisualizationFrame::initialize(const QString& display_config_file )
   addPane( "Views", views_panel_, Qt::RightDockWidgetArea, false );
   addPane( "Selection", selection_panel_, Qt::RightDockWidgetArea, false );
   addPane( "Time", time_panel_, Qt::BottomDockWidgetArea, false );
+  // Hidden until asked for from the View menu
+  addPane( "Profiler", profiler_panel_, Qt::BottomDockWidgetArea, false )->hide();
 
   manager_ = new VisualizationManager( render_panel_, this );
   connect( manager_, SIGNAL( statusUpdate( const QString& )), this, SIGNAL( statusUpdate( const QString& )));
@@ -268,6 +273,7 @@ void VisualizationFrame::initialize(const QString& display_config_file )
   displays_panel_->initialize( manager_ );
   views_panel_->initialize( manager_ );
   time_panel_->initialize(manager_);
+  profiler_panel_->initialize( manager_ );
   selection_panel_->initialize( manager_ );
   tool_properties_panel_->initialize( manager_ );
 
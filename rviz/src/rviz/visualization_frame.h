@@ -58,6 +58,7 @@ class RenderPanel;
 class DisplaysPanel;
 class ViewsPanel;
 class TimePanel;
+class ProfilerPanel;
 class SelectionPanel;
 class ToolPropertiesPanel;
 class VisualizationManager;
@@ -253,6 +254,7 @@ protected:
   DisplaysPanel* displays_panel_;
   ViewsPanel* views_panel_;
   TimePanel* time_panel_;
+  ProfilerPanel* profiler_panel_;
   SelectionPanel* selection_panel_;
   ToolPropertiesPanel* tool_properties_panel_;
 
@@ -60,8 +60,12 @@
 #include "rviz/display_group.h"
 #include "rviz/displays_panel.h"
 #include "rviz/frame_manager.h"
+#include "rviz/frame_profiler.h"
 #include "rviz/ogre_helpers/qt_ogre_render_window.h"
+#include "rviz/properties/bool_property.h"
 #include "rviz/properties/color_property.h"
+#include "rviz/properties/enum_property.h"
+#include "rviz/properties/int_property.h"
 #include "rviz/properties/parse_color.h"
 #include "rviz/properties/property.h"
 #include "rviz/properties/property_tree_model.h"
@@ -74,6 +78,7 @@
 #include "rviz/viewport_mouse_event.h"
 #include "rviz/view_controller.h"
 #include "rviz/view_manager.h"
+#include "rviz/worker_pool.h"
 #include "rviz/load_resource.h"
 
 #include "rviz/visualization_manager.h"
@@ -101,11 +106,39 @@ private:
   QIcon icon_;
 };
 
+static int defaultWorkerThreads()
+{
+  // Leave cores for the GUI and render thread
+  return std::max( 1, std::min( 4, (int) boost::thread::hardware_concurrency() - 1 ));
+}
+
 class VisualizationManagerPrivate
 {
 public:
-  ros::CallbackQueue threaded_queue_;
-  boost::thread_group threaded_queue_threads_;
+  VisualizationManagerPrivate()
+  : update_profile_( profiler_.registerName( "Update" ))
+  , spin_profile_( profiler_.registerName( "ros::spinOnce" ))
+  , tf_profile_( profiler_.registerName( "FrameManager::update" ))
+  , selection_profile_( profiler_.registerName( "SelectionManager::update" ))
+  , render_profile_( profiler_.registerName( "Render" ))
+  , frame_cache_profile_( profiler_.registerName( "Selection frame cache" ))
+  , worker_pool_( defaultWorkerThreads() )
+  , threaded_queue_( worker_pool_.createQueue() )
+  {
+    threaded_queue_->setProfiling( &profiler_, profiler_.registerName( "Shared threaded queue" ));
+  }
+
+  // Before the worker pool, whose threads record into it
+  FrameProfiler profiler_;
+  uint32_t update_profile_;
+  uint32_t spin_profile_;
+  uint32_t tf_profile_;
+  uint32_t selection_profile_;
+  uint32_t render_profile_;
+  uint32_t frame_cache_profile_;
+
+  WorkerPool worker_pool_;
+  WorkerQueuePtr threaded_queue_;
   ros::NodeHandle update_nh_;
   ros::NodeHandle threaded_nh_;
   boost::mutex render_mutex_;
@@ -115,10 +148,14 @@ public:
 VisualizationManager::VisualizationManager( RenderPanel* render_panel, WindowManagerInterface* wm )
 : ogre_root_( Ogre::Root::getSingletonPtr() )
 , update_timer_(0)
+, idle_timer_(0)
+, last_worker_calls_(0)
 , shutting_down_(false)
 , render_panel_( render_panel )
 , time_update_timer_(0.0f)
 , frame_update_timer_(0.0f)
+, last_tf_cache_hits_(0)
+, last_tf_cache_misses_(0)
 , render_requested_(1)
 , frame_count_(0)
 , window_manager_(wm)
@@ -131,7 +168,7 @@ VisualizationManager::VisualizationManager( RenderPanel* render_panel, WindowMan
 
   render_panel->setAutoRender(false);
 
-  private_->threaded_nh_.setCallbackQueue(&private_->threaded_queue_);
+  private_->threaded_nh_.setCallbackQueue(private_->threaded_queue_.get());
 
   scene_manager_ = ogre_root_->createSceneManager( Ogre::ST_GENERIC );
 
@@ -167,6 +204,30 @@ VisualizationManager::VisualizationManager( RenderPanel* render_panel, WindowMan
                                                   "Background color for the 3D view.",
                                                   global_options_, SLOT( updateBackgroundColor() ), this );
 
+  frame_cache_property_ = new BoolProperty( "Cache Pick Buffers", false,
+                                            "Capture the selection and depth buffers after every frame, so hovering and "
+                                            "measuring read them instead of rendering.  Costs two extra renders per frame.",
+                                            global_options_ );
+
+  worker_threads_property_ = new IntProperty( "Worker Threads", private_->worker_pool_.getNumThreads(),
+                                              "Number of threads processing incoming messages for all displays.  "
+                                              "Each display's messages are still processed one at a time, in order.",
+                                              global_options_, SLOT( updateWorkerThreads() ), this );
+  worker_threads_property_->setMin( 1 );
+  worker_threads_property_->setMax( 32 );
+
+  frame_scheduling_property_ = new EnumProperty( "Frame Scheduling", "On Change",
+                                                 "When to update displays and render.  "
+                                                 "Continuous: update at 30 Hz and redraw at least 10 times a second.  "
+                                                 "On Change: redraw only when something changed, update as often as messages arrive.  "
+                                                 "Low Latency: update right after messages arrive and redraw without a frame rate cap.  "
+                                                 "Power Saving: low update and frame rates, for monitoring.",
+                                                 global_options_, SLOT( updateFrameScheduling() ), this );
+  frame_scheduling_property_->addOption( "Continuous", FrameScheduler::Continuous );
+  frame_scheduling_property_->addOption( "On Change", FrameScheduler::OnChange );
+  frame_scheduling_property_->addOption( "Low Latency", FrameScheduler::LowLatency );
+  frame_scheduling_property_->addOption( "Power Saving", FrameScheduler::PowerSaving );
+
   root_display_group_->initialize( this ); // only initialize() a Display after its sub-properties are created.
   root_display_group_->setEnabled( true );
 
@@ -179,8 +240,6 @@ VisualizationManager::VisualizationManager( RenderPanel* render_panel, WindowMan
 
   selection_manager_ = new SelectionManager(this);
 
-  private_->threaded_queue_threads_.create_thread(boost::bind(&VisualizationManager::threadedQueueThreadFunc, this));
-
   display_factory_ = new DisplayFactory();
 }
 
@@ -190,7 +249,7 @@ VisualizationManager::~VisualizationManager()
   delete idle_timer_;
 
   shutting_down_ = true;
-  private_->threaded_queue_threads_.join_all();
+  private_->worker_pool_.shutdown();
 
   if(selection_manager_)
   {
@@ -224,7 +283,17 @@ void VisualizationManager::initialize()
 
 ros::CallbackQueueInterface* VisualizationManager::getThreadedQueue()
 {
-  return &private_->threaded_queue_;
+  return private_->threaded_queue_.get();
+}
+
+WorkerPool* VisualizationManager::getWorkerPool()
+{
+  return &private_->worker_pool_;
+}
+
+FrameProfiler* VisualizationManager::getFrameProfiler()
+{
+  return &private_->profiler_;
 }
 
 void VisualizationManager::lockRender()
@@ -245,12 +314,59 @@ ros::CallbackQueueInterface* VisualizationManager::getUpdateQueue()
 void VisualizationManager::startUpdate()
 {
   update_timer_ = new QTimer;
+  update_timer_->setSingleShot( true );
   connect( update_timer_, SIGNAL( timeout() ), this, SLOT( onUpdate() ));
-  update_timer_->start( 33 );
 
   idle_timer_ = new QTimer;
+  idle_timer_->setSingleShot( true );
   connect( idle_timer_, SIGNAL( timeout() ), this, SLOT( onIdle() ));
-  idle_timer_->start( 33 );
+
+  next_update_ = ros::WallTime::now();
+  update_timer_->start( 0 );
+}
+
+static int toMsec( double seconds )
+{
+  return (int) ( seconds * 1000.0 + 0.5 );
+}
+
+void VisualizationManager::wakeUpdate()
+{
+  if( !update_timer_ )
+  {
+    return;
+  }
+
+  ros::WallTime now = ros::WallTime::now();
+  frame_scheduler_.activity( now.toSec() );
+
+  double min_delay = frame_scheduler_.minUpdateDelay();
+  if( ( next_update_ - now ).toSec() > min_delay )
+  {
+    next_update_ = now + ros::WallDuration( min_delay );
+    update_timer_->start( toMsec( min_delay ));
+  }
+}
+
+void VisualizationManager::restartUpdateTimer()
+{
+  ros::WallTime now = ros::WallTime::now();
+  double delay = frame_scheduler_.nextUpdateDelay( now.toSec() );
+  next_update_ = now + ros::WallDuration( delay );
+  update_timer_->start( toMsec( delay ));
+}
+
+void VisualizationManager::scheduleRender()
+{
+  double delay = frame_scheduler_.nextRenderDelay( ros::WallTime::now().toSec(), render_requested_ );
+  if( delay == 0.0 )
+  {
+    onIdle();
+  }
+  else if( delay > 0.0 && !idle_timer_->isActive() )
+  {
+    idle_timer_->start( toMsec( delay ));
+  }
 }
 
 void createColorMaterial(const std::string& name, const Ogre::ColourValue& color)
@@ -280,11 +396,21 @@ void VisualizationManager::onUpdate()
 {
   if(disable_update_)
   {
+    // Held off by load(), which may run the event loop meanwhile.  The
+    // timer is single-shot and nothing else restarts it, so try again later.
+    if( update_timer_ )
+    {
+      restartUpdateTimer();
+    }
     return;
   }
 
   disable_update_ = true;
 
+  FrameProfiler* profiler = &private_->profiler_;
+  profiler->beginFrame();
+  ros::WallTime frame_start = ros::WallTime::now();
+
   //process pending mouse events
   Tool* current_tool = tool_manager_->getCurrentTool();
 
@@ -346,6 +472,19 @@ void VisualizationManager::onUpdate()
 
   ros::WallTime update_start = ros::WallTime::now();
 
+  // New messages or input mean the scene has probably changed, even
+  // for displays which don't call queueRender() themselves.
+  long worker_calls = private_->worker_pool_.getCallCount();
+  bool activity = !event_queue.empty()
+    || !ros::getGlobalCallbackQueue()->isEmpty()
+    || worker_calls != last_worker_calls_;
+  last_worker_calls_ = worker_calls;
+  if( activity )
+  {
+    frame_scheduler_.activity( update_start.toSec() );
+    queueRender();
+  }
+
   ros::WallDuration wall_diff = ros::WallTime::now() - last_update_wall_time_;
   ros::Duration ros_diff = ros::Time::now() - last_update_ros_time_;
   float wall_dt = wall_diff.toSec();
@@ -356,9 +495,15 @@ void VisualizationManager::onUpdate()
     resetTime();
   }
 
-  frame_manager_->update();
+  {
+    ProfileScope scope( profiler, private_->tf_profile_ );
+    frame_manager_->update();
+  }
 
-  ros::spinOnce();
+  {
+    ProfileScope scope( profiler, private_->spin_profile_ );
+    ros::spinOnce();
+  }
 
   last_update_ros_time_ = ros::Time::now();
   last_update_wall_time_ = ros::WallTime::now();
@@ -383,42 +528,60 @@ void VisualizationManager::onUpdate()
     frame_update_timer_ = 0.0f;
 
     updateFrames();
+    root_display_group_->updateQueueStatus();
   }
 
-  selection_manager_->update();
+  {
+    ProfileScope scope( profiler, private_->selection_profile_ );
+    selection_manager_->update();
+  }
 
   if( tool_manager_->getCurrentTool() )
   {
     tool_manager_->getCurrentTool()->update(wall_dt, ros_dt);
   }
 
+  // Recorded before scheduleRender(), which may render right away, so
+  // the "Update" and "Render" events never overlap.
+  profiler->record( private_->update_profile_, frame_start, ros::WallTime::now() );
+
   disable_update_ = false;
+
+  if( update_timer_ )
+  {
+    restartUpdateTimer();
+    scheduleRender();
+  }
 }
 
 void VisualizationManager::onIdle()
 {
   ros::WallTime cur = ros::WallTime::now();
-  double dt = (cur - last_render_).toSec();
+  double delay = frame_scheduler_.nextRenderDelay( cur.toSec(), render_requested_ );
 
-  if(dt > 0.1f)
+  if( delay > 0.0 )
   {
-    render_requested_ = 1;
+    // The timer fired a little early
+    idle_timer_->start( toMsec( delay ));
   }
-
-  // Cap at 60fps
-  if(render_requested_ && dt > 0.016f)
+  else if( delay == 0.0 )
   {
     render_requested_ = 0;
-    last_render_ = cur;
+    frame_scheduler_.rendered( cur.toSec() );
     frame_count_++;
 
-    boost::mutex::scoped_lock lock(private_->render_mutex_);
+    {
+      boost::mutex::scoped_lock lock(private_->render_mutex_);
+      ProfileScope scope( &private_->profiler_, private_->render_profile_ );
+      ogre_root_->renderOneFrame();
+    }
 
-//    ros::WallTime start = ros::WallTime::now();
-    ogre_root_->renderOneFrame();
-//    ros::WallTime end = ros::WallTime::now();
-//    ros::WallDuration d = end - start;
-//    ROS_INFO("Render took [%f] msec", d.toSec() * 1000.0f);
+    // SelectionManager::render() takes the render lock itself
+    if( frame_cache_property_->getBool() )
+    {
+      ProfileScope scope( &private_->profiler_, private_->frame_cache_profile_ );
+      selection_manager_->updateFrameCache( render_panel_->getViewport() );
+    }
   }
 }
 
@@ -469,6 +632,14 @@ void VisualizationManager::updateFrames()
     // fixed_prop->setToOK();
     global_status_->setStatus( StatusProperty::Ok, "Fixed Frame", "OK" );
   }
+
+  // Transform cache statistics since the last call, nominally one second
+  unsigned long hits = frame_manager_->getCacheHits();
+  unsigned long misses = frame_manager_->getCacheMisses();
+  global_status_->setStatus( StatusProperty::Ok, "Transform Cache",
+                             QString( "%1 hits, %2 misses" ).arg( hits - last_tf_cache_hits_ ).arg( misses - last_tf_cache_misses_ ));
+  last_tf_cache_hits_ = hits;
+  last_tf_cache_misses_ = misses;
 }
 
 tf::TransformListener* VisualizationManager::getTFClient() const
@@ -585,6 +756,17 @@ double VisualizationManager::getROSTimeElapsed()
   return ros_time_elapsed_.toSec();
 }
 
+void VisualizationManager::updateFrameScheduling()
+{
+  frame_scheduler_.setMode( (FrameScheduler::Mode) frame_scheduling_property_->getOptionInt() );
+  queueRender();
+}
+
+void VisualizationManager::updateWorkerThreads()
+{
+  private_->worker_pool_.setNumThreads( worker_threads_property_->getInt() );
+}
+
 void VisualizationManager::updateBackgroundColor()
 {
   render_panel_->setBackgroundColor( qtToOgre( background_color_property_->getColor() ));
@@ -594,21 +776,17 @@ void VisualizationManager::updateBackgroundColor()
 
 void VisualizationManager::handleMouseEvent( const ViewportMouseEvent& vme )
 {
-  boost::mutex::scoped_lock lock( private_->vme_queue_mutex_ );
-  vme_queue_.push_back(vme);
+  {
+    boost::mutex::scoped_lock lock( private_->vme_queue_mutex_ );
+    vme_queue_.push_back(vme);
+  }
+  wakeUpdate();
 }
 
 void VisualizationManager::handleChar( QKeyEvent* event, RenderPanel* panel )
 {
   tool_manager_->handleChar( event, panel );
-}
-
-void VisualizationManager::threadedQueueThreadFunc()
-{
-  while (!shutting_down_)
-  {
-    private_->threaded_queue_.callOne(ros::WallDuration(0.1));
-  }
+  wakeUpdate();
 }
 
 void VisualizationManager::notifyConfigChanged()
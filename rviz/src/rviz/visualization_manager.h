@@ -37,6 +37,7 @@
 
 #include "rviz/bit_allocator.h"
 #include "rviz/display_context.h"
+#include "rviz/frame_scheduler.h"
 
 class QKeyEvent;
 class QTimer;
@@ -67,11 +68,14 @@ class TransformListener;
 namespace rviz
 {
 
+class BoolProperty;
 class ColorProperty;
 class Display;
 class DisplayFactory;
 class DisplayGroup;
+class EnumProperty;
 class FrameManager;
+class IntProperty;
 class Property;
 class PropertyTreeModel;
 class RenderPanel;
@@ -80,7 +84,9 @@ class StatusList;
 class TfFrameProperty;
 class ViewportMouseEvent;
 class WindowManagerInterface;
+class FrameProfiler;
 class Tool;
+class WorkerPool;
 
 class VisualizationManagerPrivate;
 
@@ -125,7 +131,8 @@ public:
 
   /**
    * \brief Start timers.
-   * Creates and starts the update and idle timers, both set to 30Hz (33ms).
+   * Creates the update and render timers and starts updating.  From
+   * then on the FrameScheduler decides when they fire.
    */
   void startUpdate();
 
@@ -275,9 +282,18 @@ public:
 
   /**
    * @brief Return a CallbackQueue using a different thread than the main GUI one.
+   *
+   * This queue is shared by everything using it.  Displays get a
+   * queue of their own from getWorkerPool().
    */
   ros::CallbackQueueInterface* getThreadedQueue();
 
+  /** @brief Return the pool of threads running message processing callbacks. */
+  WorkerPool* getWorkerPool();
+
+  /** @brief Return the profiler recording how long each part of a frame takes. */
+  FrameProfiler* getFrameProfiler();
+
   /** @brief Return the FrameManager instance. */
   FrameManager* getFrameManager() const { return frame_manager_; }
 
@@ -327,13 +343,14 @@ protected Q_SLOTS:
    * calls ros::spinOnce(), so any callbacks on the global
    * CallbackQueue get called from here as well.
    *
-   * It is called at 30Hz from the update timer. */
+   * It is called from the update timer, at an interval chosen by the
+   * FrameScheduler after each call. */
   void onUpdate();
 
   /** @brief Render one frame if requested and enough time has passed
    *         since the previous render.
    *
-   * Called at 30Hz from the "idle" timer */
+   * Called from the render timer, or directly at the end of onUpdate(). */
   void onIdle();
 
   void onToolChanged( Tool* );
@@ -342,9 +359,16 @@ protected:
   void updateTime();
   void updateFrames();
 
-  void createColorMaterials();
+  /** @brief Start the update timer for the next update the FrameScheduler asks for. */
+  void restartUpdateTimer();
 
-  void threadedQueueThreadFunc();
+  /** @brief Render now, or start the render timer, if the FrameScheduler says a render is due. */
+  void scheduleRender();
+
+  /** @brief Move the next update closer after user input. */
+  void wakeUpdate();
+
+  void createColorMaterials();
 
   Ogre::Root* ogre_root_;                                 ///< Ogre Root
   Ogre::SceneManager* scene_manager_;                     ///< Ogre scene manager associated with this panel
@@ -353,7 +377,11 @@ protected:
   ros::Time last_update_ros_time_;                        ///< Update stopwatch.  Stores how long it's been since the last update
   ros::WallTime last_update_wall_time_;
 
-  QTimer* idle_timer_; ///< Timer with a timeout of 0.  Called by Qt event loop when it has no events to process.
+  QTimer* idle_timer_; ///< Single-shot render timer, started when a queued render has to wait for the frame rate cap.
+
+  FrameScheduler frame_scheduler_;
+  ros::WallTime next_update_;       ///< When update_timer_ fires next
+  long last_worker_calls_;          ///< WorkerPool::getCallCount() at the last update
 
   volatile bool shutting_down_;
 
@@ -375,15 +403,19 @@ protected:
   ros::Duration ros_time_elapsed_;
 
   ColorProperty* background_color_property_;
+  BoolProperty* frame_cache_property_;
+  IntProperty* worker_threads_property_;
+  EnumProperty* frame_scheduling_property_;
 
   float time_update_timer_;
   float frame_update_timer_;
+  unsigned long last_tf_cache_hits_;   ///< FrameManager cache counters at the last updateFrames()
+  unsigned long last_tf_cache_misses_;
 
   SelectionManager* selection_manager_;
 
   uint32_t render_requested_;
   uint64_t frame_count_;
-  ros::WallTime last_render_;
 
   WindowManagerInterface* window_manager_;
   
@@ -402,6 +434,8 @@ protected:
 private Q_SLOTS:
   void updateFixedFrame();
   void updateBackgroundColor();
+  void updateWorkerThreads();
+  void updateFrameScheduling();
 
 private:
   DisplayFactory* display_factory_;
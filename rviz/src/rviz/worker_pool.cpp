@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include "rviz/frame_profiler.h"
+#include "rviz/worker_pool.h"
+
+namespace rviz
+{
+
+/** A callback which returned TryAgain is not tried again before this long, so its thread doesn't spin on it. */
+static const ros::WallDuration RETRY_DELAY( 0.001 );
+
+WorkerQueue::WorkerQueue( WorkerPool* pool )
+: pool_( pool )
+, scheduled_( false )
+, closed_( false )
+, profiler_( 0 )
+, profile_name_( 0 )
+{
+}
+
+WorkerQueue::~WorkerQueue()
+{
+}
+
+void WorkerQueue::addCallback( const ros::CallbackInterfacePtr& callback, uint64_t owner_id )
+{
+  bool schedule = false;
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( closed_ )
+    {
+      return;
+    }
+    callbacks_.push_back( CallbackInfo( callback, owner_id ));
+    if( !scheduled_ )
+    {
+      scheduled_ = true;
+      schedule = true;
+    }
+  }
+
+  if( schedule )
+  {
+    pool_->schedule( shared_from_this() );
+  }
+}
+
+void WorkerQueue::removeByID( uint64_t owner_id )
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+
+  std::deque<CallbackInfo>::iterator it = callbacks_.begin();
+  while( it != callbacks_.end() )
+  {
+    if( it->second == owner_id )
+    {
+      it = callbacks_.erase( it );
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  boost::mutex::scoped_lock call_lock( call_mutex_, boost::defer_lock );
+  waitForCall( lock, call_lock );
+}
+
+void WorkerQueue::close()
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+  closed_ = true;
+  callbacks_.clear();
+
+  boost::mutex::scoped_lock call_lock( call_mutex_, boost::defer_lock );
+  waitForCall( lock, call_lock );
+}
+
+void WorkerQueue::waitForCall( boost::mutex::scoped_lock& lock, boost::mutex::scoped_lock& call_lock )
+{
+  // Wait for a running callback to finish, unless we are being called from it.
+  // call_mutex_ is always taken before mutex_, so let go of mutex_ while waiting.
+  if( calling_thread_ != boost::this_thread::get_id() )
+  {
+    lock.unlock();
+    call_lock.lock();
+    lock.lock();
+  }
+}
+
+WorkerQueue::Stats WorkerQueue::takeStats()
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+  Stats stats = stats_;
+  stats.depth = callbacks_.size();
+  stats_ = Stats();
+  return stats;
+}
+
+void WorkerQueue::setProfiling( FrameProfiler* profiler, uint32_t name )
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+  profiler_ = profiler;
+  profile_name_ = name;
+}
+
+WorkerQueue::CallOneResult WorkerQueue::callOne()
+{
+  boost::mutex::scoped_lock call_lock( call_mutex_ );
+
+  CallbackInfo info;
+  FrameProfiler* profiler;
+  uint32_t profile_name;
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( callbacks_.empty() )
+    {
+      scheduled_ = false;
+      return Idle;
+    }
+    info = callbacks_.front();
+    callbacks_.pop_front();
+    calling_thread_ = boost::this_thread::get_id();
+    profiler = profiler_;
+    profile_name = profile_name_;
+  }
+
+  ros::WallTime start = ros::WallTime::now();
+  ros::CallbackInterface::CallResult result = ros::CallbackInterface::Invalid;
+  if( info.first->ready() )
+  {
+    result = info.first->call();
+  }
+  else
+  {
+    result = ros::CallbackInterface::TryAgain;
+  }
+  ros::WallTime end = ros::WallTime::now();
+  ros::WallDuration busy = end - start;
+  if( profiler && result != ros::CallbackInterface::TryAgain )
+  {
+    profiler->record( profile_name, start, end );
+  }
+
+  boost::mutex::scoped_lock lock( mutex_ );
+  calling_thread_ = boost::thread::id();
+
+  if( result == ros::CallbackInterface::TryAgain )
+  {
+    // Keep the order: it goes first again the next time this queue gets a turn.
+    callbacks_.push_front( info );
+    return Deferred;
+  }
+
+  stats_.calls++;
+  stats_.busy += busy;
+
+  if( callbacks_.empty() )
+  {
+    scheduled_ = false;
+    return Called;
+  }
+  return CalledMore;
+}
+
+/** @brief Blocks of one parallelFor() call, taken by whichever thread comes first. */
+struct WorkerPool::ParallelJob
+{
+  boost::function<void (size_t, size_t)> func;
+  size_t size;
+  size_t block_size;
+  size_t num_blocks;
+  size_t next_block;    ///< First block nobody took yet
+  size_t done_blocks;
+  boost::mutex mutex;   ///< Guards next_block and done_blocks
+  boost::condition_variable done_cond;
+
+  /** @brief Run blocks until none are left to take. */
+  void work()
+  {
+    while( true )
+    {
+      size_t block;
+      {
+        boost::mutex::scoped_lock lock( mutex );
+        if( next_block == num_blocks )
+        {
+          return;
+        }
+        block = next_block++;
+      }
+
+      size_t begin = block * block_size;
+      func( begin, std::min( size, begin + block_size ));
+
+      boost::mutex::scoped_lock lock( mutex );
+      if( ++done_blocks == num_blocks )
+      {
+        done_cond.notify_all();
+      }
+    }
+  }
+};
+
+WorkerPool::WorkerPool( int num_threads )
+: num_threads_( 0 )
+, running_threads_( 0 )
+, shutting_down_( false )
+, calls_( 0 )
+{
+  setNumThreads( num_threads );
+}
+
+WorkerPool::~WorkerPool()
+{
+  shutdown();
+}
+
+WorkerQueuePtr WorkerPool::createQueue()
+{
+  return WorkerQueuePtr( new WorkerQueue( this ));
+}
+
+void WorkerPool::setNumThreads( int num_threads )
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+  if( shutting_down_ )
+  {
+    return;
+  }
+
+  num_threads_ = std::max( num_threads, 1 );
+  while( running_threads_ < num_threads_ )
+  {
+    threads_.create_thread( boost::bind( &WorkerPool::threadFunc, this ));
+    running_threads_++;
+  }
+
+  // Surplus threads notice they are not wanted when they wake up.
+  ready_cond_.notify_all();
+}
+
+int WorkerPool::getNumThreads() const
+{
+  boost::mutex::scoped_lock lock( mutex_ );
+  return num_threads_;
+}
+
+void WorkerPool::parallelFor( size_t size, size_t min_block, const boost::function<void (size_t, size_t)>& func )
+{
+  size_t num_blocks = std::min( (size_t) getNumThreads() + 1, size / std::max( min_block, (size_t) 1 ));
+  if( num_blocks <= 1 )
+  {
+    func( 0, size );
+    return;
+  }
+
+  // Shared, because helpers may only get to run after we returned.
+  boost::shared_ptr<ParallelJob> job( new ParallelJob );
+  job->func = func;
+  job->size = size;
+  job->block_size = (size + num_blocks - 1) / num_blocks;
+  job->num_blocks = num_blocks;
+  job->next_block = 0;
+  job->done_blocks = 0;
+
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( !shutting_down_ )
+    {
+      for( size_t i = 1; i < num_blocks; i++ )
+      {
+        helpers_.push_back( boost::bind( &ParallelJob::work, job ));
+      }
+    }
+  }
+  ready_cond_.notify_all();
+
+  job->work();
+
+  // Only blocks which other threads are running are left.
+  boost::mutex::scoped_lock lock( job->mutex );
+  while( job->done_blocks < job->num_blocks )
+  {
+    job->done_cond.wait( lock );
+  }
+}
+
+void WorkerPool::shutdown()
+{
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    shutting_down_ = true;
+    ready_.clear();
+    helpers_.clear();
+    deferred_.clear();
+  }
+  ready_cond_.notify_all();
+  threads_.join_all();
+}
+
+void WorkerPool::schedule( const WorkerQueuePtr& queue )
+{
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( shutting_down_ )
+    {
+      return;
+    }
+    ready_.push_back( queue );
+  }
+  ready_cond_.notify_one();
+}
+
+void WorkerPool::scheduleRetry( const WorkerQueuePtr& queue )
+{
+  {
+    boost::mutex::scoped_lock lock( mutex_ );
+    if( shutting_down_ )
+    {
+      return;
+    }
+    deferred_.push_back( std::make_pair( ros::WallTime::now() + RETRY_DELAY, boost::weak_ptr<WorkerQueue>( queue )));
+  }
+  // An idle thread has to pick up the new wake-up time
+  ready_cond_.notify_one();
+}
+
+ros::WallTime WorkerPool::wakeDeferred()
+{
+  if( deferred_.empty() )
+  {
+    return ros::WallTime();
+  }
+
+  ros::WallTime now = ros::WallTime::now();
+  while( !deferred_.empty() && deferred_.front().first <= now )
+  {
+    ready_.push_back( deferred_.front().second );
+    deferred_.pop_front();
+  }
+  return deferred_.empty() ? ros::WallTime() : deferred_.front().first;
+}
+
+void WorkerPool::threadFunc()
+{
+  while( true )
+  {
+    WorkerQueuePtr queue;
+    boost::function<void ()> helper;
+    {
+      boost::mutex::scoped_lock lock( mutex_ );
+      while( !shutting_down_ && running_threads_ <= num_threads_ && helpers_.empty() )
+      {
+        ros::WallTime next_retry = wakeDeferred();
+        if( !ready_.empty() )
+        {
+          break;
+        }
+
+        if( next_retry.isZero() )
+        {
+          ready_cond_.wait( lock );
+        }
+        else
+        {
+          ros::WallDuration wait = next_retry - ros::WallTime::now();
+          ready_cond_.timed_wait( lock, boost::posix_time::microseconds( std::max( wait.toNSec() / 1000, (int64_t) 1 )));
+        }
+      }
+
+      if( shutting_down_ )
+      {
+        return;
+      }
+
+      if( running_threads_ > num_threads_ )
+      {
+        running_threads_--;
+        return;
+      }
+
+      if( !helpers_.empty() )
+      {
+        helper = helpers_.front();
+        helpers_.pop_front();
+      }
+      else
+      {
+        queue = ready_.front().lock();
+        ready_.pop_front();
+      }
+    }
+
+    if( helper )
+    {
+      helper();
+      continue;
+    }
+
+    if( queue )
+    {
+      switch( queue->callOne() )
+      {
+      case WorkerQueue::Idle:
+        break;
+      case WorkerQueue::Called:
+        ++calls_;
+        break;
+      case WorkerQueue::CalledMore:
+        ++calls_;
+        schedule( queue );
+        break;
+      case WorkerQueue::Deferred:
+        scheduleRetry( queue );
+        break;
+      }
+    }
+  }
+}
+
+} // namespace rviz
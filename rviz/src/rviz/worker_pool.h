@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RVIZ_WORKER_POOL_H
+#define RVIZ_WORKER_POOL_H
+
+#include <deque>
+#include <utility>
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <ros/callback_queue_interface.h>
+#include <ros/time.h>
+
+namespace rviz
+{
+
+class FrameProfiler;
+class WorkerPool;
+
+/** @brief A CallbackQueue whose callbacks are run by the threads of a WorkerPool.
+ *
+ * Callbacks added to one WorkerQueue are run one at a time, in the
+ * order they were added, but not always on the same thread.
+ * Different WorkerQueues run concurrently.  Create them with
+ * WorkerPool::createQueue(). */
+class WorkerQueue: public ros::CallbackQueueInterface, public boost::enable_shared_from_this<WorkerQueue>
+{
+public:
+  /** @brief Processing statistics, see takeStats(). */
+  struct Stats
+  {
+    Stats()
+    : depth(0)
+    , calls(0)
+    {}
+
+    size_t depth;            ///< Callbacks waiting to run
+    uint64_t calls;          ///< Callbacks run since the last takeStats()
+    ros::WallDuration busy;  ///< Time spent running those callbacks
+  };
+
+  virtual ~WorkerQueue();
+
+  virtual void addCallback( const ros::CallbackInterfacePtr& callback, uint64_t owner_id = 0 );
+
+  /** @brief Remove all pending callbacks of an owner.
+   *
+   * Like ros::CallbackQueue, waits for a callback of this queue
+   * which is running on another thread to finish first, so the owner
+   * may be destroyed once this returns. */
+  virtual void removeByID( uint64_t owner_id );
+
+  /** @brief Drop all pending callbacks and any added later.
+   *
+   * Waits for a running callback to finish like removeByID().  Use
+   * this before destroying what the callbacks use, when the objects
+   * which add them go away later. */
+  void close();
+
+  /** @brief Return the statistics gathered since the last call, and start over. */
+  Stats takeStats();
+
+  /** @brief Record the time of each callback in @a profiler as @a name.  Pass NULL to stop. */
+  void setProfiling( FrameProfiler* profiler, uint32_t name );
+
+private:
+  friend class WorkerPool;
+
+  WorkerQueue( WorkerPool* pool );
+
+  /** @brief Lock call_mutex_ unless called from a callback of this queue.  Call with lock holding mutex_. */
+  void waitForCall( boost::mutex::scoped_lock& lock, boost::mutex::scoped_lock& call_lock );
+
+  /** @brief What callOne() did, and whether the queue needs another turn. */
+  enum CallOneResult
+  {
+    Idle,       ///< Nothing was waiting
+    Called,     ///< Ran a callback, nothing else is waiting
+    CalledMore, ///< Ran a callback, more are waiting
+    Deferred    ///< The callback asked to be tried again later, and went back to the front
+  };
+
+  /** @brief Run the callback at the front of the queue. */
+  CallOneResult callOne();
+
+  WorkerPool* pool_;
+
+  typedef std::pair<ros::CallbackInterfacePtr, uint64_t> CallbackInfo;
+  std::deque<CallbackInfo> callbacks_;
+  bool scheduled_;                  ///< True while waiting in the pool or being run
+  bool closed_;                     ///< Set by close()
+  boost::thread::id calling_thread_;
+  Stats stats_;
+  FrameProfiler* profiler_;
+  uint32_t profile_name_;
+  boost::mutex mutex_;              ///< Guards everything above
+
+  boost::mutex call_mutex_;         ///< Held while a callback runs
+};
+
+typedef boost::shared_ptr<WorkerQueue> WorkerQueuePtr;
+
+/** @brief A set of threads running the callbacks of many WorkerQueues.
+ *
+ * Queues with pending callbacks wait in one list, and whichever
+ * thread is idle takes the next one and runs a single callback from
+ * it before putting it back at the end.  That way a display flooded
+ * with messages can't starve the others, and no display has to own
+ * a thread which sits idle most of the time. */
+class WorkerPool
+{
+public:
+  WorkerPool( int num_threads );
+
+  /** @brief Stops all threads.  All WorkerQueues must be destroyed before the pool. */
+  ~WorkerPool();
+
+  /** @brief Create a new queue whose callbacks run on this pool. */
+  WorkerQueuePtr createQueue();
+
+  /** @brief Change the number of threads.  Threads above the new count exit after their current callback. */
+  void setNumThreads( int num_threads );
+
+  int getNumThreads() const;
+
+  /** @brief Call func( begin, end ) over [0, size), split into blocks of at least @a min_block.
+   *
+   * Idle threads of the pool help with the blocks, and the calling
+   * thread works on them too until all are done.  It never waits for
+   * a block nobody started, so this is safe to call from a callback
+   * running on the pool. */
+  void parallelFor( size_t size, size_t min_block, const boost::function<void (size_t, size_t)>& func );
+
+  /** @brief Return the number of callbacks run by the pool so far.  Callbacks which asked to be tried again don't count. */
+  long getCallCount() const { return calls_; }
+
+  /** @brief Stop and join all threads.  Callbacks still queued are not run. */
+  void shutdown();
+
+private:
+  friend class WorkerQueue;
+
+  /** @brief Put a queue with pending callbacks at the end of the ready list. */
+  void schedule( const WorkerQueuePtr& queue );
+
+  /** @brief Put a queue whose callback asked to be tried again at the end of the ready list after RETRY_DELAY. */
+  void scheduleRetry( const WorkerQueuePtr& queue );
+
+  /** @brief Move deferred queues whose time came to the ready list.  Call with mutex_ locked.
+   * @return The time the next deferred queue is due, or zero if there is none. */
+  ros::WallTime wakeDeferred();
+
+  void threadFunc();
+
+  struct ParallelJob;
+
+  // Weak, so a queue destroyed while waiting is skipped instead of left dangling
+  std::deque<boost::weak_ptr<WorkerQueue> > ready_;
+  std::deque<boost::function<void ()> > helpers_;  ///< Work on parallelFor() blocks, run before ready_
+  /// Queues waiting to retry a callback, and when.  All wait equally long, so this is in time order.
+  std::deque<std::pair<ros::WallTime, boost::weak_ptr<WorkerQueue> > > deferred_;
+  int num_threads_;       ///< Number of threads wanted
+  int running_threads_;   ///< Number of threads started and not yet exited
+  bool shutting_down_;
+  boost::detail::atomic_count calls_;
+  mutable boost::mutex mutex_;
+  boost::condition_variable ready_cond_;
+
+  boost::thread_group threads_;
+};
+
+} // namespace rviz
+
+#endif // RVIZ_WORKER_POOL_H
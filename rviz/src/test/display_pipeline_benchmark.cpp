@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Feeds synthetic TF, PointCloud2, LaserScan, MarkerArray, Image and
+// OccupancyGrid streams straight into the default displays of a
+// VisualizationManager and reports message and point throughput, frame
+// time percentiles and peak memory.  No ROS master is needed: messages
+// go to the displays' message entry points instead of subscribers.
+//
+// The render panel is never shown, but Ogre still needs an X server,
+// so run it under xvfb-run on headless machines.
+//
+// Usage: display_pipeline_benchmark [seconds] [points_per_cloud] [rate_hz]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <QApplication>
+
+#include <ros/ros.h>
+#include <ros/master.h>
+
+#include <tf/transform_listener.h>
+
+#include <nav_msgs/OccupancyGrid.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include "rviz/frame_profiler.h"
+#include "rviz/render_panel.h"
+#include "rviz/visualization_manager.h"
+#include "rviz/default_plugin/image_display.h"
+#include "rviz/default_plugin/laser_scan_display.h"
+#include "rviz/default_plugin/map_display.h"
+#include "rviz/default_plugin/marker_display.h"
+#include "rviz/default_plugin/point_cloud2_display.h"
+#include "rviz/default_plugin/tf_display.h"
+
+using namespace rviz;
+
+// The displays' message entry points are protected; these make them
+// callable without a subscriber.
+
+class BenchPointCloud2Display: public PointCloud2Display
+{
+public:
+  using PointCloud2Display::incomingMessage;
+};
+
+class BenchLaserScanDisplay: public LaserScanDisplay
+{
+public:
+  using LaserScanDisplay::incomingMessage;
+};
+
+class BenchImageDisplay: public ImageDisplay
+{
+public:
+  using ImageDisplay::incomingMessage;
+};
+
+class BenchMapDisplay: public MapDisplay
+{
+public:
+  using MapDisplay::incomingMap;
+};
+
+class BenchMarkerDisplay: public MarkerDisplay
+{
+public:
+  BenchMarkerDisplay()
+  {
+    // The default topic would subscribe, which needs a master.
+    marker_topic_property_->setValue( "" );
+  }
+
+  using MarkerDisplay::incomingMarkerArray;
+};
+
+/** Throughput of one message stream. */
+struct Stream
+{
+  Stream()
+  : messages( 0 )
+  , points( 0 )
+  {}
+
+  uint64_t messages;
+  uint64_t points;
+  ros::WallDuration busy;   ///< Time spent in the display's entry point
+};
+
+static const int NUM_LINKS = 50;
+
+static void sendTransforms( tf::Transformer* tf, const ros::Time& stamp, double t )
+{
+  std::vector<tf::StampedTransform> transforms;
+  transforms.push_back( tf::StampedTransform( tf::Transform( tf::createQuaternionFromYaw( t * 0.1 ), tf::Vector3( cos( t ), sin( t ), 0 )),
+                                              stamp, "map", "odom" ));
+  transforms.push_back( tf::StampedTransform( tf::Transform( tf::createQuaternionFromYaw( t ), tf::Vector3( 0.1 * t, 0, 0 )),
+                                              stamp, "odom", "base_link" ));
+  transforms.push_back( tf::StampedTransform( tf::Transform( tf::Quaternion::getIdentity(), tf::Vector3( 0.2, 0, 0.3 )),
+                                              stamp, "base_link", "laser" ));
+  for( int i = 0; i < NUM_LINKS; i++ )
+  {
+    char name[ 32 ];
+    snprintf( name, sizeof( name ), "link_%d", i );
+    transforms.push_back( tf::StampedTransform( tf::Transform( tf::createQuaternionFromYaw( t + i ), tf::Vector3( 0.05 * i, 0, 0 )),
+                                                stamp, i == 0 ? "base_link" : transforms.back().child_frame_id_, name ));
+  }
+
+  for( size_t i = 0; i < transforms.size(); i++ )
+  {
+    tf->setTransform( transforms[ i ], "benchmark" );
+  }
+}
+
+static sensor_msgs::PointCloud2Ptr makeCloud( uint32_t num_points, const ros::Time& stamp, double t )
+{
+  sensor_msgs::PointCloud2Ptr cloud( new sensor_msgs::PointCloud2 );
+  cloud->header.frame_id = "base_link";
+  cloud->header.stamp = stamp;
+  cloud->width = num_points;
+  cloud->height = 1;
+  cloud->is_dense = true;
+  cloud->is_bigendian = false;
+
+  const char* names[] = { "x", "y", "z", "intensity" };
+  cloud->fields.resize( 4 );
+  for( uint32_t i = 0; i < 4; ++i )
+  {
+    cloud->fields[i].name = names[i];
+    cloud->fields[i].offset = 4 * i;
+    cloud->fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+    cloud->fields[i].count = 1;
+  }
+  cloud->point_step = 16;
+  cloud->row_step = cloud->point_step * cloud->width;
+  cloud->data.resize( cloud->row_step );
+
+  float* fptr = reinterpret_cast<float*>( &cloud->data.front() );
+  for( uint32_t i = 0; i < num_points; ++i, fptr += 4 )
+  {
+    fptr[0] = (i % 1000) * 0.01f;
+    fptr[1] = ((i / 1000) % 1000) * 0.01f;
+    fptr[2] = sin( t + i * 0.001 );
+    fptr[3] = i % 4096;
+  }
+  return cloud;
+}
+
+static sensor_msgs::LaserScanPtr makeScan( const ros::Time& stamp, double t )
+{
+  sensor_msgs::LaserScanPtr scan( new sensor_msgs::LaserScan );
+  scan->header.frame_id = "laser";
+  scan->header.stamp = stamp;
+  scan->angle_min = -2.35;
+  scan->angle_max = 2.35;
+  scan->angle_increment = 4.7 / 1080;
+  // Zero, so the projector needs no transforms beyond the stamp.
+  scan->time_increment = 0;
+  scan->range_min = 0.1;
+  scan->range_max = 30;
+  scan->ranges.resize( 1081 );
+  scan->intensities.resize( 1081 );
+  for( size_t i = 0; i < scan->ranges.size(); i++ )
+  {
+    scan->ranges[ i ] = 5 + 2 * sin( t + i * 0.01 );
+    scan->intensities[ i ] = i;
+  }
+  return scan;
+}
+
+static visualization_msgs::MarkerArrayPtr makeMarkers( int num_markers, const ros::Time& stamp, double t )
+{
+  visualization_msgs::MarkerArrayPtr array( new visualization_msgs::MarkerArray );
+  array->markers.resize( num_markers );
+  for( int i = 0; i < num_markers; i++ )
+  {
+    visualization_msgs::Marker& marker = array->markers[ i ];
+    marker.header.frame_id = "base_link";
+    marker.header.stamp = stamp;
+    marker.ns = "benchmark";
+    marker.id = i;
+    marker.type = i % 2 ? visualization_msgs::Marker::CUBE : visualization_msgs::Marker::ARROW;
+    marker.action = visualization_msgs::Marker::ADD;
+    marker.pose.position.x = (i % 10) * 0.5;
+    marker.pose.position.y = (i / 10) * 0.5;
+    marker.pose.position.z = sin( t + i );
+    marker.pose.orientation.w = 1;
+    marker.scale.x = marker.scale.y = marker.scale.z = 0.2;
+    marker.color.r = marker.color.a = 1;
+    marker.color.g = (i % 7) / 7.0;
+  }
+  return array;
+}
+
+static sensor_msgs::ImagePtr makeImage( const ros::Time& stamp, int frame )
+{
+  sensor_msgs::ImagePtr image( new sensor_msgs::Image );
+  image->header.frame_id = "base_link";
+  image->header.stamp = stamp;
+  image->width = 640;
+  image->height = 480;
+  image->encoding = "rgb8";
+  image->step = image->width * 3;
+  image->data.resize( image->step * image->height );
+  for( size_t i = 0; i < image->data.size(); i++ )
+  {
+    image->data[ i ] = i + frame;
+  }
+  return image;
+}
+
+static nav_msgs::OccupancyGridPtr makeMap( const ros::Time& stamp, int frame )
+{
+  nav_msgs::OccupancyGridPtr map( new nav_msgs::OccupancyGrid );
+  map->header.frame_id = "map";
+  map->header.stamp = stamp;
+  map->info.resolution = 0.05;
+  map->info.width = 1000;
+  map->info.height = 1000;
+  map->info.origin.orientation.w = 1;
+  map->data.resize( map->info.width * map->info.height );
+  for( size_t i = 0; i < map->data.size(); i++ )
+  {
+    map->data[ i ] = (i + frame) % 101;
+  }
+  return map;
+}
+
+/** Names of the GUI thread's top-level events, which never nest or
+ * overlap: the whole of VisualizationManager::onUpdate() and the work
+ * done when it renders.  Anything else, like the benchmark's own feed
+ * or a display's update, is already counted inside one of these. */
+static const char* FRAME_EVENT_NAMES[] = { "Update", "Render", "Selection frame cache" };
+
+/** Add each finished frame's wall time spent updating and rendering to
+ * @a frame_times, in ms. */
+static void collectFrameTimes( FrameProfiler* profiler, uint32_t& next_frame, std::vector<double>& frame_times )
+{
+  std::set<uint32_t> frame_names;
+  for( size_t i = 0; i < sizeof( FRAME_EVENT_NAMES ) / sizeof( FRAME_EVENT_NAMES[0] ); i++ )
+  {
+    frame_names.insert( profiler->registerName( FRAME_EVENT_NAMES[ i ] ));
+  }
+
+  std::vector<FrameProfiler::Event> events;
+  profiler->getEvents( events );
+
+  // The current frame is not finished yet.
+  uint32_t end_frame = profiler->getFrame();
+  std::map<uint32_t, double> totals;
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    const FrameProfiler::Event& event = events[ i ];
+    if( frame_names.count( event.name ) && event.frame >= next_frame && event.frame < end_frame )
+    {
+      totals[ event.frame ] += event.duration.toSec() * 1000.0;
+    }
+  }
+  for( std::map<uint32_t, double>::iterator it = totals.begin(); it != totals.end(); ++it )
+  {
+    frame_times.push_back( it->second );
+  }
+  next_frame = std::max( next_frame, end_frame );
+}
+
+static double percentile( const std::vector<double>& sorted, double fraction )
+{
+  if( sorted.empty() )
+  {
+    return 0;
+  }
+  size_t index = std::min( sorted.size() - 1, (size_t) (fraction * sorted.size()) );
+  return sorted[ index ];
+}
+
+static void printStream( const char* name, const Stream& stream, double seconds )
+{
+  printf( "%-14s %10.1f %14.0f %10.3f\n", name,
+          stream.messages / seconds,
+          stream.points / seconds,
+          stream.messages ? stream.busy.toSec() * 1000.0 / stream.messages : 0.0 );
+}
+
+int main( int argc, char** argv )
+{
+  double seconds = argc > 1 ? atof( argv[1] ) : 10.0;
+  uint32_t num_points = argc > 2 ? atoi( argv[2] ) : 100000;
+  double rate = argc > 3 ? atof( argv[3] ) : 30.0;
+
+  QApplication app( argc, argv );
+  ros::init( argc, argv, "display_pipeline_benchmark",
+             ros::init_options::AnonymousName | ros::init_options::NoRosout | ros::init_options::NoSigintHandler );
+  // Without a master, registering the TF subscriber would wait forever.
+  ros::master::setRetryTimeout( ros::WallDuration( 0.1 ));
+
+  RenderPanel* render_panel = new RenderPanel();
+  render_panel->resize( 800, 600 );
+  VisualizationManager* manager = new VisualizationManager( render_panel );
+  render_panel->initialize( manager->getSceneManager(), manager );
+  manager->initialize();
+  manager->setFixedFrame( "map" );
+
+  BenchPointCloud2Display* cloud_display = new BenchPointCloud2Display;
+  BenchLaserScanDisplay* scan_display = new BenchLaserScanDisplay;
+  BenchMarkerDisplay* marker_display = new BenchMarkerDisplay;
+  BenchImageDisplay* image_display = new BenchImageDisplay;
+  BenchMapDisplay* map_display = new BenchMapDisplay;
+  manager->addDisplay( cloud_display, true );
+  manager->addDisplay( scan_display, true );
+  manager->addDisplay( marker_display, true );
+  manager->addDisplay( image_display, true );
+  manager->addDisplay( map_display, true );
+  manager->addDisplay( new TFDisplay, true );
+
+  FrameProfiler* profiler = manager->getFrameProfiler();
+  uint32_t feed_name = profiler->registerName( "Benchmark feed" );
+  profiler->setEnabled( true );
+  uint32_t next_frame = profiler->getFrame() + 1;
+
+  manager->startUpdate();
+
+  printf( "%.1f s at %.1f Hz, %u points per cloud\n", seconds, rate, num_points );
+
+  Stream tf_stream, cloud_stream, scan_stream, marker_stream, image_stream, map_stream;
+  std::vector<double> frame_times;
+
+  ros::WallTime start = ros::WallTime::now();
+  ros::WallTime end = start + ros::WallDuration( seconds );
+  ros::WallTime next_collect = start + ros::WallDuration( 1.0 );
+  ros::WallDuration period( 1.0 / rate );
+  int tick = 0;
+  for( ros::WallTime next_tick = start; next_tick < end; next_tick += period, tick++ )
+  {
+    double t = (next_tick - start).toSec();
+    ros::Time stamp = ros::Time::now();
+
+    // Build the messages first, so only the displays' work is timed.
+    sensor_msgs::PointCloud2Ptr cloud = makeCloud( num_points, stamp, t );
+    sensor_msgs::LaserScanPtr scan = makeScan( stamp, t );
+    visualization_msgs::MarkerArrayPtr markers = makeMarkers( 100, stamp, t );
+    sensor_msgs::ImagePtr image = makeImage( stamp, tick );
+    nav_msgs::OccupancyGridPtr map;
+    if( tick % (int) std::max( 1.0, rate ) == 0 )
+    {
+      map = makeMap( stamp, tick );
+    }
+
+    {
+      ProfileScope scope( profiler, feed_name );
+      ros::WallTime feed_start = ros::WallTime::now();
+
+      sendTransforms( manager->getTFClient(), stamp, t );
+      ros::WallTime tf_end = ros::WallTime::now();
+      tf_stream.messages += NUM_LINKS + 3;
+      tf_stream.busy += tf_end - feed_start;
+
+      cloud_display->incomingMessage( cloud );
+      ros::WallTime cloud_end = ros::WallTime::now();
+      cloud_stream.messages++;
+      cloud_stream.points += num_points;
+      cloud_stream.busy += cloud_end - tf_end;
+
+      scan_display->incomingMessage( scan );
+      ros::WallTime scan_end = ros::WallTime::now();
+      scan_stream.messages++;
+      scan_stream.points += scan->ranges.size();
+      scan_stream.busy += scan_end - cloud_end;
+
+      marker_display->incomingMarkerArray( markers );
+      ros::WallTime marker_end = ros::WallTime::now();
+      marker_stream.messages++;
+      marker_stream.points += markers->markers.size();
+      marker_stream.busy += marker_end - scan_end;
+
+      image_display->incomingMessage( image );
+      ros::WallTime image_end = ros::WallTime::now();
+      image_stream.messages++;
+      image_stream.points += image->width * image->height;
+      image_stream.busy += image_end - marker_end;
+
+      if( map )
+      {
+        map_display->incomingMap( map );
+        map_stream.messages++;
+        map_stream.points += map->data.size();
+        map_stream.busy += ros::WallTime::now() - image_end;
+      }
+    }
+
+    // Let the manager update and render until the next messages are due.
+    ros::WallTime now;
+    while(( now = ros::WallTime::now() ) < next_tick + period )
+    {
+      app.processEvents( QEventLoop::AllEvents, std::max( 1, (int) ((next_tick + period - now).toSec() * 1000 )));
+    }
+
+    if( now > next_collect )
+    {
+      collectFrameTimes( profiler, next_frame, frame_times );
+      next_collect = now + ros::WallDuration( 1.0 );
+    }
+  }
+  double elapsed = (ros::WallTime::now() - start).toSec();
+  collectFrameTimes( profiler, next_frame, frame_times );
+
+  printf( "\n%-14s %10s %14s %10s\n", "Stream", "msgs/s", "points/s", "ms/msg" );
+  printStream( "TF", tf_stream, elapsed );
+  printStream( "PointCloud2", cloud_stream, elapsed );
+  printStream( "LaserScan", scan_stream, elapsed );
+  printStream( "MarkerArray", marker_stream, elapsed );
+  printStream( "Image", image_stream, elapsed );
+  printStream( "OccupancyGrid", map_stream, elapsed );
+
+  std::sort( frame_times.begin(), frame_times.end() );
+  printf( "\n%lu frames (%.1f/s), update + render ms per frame: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+          (unsigned long) frame_times.size(), frame_times.size() / elapsed,
+          percentile( frame_times, 0.5 ), percentile( frame_times, 0.9 ), percentile( frame_times, 0.99 ),
+          frame_times.empty() ? 0.0 : frame_times.back() );
+
+  struct rusage usage;
+  getrusage( RUSAGE_SELF, &usage );
+  // ru_maxrss is in kilobytes on Linux
+  printf( "Peak RSS: %.1f MB\n", usage.ru_maxrss / 1024.0 );
+
+  delete manager;
+  delete render_panel;
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sstream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <rviz/frame_profiler.h>
+
+using namespace rviz;
+
+static void recordMany( FrameProfiler* profiler, uint32_t name, int count )
+{
+  for( int i = 0; i < count; i++ )
+  {
+    ros::WallTime start( 100.0 + i );
+    profiler->record( name, start, start + ros::WallDuration( 0.5 ));
+  }
+}
+
+TEST( FrameProfiler, names )
+{
+  FrameProfiler profiler;
+  uint32_t a = profiler.registerName( "a" );
+  uint32_t b = profiler.registerName( "b" );
+  EXPECT_NE( a, b );
+  EXPECT_EQ( a, profiler.registerName( "a" ));
+  EXPECT_EQ( "b", profiler.getName( b ));
+  EXPECT_EQ( "", profiler.getName( 1000 ));
+}
+
+TEST( FrameProfiler, disabled_records_nothing )
+{
+  FrameProfiler profiler;
+  uint32_t a = profiler.registerName( "a" );
+  recordMany( &profiler, a, 10 );
+  {
+    ProfileScope scope( &profiler, a );
+  }
+
+  std::vector<FrameProfiler::Event> events;
+  profiler.getEvents( events );
+  EXPECT_TRUE( events.empty() );
+}
+
+TEST( FrameProfiler, ring_keeps_newest )
+{
+  FrameProfiler profiler( 8 );
+  profiler.setEnabled( true );
+  uint32_t a = profiler.registerName( "a" );
+  profiler.beginFrame();
+  recordMany( &profiler, a, 20 );
+
+  std::vector<FrameProfiler::Event> events;
+  profiler.getEvents( events );
+  ASSERT_EQ( 8u, events.size() );
+  EXPECT_DOUBLE_EQ( 112.0, events.front().start.toSec() );
+  EXPECT_DOUBLE_EQ( 119.0, events.back().start.toSec() );
+  EXPECT_DOUBLE_EQ( 0.5, events.back().duration.toSec() );
+  EXPECT_EQ( 1u, events.back().frame );
+  EXPECT_EQ( a, events.back().name );
+
+  profiler.clear();
+  profiler.getEvents( events );
+  EXPECT_TRUE( events.empty() );
+}
+
+TEST( FrameProfiler, threads )
+{
+  FrameProfiler profiler( 4096 );
+  profiler.setEnabled( true );
+  uint32_t a = profiler.registerName( "a" );
+
+  boost::thread_group threads;
+  for( int i = 0; i < 4; i++ )
+  {
+    threads.create_thread( boost::bind( recordMany, &profiler, a, 500 ));
+  }
+  threads.join_all();
+
+  std::vector<FrameProfiler::Event> events;
+  profiler.getEvents( events );
+  ASSERT_EQ( 2000u, events.size() );
+
+  std::vector<int> per_thread( 5, 0 );
+  for( size_t i = 0; i < events.size(); i++ )
+  {
+    ASSERT_GE( events[ i ].thread, 1u );
+    ASSERT_LE( events[ i ].thread, 4u );
+    per_thread[ events[ i ].thread ]++;
+  }
+  for( int i = 1; i <= 4; i++ )
+  {
+    EXPECT_EQ( 500, per_thread[ i ] );
+  }
+}
+
+TEST( FrameProfiler, chrome_trace )
+{
+  FrameProfiler profiler;
+  profiler.setEnabled( true );
+  uint32_t a = profiler.registerName( "Marker \"1\"" );
+  profiler.record( a, ros::WallTime( 10.0 ), ros::WallTime( 10.002 ));
+
+  std::ostringstream out;
+  profiler.writeChromeTrace( out );
+  std::string trace = out.str();
+  EXPECT_NE( std::string::npos, trace.find( "\"traceEvents\"" ));
+  EXPECT_NE( std::string::npos, trace.find( "\"name\":\"Marker \\\"1\\\"\"" ));
+  EXPECT_NE( std::string::npos, trace.find( "\"ph\":\"X\"" ));
+  EXPECT_NE( std::string::npos, trace.find( "\"dur\":2" ));
+}
+
+TEST( FrameProfiler, chrome_trace_keeps_microseconds )
+{
+  FrameProfiler profiler;
+  profiler.setEnabled( true );
+  uint32_t a = profiler.registerName( "a" );
+  profiler.record( a, ros::WallTime( 10, 0 ), ros::WallTime( 10, 1000 ));
+  profiler.record( a, ros::WallTime( 13, 1500 ), ros::WallTime( 14, 2500 ));
+
+  std::ostringstream out;
+  profiler.writeChromeTrace( out );
+  std::string trace = out.str();
+  EXPECT_NE( std::string::npos, trace.find( "\"ts\":0.000," ));
+  EXPECT_NE( std::string::npos, trace.find( "\"ts\":3000001.500," ));
+  EXPECT_NE( std::string::npos, trace.find( "\"dur\":1000001.000," ));
+  EXPECT_EQ( std::string::npos, trace.find( "e+" ));
+
+  // The caller's stream formatting is left alone.
+  out.str( "" );
+  out << 1234567.0;
+  EXPECT_EQ( "1.23457e+06", out.str() );
+}
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
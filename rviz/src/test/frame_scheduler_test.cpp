@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <rviz/frame_scheduler.h>
+
+using namespace rviz;
+
+TEST( FrameScheduler, continuous_keeps_fixed_rates )
+{
+  FrameScheduler scheduler( FrameScheduler::Continuous );
+  EXPECT_DOUBLE_EQ( 0.033, scheduler.nextUpdateDelay( 0.0 ));
+
+  // First frame always renders
+  EXPECT_EQ( 0.0, scheduler.nextRenderDelay( 0.0, false ));
+  scheduler.rendered( 0.0 );
+
+  EXPECT_LT( scheduler.nextRenderDelay( 0.05, false ), 0.0 );
+  EXPECT_EQ( 0.0, scheduler.nextRenderDelay( 0.11, false ));
+  EXPECT_NEAR( 0.006, scheduler.nextRenderDelay( 0.01, true ), 1e-9 );
+}
+
+TEST( FrameScheduler, on_change_renders_only_when_asked )
+{
+  FrameScheduler scheduler( FrameScheduler::OnChange );
+  scheduler.rendered( 0.0 );
+
+  EXPECT_LT( scheduler.nextRenderDelay( 0.5, false ), 0.0 );
+  EXPECT_EQ( 0.0, scheduler.nextRenderDelay( 0.5, true ));
+  // Safety refresh after a second
+  EXPECT_EQ( 0.0, scheduler.nextRenderDelay( 1.5, false ));
+
+  FrameScheduler power_saving( FrameScheduler::PowerSaving );
+  power_saving.rendered( 0.0 );
+  EXPECT_LT( power_saving.nextRenderDelay( 100.0, false ), 0.0 );
+  EXPECT_NEAR( 0.05, power_saving.nextRenderDelay( 0.05, true ), 1e-9 );
+}
+
+TEST( FrameScheduler, update_rate_follows_messages )
+{
+  FrameScheduler scheduler( FrameScheduler::OnChange );
+
+  // Idle until something arrives
+  EXPECT_DOUBLE_EQ( 0.1, scheduler.nextUpdateDelay( 0.0 ));
+
+  // A 30 Hz stream pulls the update interval down to the minimum
+  double t = 0.0;
+  for( int i = 0; i < 50; i++ )
+  {
+    t += 1.0 / 30.0;
+    scheduler.activity( t );
+  }
+  EXPECT_NEAR( 1.0 / 30.0, scheduler.getActivityInterval(), 1e-3 );
+  EXPECT_GE( scheduler.nextUpdateDelay( t ), 0.016 );
+  EXPECT_LE( scheduler.nextUpdateDelay( t ), 0.017 );
+
+  // A 5 Hz stream is polled at the slowest active rate
+  for( int i = 0; i < 50; i++ )
+  {
+    t += 0.2;
+    scheduler.activity( t );
+  }
+  EXPECT_DOUBLE_EQ( 0.033, scheduler.nextUpdateDelay( t ));
+
+  // And a second of silence goes back to idle
+  EXPECT_DOUBLE_EQ( 0.1, scheduler.nextUpdateDelay( t + 1.5 ));
+}
+
+TEST( FrameScheduler, low_latency_updates_fast_and_renders_uncapped )
+{
+  FrameScheduler scheduler( FrameScheduler::LowLatency );
+  scheduler.rendered( 0.0 );
+  EXPECT_EQ( 0.0, scheduler.nextRenderDelay( 0.001, true ));
+
+  double t = 0.0;
+  for( int i = 0; i < 50; i++ )
+  {
+    t += 1.0 / 30.0;
+    scheduler.activity( t );
+  }
+  EXPECT_DOUBLE_EQ( 0.016, scheduler.nextUpdateDelay( t ));
+
+  EXPECT_DOUBLE_EQ( 0.004, scheduler.minUpdateDelay() );
+}
+
+int main( int argc, char **argv ) {
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
@@ -50,6 +50,8 @@ public:
   virtual DisplayFactory* getDisplayFactory() const { return display_factory_; }
   virtual ros::CallbackQueueInterface* getUpdateQueue() { return 0; }
   virtual ros::CallbackQueueInterface* getThreadedQueue() { return 0; }
+  virtual WorkerPool* getWorkerPool() { return 0; }
+  virtual FrameProfiler* getFrameProfiler() { return 0; }
   virtual void handleChar( QKeyEvent* event, RenderPanel* panel ) {};
   virtual void handleMouseEvent( const ViewportMouseEvent& event ) {};
   virtual ToolManager* getToolManager() const { return 0; }
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Compares building PointCloud::Point arrays with a per-point
+// Ogre::Root::convertColourValue() call, as Point::setColor() used to do,
+// against the cached-format packer now behind Point::setColor().
+//
+// Usage: point_cloud_color_benchmark [num_points] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <QApplication>
+
+#include <OGRE/OgreRoot.h>
+
+#include <ros/time.h>
+
+#include "rviz/ogre_helpers/point_cloud.h"
+#include "rviz/ogre_helpers/render_system.h"
+
+using namespace rviz;
+
+static void fillPointsLegacy( std::vector<PointCloud::Point>& points )
+{
+  const uint32_t num_points = points.size();
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    PointCloud::Point& point = points[i];
+    point.x = i * 0.001f;
+    point.y = 0.0f;
+    point.z = 0.0f;
+    Ogre::Root* root = Ogre::Root::getSingletonPtr();
+    root->convertColourValue( Ogre::ColourValue( (i & 0xff) / 255.0f, 0.5f, 1.0f ), &point.color );
+  }
+}
+
+static void fillPoints( std::vector<PointCloud::Point>& points )
+{
+  const uint32_t num_points = points.size();
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    PointCloud::Point& point = points[i];
+    point.x = i * 0.001f;
+    point.y = 0.0f;
+    point.z = 0.0f;
+    point.setColor( (i & 0xff) / 255.0f, 0.5f, 1.0f );
+  }
+}
+
+static double pointsPerSecond( void (*fill)( std::vector<PointCloud::Point>& ), std::vector<PointCloud::Point>& points, int iterations )
+{
+  ros::WallTime start = ros::WallTime::now();
+  for( int i = 0; i < iterations; ++i )
+  {
+    fill( points );
+  }
+  return (double) points.size() * iterations / ( ros::WallTime::now() - start ).toSec();
+}
+
+int main( int argc, char** argv )
+{
+  QApplication app( argc, argv );
+
+  uint32_t num_points = argc > 1 ? atoi( argv[1] ) : 2000000;
+  int iterations = argc > 2 ? atoi( argv[2] ) : 10;
+
+  // The color format comes from the render system, so one has to exist
+  RenderSystem::get();
+
+  std::vector<PointCloud::Point> legacy_points( num_points );
+  std::vector<PointCloud::Point> points( num_points );
+  double old_rate = pointsPerSecond( &fillPointsLegacy, legacy_points, iterations );
+  double new_rate = pointsPerSecond( &fillPoints, points, iterations );
+
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    if( legacy_points[i].color != points[i].color )
+    {
+      printf( "Color mismatch at point %u: %08x vs %08x\n", i, legacy_points[i].color, points[i].color );
+      return 1;
+    }
+  }
+
+  printf( "%u points, %d iterations\n", num_points, iterations );
+  printf( "convertColourValue %8.1f Mpoints/s\n", old_rate * 1e-6 );
+  printf( "packColor          %8.1f Mpoints/s   speedup %5.2fx\n", new_rate * 1e-6, new_rate / old_rate );
+
+  return 0;
+}
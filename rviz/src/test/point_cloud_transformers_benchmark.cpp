@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Compares the per-point cost of the PointCloud2 transformers against the
+// per-point valueFromCloud() loops they used to run.
+//
+// Usage: point_cloud_transformers_benchmark [num_points] [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QList>
+
+#include <OGRE/OgreMatrix4.h>
+
+#include <ros/time.h>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#include "rviz/properties/property.h"
+#include "rviz/default_plugin/point_cloud_transformers.h"
+
+using namespace rviz;
+
+static sensor_msgs::PointCloud2Ptr makeCloud( uint32_t num_points )
+{
+  sensor_msgs::PointCloud2Ptr cloud( new sensor_msgs::PointCloud2 );
+  cloud->header.frame_id = "base_link";
+  cloud->width = num_points;
+  cloud->height = 1;
+  cloud->is_dense = false;
+  cloud->is_bigendian = false;
+
+  const char* names[] = { "x", "y", "z", "intensity", "rgb", "r", "g", "b" };
+  cloud->fields.resize( 8 );
+  for( uint32_t i = 0; i < 8; ++i )
+  {
+    cloud->fields[i].name = names[i];
+    cloud->fields[i].offset = 4 * i;
+    cloud->fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+    cloud->fields[i].count = 1;
+  }
+  cloud->fields[4].datatype = sensor_msgs::PointField::UINT32;
+  cloud->point_step = 32;
+  cloud->row_step = cloud->point_step * cloud->width;
+  cloud->data.resize( cloud->row_step );
+
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    float* fptr = reinterpret_cast<float*>( &cloud->data[ i * cloud->point_step ]);
+    fptr[0] = (i % 1000) * 0.01f;
+    fptr[1] = ((i / 1000) % 1000) * 0.01f;
+    fptr[2] = (i % 77) * 0.1f;
+    fptr[3] = i % 4096;
+    reinterpret_cast<uint32_t*>( fptr )[4] = i * 2654435761u;
+    fptr[5] = (i % 256) / 255.0f;
+    fptr[6] = ((i / 256) % 256) / 255.0f;
+    fptr[7] = 0.5f;
+  }
+
+  return cloud;
+}
+
+static void legacyRainbow( float value, Ogre::ColourValue& color )
+{
+  value = std::min( value, 1.0f );
+  value = std::max( value, 0.0f );
+
+  float h = value * 5.0f + 1.0f;
+  int i = floor( h );
+  float f = h - i;
+  if ( !(i&1) ) f = 1 - f;
+  float n = 1 - f;
+
+  if      (i <= 1) color[0] = n, color[1] = 0, color[2] = 1;
+  else if (i == 2) color[0] = 0, color[1] = n, color[2] = 1;
+  else if (i == 3) color[0] = 0, color[1] = 1, color[2] = n;
+  else if (i == 4) color[0] = n, color[1] = 1, color[2] = 0;
+  else if (i >= 5) color[0] = 1, color[1] = n, color[2] = 0;
+}
+
+// The loops below are the transformer inner loops as they were before the
+// field layout was resolved once per message.
+
+static void legacyIntensity( const sensor_msgs::PointCloud2ConstPtr& cloud, V_PointCloudPoint& out )
+{
+  int32_t index = findChannelIndex( cloud, "intensity" );
+  const uint32_t offset = cloud->fields[index].offset;
+  const uint8_t type = cloud->fields[index].datatype;
+  const uint32_t point_step = cloud->point_step;
+  const uint32_t num_points = cloud->width * cloud->height;
+
+  float min_intensity = 999999.0f;
+  float max_intensity = -999999.0f;
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    float val = valueFromCloud<float>( cloud, offset, type, point_step, i );
+    min_intensity = std::min( val, min_intensity );
+    max_intensity = std::max( val, max_intensity );
+  }
+  float diff_intensity = max_intensity - min_intensity;
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    float val = valueFromCloud<float>( cloud, offset, type, point_step, i );
+    legacyRainbow( 1.0 - (val - min_intensity) / diff_intensity, out[i].color );
+  }
+}
+
+static void legacyXYZ( const sensor_msgs::PointCloud2ConstPtr& cloud, const Ogre::Matrix4& transform, V_PointCloudPoint& out )
+{
+  const uint32_t point_step = cloud->point_step;
+  const uint32_t num_points = cloud->width * cloud->height;
+  uint8_t const* point = &cloud->data.front();
+  for( uint32_t i = 0; i < num_points; ++i, point += point_step )
+  {
+    Ogre::Vector3 pos( *reinterpret_cast<const float*>( point ),
+                       *reinterpret_cast<const float*>( point + 4 ),
+                       *reinterpret_cast<const float*>( point + 8 ));
+    out[i].position = transform * pos;
+  }
+}
+
+static void legacyRGB8( const sensor_msgs::PointCloud2ConstPtr& cloud, V_PointCloudPoint& out )
+{
+  const uint32_t off = cloud->fields[ findChannelIndex( cloud, "rgb" )].offset;
+  const uint32_t point_step = cloud->point_step;
+  const uint32_t num_points = cloud->width * cloud->height;
+  uint8_t const* point = &cloud->data.front();
+  for( uint32_t i = 0; i < num_points; ++i, point += point_step )
+  {
+    uint32_t rgb = *reinterpret_cast<const uint32_t*>( point + off );
+    out[i].color = Ogre::ColourValue((( rgb >> 16 ) & 0xff ) / 255.0f, (( rgb >> 8 ) & 0xff ) / 255.0f, ( rgb & 0xff ) / 255.0f );
+  }
+}
+
+static void legacyRGBF32( const sensor_msgs::PointCloud2ConstPtr& cloud, V_PointCloudPoint& out )
+{
+  const uint32_t point_step = cloud->point_step;
+  const uint32_t num_points = cloud->width * cloud->height;
+  uint8_t const* point = &cloud->data.front();
+  for( uint32_t i = 0; i < num_points; ++i, point += point_step )
+  {
+    out[i].color = Ogre::ColourValue( *reinterpret_cast<const float*>( point + 20 ),
+                                      *reinterpret_cast<const float*>( point + 24 ),
+                                      *reinterpret_cast<const float*>( point + 28 ));
+  }
+}
+
+static void legacyAxisColor( const sensor_msgs::PointCloud2ConstPtr& cloud, const Ogre::Matrix4& transform, V_PointCloudPoint& out )
+{
+  const uint32_t point_step = cloud->point_step;
+  const uint32_t num_points = cloud->width * cloud->height;
+  uint8_t const* point = &cloud->data.front();
+  std::vector<float> values;
+  values.reserve( num_points );
+  for( uint32_t i = 0; i < num_points; ++i, point += point_step )
+  {
+    Ogre::Vector3 pos( *reinterpret_cast<const float*>( point ),
+                       *reinterpret_cast<const float*>( point + 4 ),
+                       *reinterpret_cast<const float*>( point + 8 ));
+    values.push_back(( transform * pos ).z );
+  }
+  float min_value = 9999.0f;
+  float max_value = -9999.0f;
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    min_value = std::min( min_value, values[i] );
+    max_value = std::max( max_value, values[i] );
+  }
+  float range = max_value - min_value;
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    legacyRainbow( 1.0 - ( values[i] - min_value ) / range, out[i].color );
+  }
+}
+
+static void legacyFlatColor( const sensor_msgs::PointCloud2ConstPtr& cloud, V_PointCloudPoint& out )
+{
+  const uint32_t num_points = cloud->width * cloud->height;
+  Ogre::ColourValue color( 1, 1, 1 );
+  for( uint32_t i = 0; i < num_points; ++i )
+  {
+    out[i].color = color;
+  }
+}
+
+enum Legacy
+{
+  LegacyIntensity,
+  LegacyXYZ,
+  LegacyRGB8,
+  LegacyRGBF32,
+  LegacyAxisColor,
+  LegacyFlatColor
+};
+
+static void runLegacy( Legacy which, const sensor_msgs::PointCloud2ConstPtr& cloud, const Ogre::Matrix4& transform, V_PointCloudPoint& out )
+{
+  switch( which )
+  {
+  case LegacyIntensity: legacyIntensity( cloud, out ); break;
+  case LegacyXYZ: legacyXYZ( cloud, transform, out ); break;
+  case LegacyRGB8: legacyRGB8( cloud, out ); break;
+  case LegacyRGBF32: legacyRGBF32( cloud, out ); break;
+  case LegacyAxisColor: legacyAxisColor( cloud, transform, out ); break;
+  case LegacyFlatColor: legacyFlatColor( cloud, out ); break;
+  }
+}
+
+static void benchmark( const char* name, PointCloudTransformer* trans, uint32_t mask, Legacy legacy,
+                       const sensor_msgs::PointCloud2ConstPtr& cloud, const Ogre::Matrix4& transform, int iterations )
+{
+  Property root;
+  QList<Property*> props;
+  trans->createProperties( &root, mask, props );
+  trans->supports( cloud );
+
+  const uint32_t num_points = cloud->width * cloud->height;
+  V_PointCloudPoint out( num_points );
+
+  ros::WallTime start = ros::WallTime::now();
+  for( int i = 0; i < iterations; ++i )
+  {
+    runLegacy( legacy, cloud, transform, out );
+  }
+  double old_ns = ( ros::WallTime::now() - start ).toSec() * 1e9 / ( (double) num_points * iterations );
+
+  start = ros::WallTime::now();
+  for( int i = 0; i < iterations; ++i )
+  {
+    trans->transform( cloud, mask, transform, out );
+  }
+  double new_ns = ( ros::WallTime::now() - start ).toSec() * 1e9 / ( (double) num_points * iterations );
+
+  printf( "%-12s old %7.2f ns/point   new %7.2f ns/point   speedup %5.2fx\n", name, old_ns, new_ns, old_ns / new_ns );
+}
+
+int main( int argc, char** argv )
+{
+  uint32_t num_points = argc > 1 ? atoi( argv[1] ) : 2000000;
+  int iterations = argc > 2 ? atoi( argv[2] ) : 10;
+
+  sensor_msgs::PointCloud2ConstPtr cloud = makeCloud( num_points );
+  Ogre::Matrix4 transform( Ogre::Quaternion( Ogre::Degree( 30 ), Ogre::Vector3::UNIT_Z ));
+  transform.setTrans( Ogre::Vector3( 1, 2, 3 ));
+
+  printf( "%u points, %d iterations\n", num_points, iterations );
+
+  IntensityPCTransformer intensity;
+  XYZPCTransformer xyz;
+  RGB8PCTransformer rgb8;
+  RGBF32PCTransformer rgbf32;
+  AxisColorPCTransformer axis_color;
+  FlatColorPCTransformer flat_color;
+
+  benchmark( "Intensity", &intensity, PointCloudTransformer::Support_Color, LegacyIntensity, cloud, transform, iterations );
+  benchmark( "XYZ", &xyz, PointCloudTransformer::Support_XYZ, LegacyXYZ, cloud, transform, iterations );
+  benchmark( "RGB8", &rgb8, PointCloudTransformer::Support_Color, LegacyRGB8, cloud, transform, iterations );
+  benchmark( "RGBF32", &rgbf32, PointCloudTransformer::Support_Color, LegacyRGBF32, cloud, transform, iterations );
+  benchmark( "AxisColor", &axis_color, PointCloudTransformer::Support_Color, LegacyAxisColor, cloud, transform, iterations );
+  benchmark( "FlatColor", &flat_color, PointCloudTransformer::Support_Color, LegacyFlatColor, cloud, transform, iterations );
+
+  return 0;
+}
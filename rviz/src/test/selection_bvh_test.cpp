@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <rviz/selection/selection_bvh.h>
+
+using namespace rviz;
+
+static Ogre::AxisAlignedBox unitBoxAt( float x, float y, float z )
+{
+  return Ogre::AxisAlignedBox( x - 0.5f, y - 0.5f, z - 0.5f, x + 0.5f, y + 0.5f, z + 0.5f );
+}
+
+static std::vector<std::pair<float, CollObjectHandle> > castAlongX( const SelectionBVH& tree, float y, float z )
+{
+  std::vector<std::pair<float, CollObjectHandle> > hits;
+  tree.intersect( Ogre::Ray( Ogre::Vector3( -100, y, z ), Ogre::Vector3::UNIT_X ), hits );
+  std::sort( hits.begin(), hits.end() );
+  return hits;
+}
+
+TEST( SelectionBVH, finds_boxes_in_order )
+{
+  SelectionBVH tree;
+  EXPECT_TRUE( tree.empty() );
+
+  // A row of boxes along x, and a column of boxes along y which the ray misses
+  for( int i = 0; i < 20; ++i )
+  {
+    tree.insert( unitBoxAt( i * 3, 0, 0 ), 100 + i );
+    tree.insert( unitBoxAt( 0, 10 + i * 3, 0 ), 200 + i );
+  }
+
+  std::vector<std::pair<float, CollObjectHandle> > hits = castAlongX( tree, 0, 0 );
+  ASSERT_EQ( 20u, hits.size() );
+  for( int i = 0; i < 20; ++i )
+  {
+    EXPECT_EQ( CollObjectHandle( 100 + i ), hits[ i ].second );
+  }
+}
+
+TEST( SelectionBVH, move_and_remove )
+{
+  SelectionBVH tree;
+  int a = tree.insert( unitBoxAt( 0, 0, 0 ), 1 );
+  int b = tree.insert( unitBoxAt( 5, 0, 0 ), 2 );
+  tree.insert( unitBoxAt( 10, 0, 0 ), 3 );
+
+  tree.move( a, unitBoxAt( 0, 20, 0 ));
+  std::vector<std::pair<float, CollObjectHandle> > hits = castAlongX( tree, 0, 0 );
+  ASSERT_EQ( 2u, hits.size() );
+  EXPECT_EQ( 2u, hits[0].second );
+  EXPECT_EQ( 3u, hits[1].second );
+
+  hits = castAlongX( tree, 20, 0 );
+  ASSERT_EQ( 1u, hits.size() );
+  EXPECT_EQ( 1u, hits[0].second );
+
+  tree.remove( b );
+  hits = castAlongX( tree, 0, 0 );
+  ASSERT_EQ( 1u, hits.size() );
+  EXPECT_EQ( 3u, hits[0].second );
+
+  tree.clear();
+  EXPECT_TRUE( tree.empty() );
+  EXPECT_TRUE( castAlongX( tree, 0, 0 ).empty() );
+}
+
+int main( int argc, char **argv ) {
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Needs an X server for Ogre, like display_pipeline_benchmark, so it is
+// not part of "make test".  Build it with "make visualization_manager_test"
+// and run it by hand, under xvfb-run on headless machines.
+
+#include <sstream>
+
+#include <boost/thread/thread.hpp>
+
+#include <QApplication>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <ros/master.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <rviz/display.h>
+#include <rviz/loading_dialog.h>
+#include <rviz/render_panel.h>
+#include <rviz/visualization_manager.h>
+
+using namespace rviz;
+
+static QApplication* g_app = 0;
+
+/** Counts the updates it gets. */
+class CountingDisplay: public Display
+{
+public:
+  CountingDisplay()
+  : updates( 0 )
+  {}
+
+  virtual void update( float wall_dt, float ros_dt )
+  {
+    updates++;
+  }
+
+  int updates;
+};
+
+/** Run the event loop for a while. */
+static void spin( int msec )
+{
+  ros::WallTime end = ros::WallTime::now() + ros::WallDuration( msec / 1000.0 );
+  while( ros::WallTime::now() < end )
+  {
+    g_app->processEvents( QEventLoop::AllEvents, 10 );
+  }
+}
+
+TEST( VisualizationManager, keeps_updating_after_a_stalled_update )
+{
+  RenderPanel* render_panel = new RenderPanel();
+  VisualizationManager* manager = new VisualizationManager( render_panel );
+  render_panel->initialize( manager->getSceneManager(), manager );
+  manager->initialize();
+  manager->startUpdate();
+  spin( 200 );
+
+  // load() runs the event loop through the loading dialog while updates are held off.
+  // Waiting without running it first makes sure the update timer is due by then.
+  LoadingDialog dialog;
+  QObject::connect( manager, SIGNAL( statusUpdate( const QString& )), &dialog, SLOT( showMessage( const QString& )));
+  boost::this_thread::sleep( boost::posix_time::milliseconds( 300 ));
+
+  std::stringstream input( "Displays: []\n" );
+  YAML::Parser parser( input );
+  YAML::Node node;
+  parser.GetNextDocument( node );
+  manager->load( node );
+
+  CountingDisplay* display = new CountingDisplay;
+  manager->addDisplay( display, true );
+  spin( 500 );
+  EXPECT_LT( 0, display->updates );
+
+  delete manager;
+  delete render_panel;
+}
+
+int main( int argc, char **argv )
+{
+  QApplication app( argc, argv );
+  g_app = &app;
+  ros::init( argc, argv, "visualization_manager_test",
+             ros::init_options::AnonymousName | ros::init_options::NoRosout | ros::init_options::NoSigintHandler );
+  // Without a master, registering the TF subscriber would wait forever.
+  ros::master::setRetryTimeout( ros::WallDuration( 0.1 ));
+
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
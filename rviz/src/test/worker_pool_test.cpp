@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2012, Willow Garage, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Willow Garage, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/callback_queue_interface.h>
+
+#include <rviz/worker_pool.h>
+
+using namespace rviz;
+
+/** Log of the callbacks run on one queue. */
+struct CallLog
+{
+  CallLog()
+  : in_flight(0)
+  , max_in_flight(0)
+  {}
+
+  size_t size()
+  {
+    boost::mutex::scoped_lock lock( mutex );
+    return values.size();
+  }
+
+  boost::mutex mutex;
+  std::vector<int> values;
+  int in_flight;
+  int max_in_flight;
+};
+
+class LoggingCallback: public ros::CallbackInterface
+{
+public:
+  LoggingCallback( CallLog* log, int value, int sleep_ms = 0 )
+  : log_( log )
+  , value_( value )
+  , sleep_ms_( sleep_ms )
+  {}
+
+  virtual CallResult call()
+  {
+    {
+      boost::mutex::scoped_lock lock( log_->mutex );
+      log_->in_flight++;
+      log_->max_in_flight = std::max( log_->max_in_flight, log_->in_flight );
+    }
+    if( sleep_ms_ > 0 )
+    {
+      boost::this_thread::sleep( boost::posix_time::milliseconds( sleep_ms_ ));
+    }
+    boost::mutex::scoped_lock lock( log_->mutex );
+    log_->in_flight--;
+    log_->values.push_back( value_ );
+    return Success;
+  }
+
+private:
+  CallLog* log_;
+  int value_;
+  int sleep_ms_;
+};
+
+static bool waitForCalls( CallLog& log, size_t count )
+{
+  for( int i = 0; i < 500 && log.size() < count; i++ )
+  {
+    boost::this_thread::sleep( boost::posix_time::milliseconds( 10 ));
+  }
+  return log.size() == count;
+}
+
+TEST( WorkerPool, runs_each_queue_in_order )
+{
+  const int num_queues = 5;
+  const int num_calls = 200;
+
+  WorkerPool pool( 3 );
+  std::vector<WorkerQueuePtr> queues;
+  std::vector<CallLog> logs( num_queues );
+  for( int q = 0; q < num_queues; q++ )
+  {
+    queues.push_back( pool.createQueue() );
+  }
+
+  for( int i = 0; i < num_calls; i++ )
+  {
+    for( int q = 0; q < num_queues; q++ )
+    {
+      queues[ q ]->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &logs[ q ], i )));
+    }
+  }
+
+  for( int q = 0; q < num_queues; q++ )
+  {
+    ASSERT_TRUE( waitForCalls( logs[ q ], num_calls ));
+    EXPECT_EQ( 1, logs[ q ].max_in_flight );
+    for( int i = 0; i < num_calls; i++ )
+    {
+      EXPECT_EQ( i, logs[ q ].values[ i ] );
+    }
+
+    WorkerQueue::Stats stats = queues[ q ]->takeStats();
+    EXPECT_EQ( 0u, stats.depth );
+    EXPECT_EQ( (uint64_t) num_calls, stats.calls );
+    EXPECT_EQ( 0u, queues[ q ]->takeStats().calls );
+  }
+}
+
+TEST( WorkerPool, runs_queues_concurrently )
+{
+  WorkerPool pool( 2 );
+  WorkerQueuePtr slow = pool.createQueue();
+  WorkerQueuePtr fast = pool.createQueue();
+  CallLog slow_log;
+  CallLog fast_log;
+
+  slow->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &slow_log, 0, 500 )));
+  boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ));
+  fast->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &fast_log, 0 )));
+
+  // The fast queue must not wait for the slow one
+  for( int i = 0; i < 20 && fast_log.size() == 0; i++ )
+  {
+    boost::this_thread::sleep( boost::posix_time::milliseconds( 10 ));
+  }
+  EXPECT_EQ( 1u, fast_log.size() );
+  EXPECT_EQ( 0u, slow_log.size() );
+
+  EXPECT_TRUE( waitForCalls( slow_log, 1 ));
+}
+
+TEST( WorkerPool, remove_by_id_drops_pending_callbacks )
+{
+  WorkerPool pool( 1 );
+  WorkerQueuePtr queue = pool.createQueue();
+  CallLog log;
+
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 0, 100 )), 1 );
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 1 )), 2 );
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 2 )), 3 );
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 3 )), 2 );
+
+  queue->removeByID( 2 );
+
+  ASSERT_TRUE( waitForCalls( log, 2 ));
+  EXPECT_EQ( 0, log.values[ 0 ] );
+  EXPECT_EQ( 2, log.values[ 1 ] );
+}
+
+TEST( WorkerPool, close_waits_and_drops_callbacks )
+{
+  WorkerPool pool( 1 );
+  WorkerQueuePtr queue = pool.createQueue();
+  CallLog log;
+
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 0, 100 )));
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 1 )));
+  boost::this_thread::sleep( boost::posix_time::milliseconds( 20 ));
+
+  // The first callback is running by now, and close() waits for it
+  queue->close();
+  EXPECT_EQ( 1u, log.size() );
+
+  queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, 2 )));
+  boost::this_thread::sleep( boost::posix_time::milliseconds( 50 ));
+  EXPECT_EQ( 1u, log.size() );
+}
+
+TEST( WorkerPool, changes_thread_count )
+{
+  WorkerPool pool( 4 );
+  EXPECT_EQ( 4, pool.getNumThreads() );
+  pool.setNumThreads( 1 );
+  EXPECT_EQ( 1, pool.getNumThreads() );
+  pool.setNumThreads( 0 );
+  EXPECT_EQ( 1, pool.getNumThreads() );
+
+  WorkerQueuePtr queue = pool.createQueue();
+  CallLog log;
+  for( int i = 0; i < 10; i++ )
+  {
+    queue->addCallback( ros::CallbackInterfacePtr( new LoggingCallback( &log, i )));
+  }
+  EXPECT_TRUE( waitForCalls( log, 10 ));
+}
+
+/** Asks to be tried again until it is allowed to run. */
+class RetryCallback: public ros::CallbackInterface
+{
+public:
+  RetryCallback( CallLog* log )
+  : log_( log )
+  , attempts_( 0 )
+  , allowed_( false )
+  {}
+
+  virtual CallResult call()
+  {
+    boost::mutex::scoped_lock lock( log_->mutex );
+    attempts_++;
+    if( !allowed_ )
+    {
+      return TryAgain;
+    }
+    log_->values.push_back( 0 );
+    return Success;
+  }
+
+  void allow()
+  {
+    boost::mutex::scoped_lock lock( log_->mutex );
+    allowed_ = true;
+  }
+
+  int getAttempts()
+  {
+    boost::mutex::scoped_lock lock( log_->mutex );
+    return attempts_;
+  }
+
+private:
+  CallLog* log_;
+  int attempts_;
+  bool allowed_;
+};
+
+TEST( WorkerPool, try_again_backs_off )
+{
+  WorkerPool pool( 2 );
+  WorkerQueuePtr queue = pool.createQueue();
+  CallLog log;
+  boost::shared_ptr<RetryCallback> callback( new RetryCallback( &log ));
+  queue->addCallback( callback );
+
+  boost::this_thread::sleep( boost::posix_time::milliseconds( 100 ));
+  // Retried now and then, not spun on
+  EXPECT_LT( 0, callback->getAttempts() );
+  EXPECT_GT( 1000, callback->getAttempts() );
+  EXPECT_EQ( 0, pool.getCallCount() );
+
+  callback->allow();
+  EXPECT_TRUE( waitForCalls( log, 1 ));
+  // Only the call which ran counts
+  EXPECT_EQ( 1, pool.getCallCount() );
+}
+
+/** Add one to each element of a range. */
+static void countRange( std::vector<int>* counts, size_t begin, size_t end )
+{
+  for( size_t i = begin; i < end; i++ )
+  {
+    (*counts)[ i ]++;
+  }
+}
+
+TEST( WorkerPool, parallel_for_covers_range_once )
+{
+  WorkerPool pool( 3 );
+  std::vector<int> counts( 10007, 0 );
+  pool.parallelFor( counts.size(), 100, boost::bind( &countRange, &counts, _1, _2 ));
+  EXPECT_EQ( counts.size(), (size_t) std::count( counts.begin(), counts.end(), 1 ));
+
+  // Too small to split
+  std::vector<int> few( 50, 0 );
+  pool.parallelFor( few.size(), 100, boost::bind( &countRange, &few, _1, _2 ));
+  EXPECT_EQ( few.size(), (size_t) std::count( few.begin(), few.end(), 1 ));
+}
+
+/** Runs a parallelFor() from inside the pool. */
+class ParallelCallback: public ros::CallbackInterface
+{
+public:
+  ParallelCallback( WorkerPool* pool, std::vector<int>* counts, CallLog* log )
+  : pool_( pool )
+  , counts_( counts )
+  , log_( log )
+  {}
+
+  virtual CallResult call()
+  {
+    pool_->parallelFor( counts_->size(), 10, boost::bind( &countRange, counts_, _1, _2 ));
+    boost::mutex::scoped_lock lock( log_->mutex );
+    log_->values.push_back( 0 );
+    return Success;
+  }
+
+private:
+  WorkerPool* pool_;
+  std::vector<int>* counts_;
+  CallLog* log_;
+};
+
+TEST( WorkerPool, parallel_for_inside_pool_does_not_deadlock )
+{
+  // The only thread is busy running the callback, so it does all blocks itself.
+  WorkerPool pool( 1 );
+  WorkerQueuePtr queue = pool.createQueue();
+  std::vector<int> counts( 1000, 0 );
+  CallLog log;
+  queue->addCallback( ros::CallbackInterfacePtr( new ParallelCallback( &pool, &counts, &log )));
+  EXPECT_TRUE( waitForCalls( log, 1 ));
+  EXPECT_EQ( counts.size(), (size_t) std::count( counts.begin(), counts.end(), 1 ));
+}
+
+int main( int argc, char **argv ) {
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}